@@ -18,6 +18,7 @@ static struct restart_handler restart;
 static struct poweroff_handler poweroff;
 
 static __efi_runtime_data u32 (*psci_invoke_fn)(ulong, ulong, ulong, ulong);
+static enum arm_smccc_conduit psci_conduit = SMCCC_CONDUIT_NONE;
 
 static void __noreturn psci_invoke_noreturn(ulong function)
 {
@@ -62,6 +63,11 @@ int psci_get_version(void)
 	return version;
 }
 
+enum arm_smccc_conduit psci_get_conduit(void)
+{
+	return psci_conduit;
+}
+
 
 static int psci_xlate_error(s32 errnum)
 {
@@ -149,8 +155,10 @@ static int __init psci_probe(struct device *dev)
 
 	if (!strcmp(method, "hvc")) {
 		psci_invoke_fn = invoke_psci_fn_hvc;
+		psci_conduit = SMCCC_CONDUIT_HVC;
 	} else if (!strcmp(method, "smc")) {
 		psci_invoke_fn = invoke_psci_fn_smc;
+		psci_conduit = SMCCC_CONDUIT_SMC;
 	} else {
 		pr_warn("invalid \"method\" property: %s\n", method);
 		return -EINVAL;
@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Secondary CPUs as workers for CPU bound jobs like hashing and
+ * decompression. They are brought up with PSCI on first use, share the
+ * page tables of the boot CPU and are turned off again before barebox
+ * hands over control to the next stage.
+ */
+
+#define pr_fmt(fmt) "smp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <globalvar.h>
+#include <init.h>
+#include <magicvar.h>
+#include <malloc.h>
+#include <of.h>
+#include <smp.h>
+#include <linux/build_bug.h>
+#include <linux/sizes.h>
+#include <asm/cache.h>
+#include <asm/psci.h>
+#include <asm/smp.h>
+#include <asm/system.h>
+
+#define MPIDR_HWID_BITMASK	0xff00ffffffUL
+#define SMP_STACK_SIZE		SZ_64K
+#define SMP_TIMEOUT		(100 * MSECOND)
+
+struct smp_work {
+	smp_job_fn fn;
+	void *data;
+};
+
+extern char arm_smp_secondary_entry_end[];
+
+static_assert(offsetof(struct arm_smp_cpu, stack_top) == ARM_SMP_CPU_STACK);
+static_assert(offsetof(struct arm_smp_cpu, ttbr) == ARM_SMP_CPU_TTBR);
+static_assert(offsetof(struct arm_smp_cpu, tcr) == ARM_SMP_CPU_TCR);
+static_assert(offsetof(struct arm_smp_cpu, mair) == ARM_SMP_CPU_MAIR);
+static_assert(offsetof(struct arm_smp_cpu, sctlr) == ARM_SMP_CPU_SCTLR);
+static_assert(offsetof(struct arm_smp_cpu, vbar) == ARM_SMP_CPU_VBAR);
+static_assert(offsetof(struct arm_smp_cpu, el) == ARM_SMP_CPU_EL);
+static_assert(offsetof(struct arm_smp_cpu, off_fn) == ARM_SMP_CPU_OFF_FN);
+static_assert(offsetof(struct arm_smp_cpu, hvc) == ARM_SMP_CPU_HVC);
+
+/* all CPUs turned on with CPU_ON, online or not */
+static struct arm_smp_cpu **smp_cpus;
+static unsigned int smp_nr_cpus;
+static unsigned int smp_nr_online;
+static bool smp_started;
+static int smp_enable = 1;
+
+static inline unsigned int smp_load_acquire(const unsigned int *p)
+{
+	unsigned int val;
+
+	asm volatile("ldar %w0, %1" : "=r" (val) : "Q" (*p) : "memory");
+
+	return val;
+}
+
+static inline void smp_store_release(unsigned int *p, unsigned int val)
+{
+	asm volatile("stlr %w1, %0" : "=Q" (*p) : "r" (val) : "memory");
+}
+
+static inline void smp_send_event(void)
+{
+	asm volatile("dsb ish\n\tsev" : : : "memory");
+}
+
+static inline void smp_wait_event(void)
+{
+	asm volatile("wfe" : : : "memory");
+}
+
+void __noreturn arm_smp_secondary_main(struct arm_smp_cpu *cpu)
+{
+	const struct smp_work *work;
+	unsigned int seq = 0, s;
+
+	smp_store_release(&cpu->online, 1);
+	smp_send_event();
+
+	while (1) {
+		while ((s = smp_load_acquire(&cpu->seq)) == seq)
+			smp_wait_event();
+
+		seq = s;
+
+		if (READ_ONCE(cpu->stop))
+			break;
+
+		work = cpu->work;
+		cpu->ret = work->fn(work->data, cpu->job, cpu->index);
+
+		smp_store_release(&cpu->done, seq);
+		smp_send_event();
+	}
+
+	psci_invoke(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0, NULL);
+
+	while (1)
+		smp_wait_event();
+}
+
+static void smp_cpu_save_regs(struct arm_smp_cpu *cpu)
+{
+	unsigned int el = current_el();
+
+	cpu->el = el << 2;
+
+	if (el == 2) {
+		asm volatile("mrs %0, ttbr0_el2" : "=r" (cpu->ttbr));
+		asm volatile("mrs %0, tcr_el2" : "=r" (cpu->tcr));
+		asm volatile("mrs %0, mair_el2" : "=r" (cpu->mair));
+		asm volatile("mrs %0, sctlr_el2" : "=r" (cpu->sctlr));
+		asm volatile("mrs %0, vbar_el2" : "=r" (cpu->vbar));
+	} else {
+		asm volatile("mrs %0, ttbr0_el1" : "=r" (cpu->ttbr));
+		asm volatile("mrs %0, tcr_el1" : "=r" (cpu->tcr));
+		asm volatile("mrs %0, mair_el1" : "=r" (cpu->mair));
+		asm volatile("mrs %0, sctlr_el1" : "=r" (cpu->sctlr));
+		asm volatile("mrs %0, vbar_el1" : "=r" (cpu->vbar));
+	}
+}
+
+static int smp_cpu_start(struct arm_smp_cpu *cpu)
+{
+	unsigned long entry = (unsigned long)arm_smp_secondary_entry;
+	u64 start;
+	int ret;
+
+	smp_cpu_save_regs(cpu);
+	cpu->stack_top = (unsigned long)cpu->stack + SMP_STACK_SIZE;
+	cpu->off_fn = ARM_PSCI_0_2_FN_CPU_OFF;
+	cpu->hvc = psci_get_conduit() == SMCCC_CONDUIT_HVC;
+
+	/* The secondary reads these with its MMU and caches still off */
+	v8_flush_dcache_range((unsigned long)cpu, (unsigned long)(cpu + 1));
+	v8_flush_dcache_range(entry, (unsigned long)arm_smp_secondary_entry_end);
+
+	ret = psci_invoke(ARM_PSCI_0_2_FN64_CPU_ON, cpu->mpidr, entry,
+			  (unsigned long)cpu, NULL);
+	if (ret)
+		return ret;
+
+	start = get_time_ns();
+	while (!smp_load_acquire(&cpu->online)) {
+		if (is_timeout(start, SMP_TIMEOUT))
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static int smp_cpu_add(unsigned long mpidr)
+{
+	struct arm_smp_cpu *cpu;
+	int ret;
+
+	cpu = memalign(64, sizeof(*cpu));
+	if (!cpu)
+		return -ENOMEM;
+
+	memset(cpu, 0, sizeof(*cpu));
+	cpu->mpidr = mpidr;
+	cpu->index = smp_nr_online + 1;
+	cpu->stack = memalign(16, SMP_STACK_SIZE);
+	if (!cpu->stack) {
+		free(cpu);
+		return -ENOMEM;
+	}
+
+	ret = smp_cpu_start(cpu);
+	if (ret && ret != -ETIMEDOUT) {
+		pr_warn("Cannot start CPU 0x%lx: %pe\n", mpidr, ERR_PTR(ret));
+		free(cpu->stack);
+		free(cpu);
+		return ret;
+	}
+
+	/*
+	 * A CPU that did not check in might still come up later. It gets no
+	 * jobs, but is kept to be stopped along with the others.
+	 */
+	if (ret) {
+		pr_warn("CPU 0x%lx did not come online\n", mpidr);
+		cpu->state = ARM_SMP_CPU_STARTING;
+	} else {
+		cpu->state = ARM_SMP_CPU_ONLINE;
+		smp_nr_online++;
+	}
+
+	smp_cpus = xrealloc(smp_cpus, (smp_nr_cpus + 1) * sizeof(*smp_cpus));
+	smp_cpus[smp_nr_cpus++] = cpu;
+
+	return ret;
+}
+
+static unsigned int smp_workers_start(void)
+{
+	unsigned long boot_mpidr = read_mpidr() & MPIDR_HWID_BITMASK;
+	struct device_node *cpus, *np;
+	const char *str;
+	const __be32 *reg;
+	u64 mpidr;
+	int len;
+
+	if (smp_started || !smp_enable)
+		return smp_enable ? smp_nr_online : 0;
+
+	if (barebox_system_state != BAREBOX_RUNNING)
+		return 0;
+
+	smp_started = true;
+
+	if (psci_get_version() < ARM_PSCI_VER_0_2)
+		return 0;
+
+	cpus = of_find_node_by_path("/cpus");
+	if (!cpus)
+		return 0;
+
+	for_each_child_of_node(cpus, np) {
+		if (of_property_read_string(np, "device_type", &str) ||
+		    strcmp(str, "cpu"))
+			continue;
+		if (!of_device_is_available(np))
+			continue;
+		if (of_property_read_string(np, "enable-method", &str) ||
+		    strcmp(str, "psci"))
+			continue;
+
+		reg = of_get_property(np, "reg", &len);
+		if (!reg)
+			continue;
+
+		mpidr = of_read_number(reg, of_n_addr_cells(np));
+		if (mpidr == boot_mpidr)
+			continue;
+
+		smp_cpu_add(mpidr);
+	}
+
+	if (smp_nr_online)
+		pr_info("%u secondary CPUs online\n", smp_nr_online);
+
+	return smp_nr_online;
+}
+
+/**
+ * smp_num_cpus - number of CPUs running smp_run_jobs() jobs
+ *
+ * Return: the number of CPUs including the boot CPU, to size per-CPU
+ * state of jobs
+ */
+unsigned int smp_num_cpus(void)
+{
+	return smp_workers_start() + 1;
+}
+
+static bool smp_cpu_busy(struct arm_smp_cpu *cpu)
+{
+	return smp_load_acquire(&cpu->done) != cpu->seq;
+}
+
+static bool smp_cpu_online(struct arm_smp_cpu *cpu)
+{
+	return cpu->state == ARM_SMP_CPU_ONLINE;
+}
+
+static void smp_cpu_queue(struct arm_smp_cpu *cpu,
+			  const struct smp_work *work, unsigned int job)
+{
+	cpu->work = work;
+	cpu->job = job;
+	smp_store_release(&cpu->seq, cpu->seq + 1);
+}
+
+/**
+ * smp_run_jobs - run jobs on all available CPUs
+ * @fn: function to run for each job
+ * @data: context passed to @fn
+ * @njobs: number of jobs
+ *
+ * Runs @fn once for each job index below @njobs. Idle secondary CPUs get
+ * the next job, the boot CPU takes one itself whenever all of them are
+ * busy. No new jobs are handed out after a job failed.
+ *
+ * Return: 0 if all jobs succeeded, otherwise the error of a failed job
+ */
+int smp_run_jobs(smp_job_fn fn, void *data, unsigned int njobs)
+{
+	struct smp_work work = {
+		.fn = fn,
+		.data = data,
+	};
+	unsigned int next = 0, ncpus, i;
+	int ret = 0;
+
+	ncpus = smp_workers_start() ? smp_nr_cpus : 0;
+
+	/* secondaries are idle, so their result fields may be reset */
+	for (i = 0; i < ncpus; i++)
+		smp_cpus[i]->ret = 0;
+
+	while (next < njobs && !ret) {
+		for (i = 0; i < ncpus && next < njobs; i++) {
+			struct arm_smp_cpu *cpu = smp_cpus[i];
+
+			if (!smp_cpu_online(cpu) || smp_cpu_busy(cpu))
+				continue;
+
+			ret = cpu->ret;
+			if (ret)
+				break;
+
+			smp_cpu_queue(cpu, &work, next++);
+		}
+
+		smp_send_event();
+
+		if (next < njobs && !ret)
+			ret = fn(data, next++, 0);
+	}
+
+	for (i = 0; i < ncpus; i++) {
+		struct arm_smp_cpu *cpu = smp_cpus[i];
+
+		if (!smp_cpu_online(cpu))
+			continue;
+
+		while (smp_cpu_busy(cpu))
+			smp_wait_event();
+
+		if (!ret)
+			ret = cpu->ret;
+	}
+
+	return ret;
+}
+
+/**
+ * smp_workers_stop - turn off all secondary CPUs
+ *
+ * Called before barebox hands over control, as the next stage expects
+ * all secondary CPUs to be off. This includes CPUs that did not check in
+ * in time: should they come up late, they find the stop request right
+ * away and turn themselves off.
+ */
+void smp_workers_stop(void)
+{
+	unsigned int i;
+	u64 start;
+	int ret;
+
+	for (i = 0; i < smp_nr_cpus; i++) {
+		struct arm_smp_cpu *cpu = smp_cpus[i];
+
+		WRITE_ONCE(cpu->stop, true);
+		smp_store_release(&cpu->seq, cpu->seq + 1);
+	}
+
+	smp_send_event();
+
+	for (i = 0; i < smp_nr_cpus; i++) {
+		struct arm_smp_cpu *cpu = smp_cpus[i];
+
+		start = get_time_ns();
+		do {
+			ret = psci_invoke(ARM_PSCI_0_2_FN64_AFFINITY_INFO,
+					  cpu->mpidr, 0, 0, NULL);
+			if (ret == PSCI_AFFINITY_LEVEL_OFF)
+				break;
+		} while (!is_timeout(start, SMP_TIMEOUT));
+
+		/* a CPU still running might use its memory at any time */
+		if (ret != PSCI_AFFINITY_LEVEL_OFF) {
+			pr_warn("CPU 0x%lx did not turn off\n", cpu->mpidr);
+			continue;
+		}
+
+		free(cpu->stack);
+		free(cpu);
+	}
+
+	free(smp_cpus);
+	smp_cpus = NULL;
+	smp_nr_cpus = 0;
+	smp_nr_online = 0;
+	smp_started = true;
+}
+early_exitcall(smp_workers_stop);
+
+static int smp_init(void)
+{
+	globalvar_add_simple_bool("smp.enable", &smp_enable);
+
+	return 0;
+}
+device_initcall(smp_init);
+
+BAREBOX_MAGICVAR(global.smp.enable,
+		 "Use secondary CPUs for hashing and decompression");
@@ -7,6 +7,7 @@
 #define __ARM_PSCI_H__
 
 #include <linux/compiler.h>
+#include <linux/arm-smccc.h>
 
 struct device_node;
 
@@ -104,6 +105,8 @@ int psci_invoke(ulong function, ulong arg0, ulong arg1, ulong arg2,
 		ulong *result);
 
 int psci_get_version(void);
+
+enum arm_smccc_conduit psci_get_conduit(void);
 #else
 static inline int psci_invoke(ulong function, ulong arg0, ulong arg1, ulong arg2,
 		ulong *result)
@@ -115,6 +118,11 @@ static inline int psci_get_version(void)
 {
 	return -ENOSYS;
 }
+
+static inline enum arm_smccc_conduit psci_get_conduit(void)
+{
+	return SMCCC_CONDUIT_NONE;
+}
 #endif
 
 void psci_cpu_entry(void);
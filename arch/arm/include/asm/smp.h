@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __ASM_ARM_SMP_H
+#define __ASM_ARM_SMP_H
+
+/*
+ * Offsets into struct arm_smp_cpu of the fields read by the secondary
+ * entry code before the MMU is enabled.
+ */
+#define ARM_SMP_CPU_STACK	0
+#define ARM_SMP_CPU_TTBR	8
+#define ARM_SMP_CPU_TCR		16
+#define ARM_SMP_CPU_MAIR	24
+#define ARM_SMP_CPU_SCTLR	32
+#define ARM_SMP_CPU_VBAR	40
+#define ARM_SMP_CPU_EL		48
+#define ARM_SMP_CPU_OFF_FN	56
+#define ARM_SMP_CPU_HVC		64
+
+#ifndef __ASSEMBLY__
+
+#include <linux/types.h>
+
+enum arm_smp_cpu_state {
+	ARM_SMP_CPU_STARTING,	/* CPU_ON succeeded, but no check-in yet */
+	ARM_SMP_CPU_ONLINE,	/* waiting for jobs */
+};
+
+struct arm_smp_cpu {
+	/* Read with the MMU off, must be cleaned to PoC before CPU_ON */
+	u64 stack_top;
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 sctlr;
+	u64 vbar;
+	u64 el;
+	u64 off_fn;
+	u64 hvc;
+
+	/* Only accessed with caches enabled on both sides */
+	unsigned long mpidr;
+	unsigned int index;
+	unsigned int online;
+	enum arm_smp_cpu_state state;
+
+	/* Mailbox: written by the boot CPU only */
+	const struct smp_work *work;
+	unsigned int job;
+	unsigned int seq;
+	bool stop;
+
+	/* written by the secondary CPU, ret reset by the boot CPU while idle */
+	unsigned int done;
+	int ret;
+
+	void *stack;
+};
+
+void arm_smp_secondary_entry(struct arm_smp_cpu *cpu);
+void __noreturn arm_smp_secondary_main(struct arm_smp_cpu *cpu);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_ARM_SMP_H */
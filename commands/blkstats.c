@@ -10,7 +10,7 @@ static int do_blkstats(int argc, char *argv[])
 {
 	struct block_device *blk;
 	const char *name;
-	bool first = false;
+	bool first = true;
 	int opt;
 
 	while ((opt = getopt(argc, argv, "l")) > 0) {
@@ -36,15 +36,19 @@ static int do_blkstats(int argc, char *argv[])
 			continue;
 
 		if (first) {
-			printf("%-16s %10s %10s %10s\n",
-			       "Device", "Read", "Write", "Erase");
-			first = true;
+			printf("%-16s %10s %10s %10s %10s %10s %10s %10s\n",
+			       "Device", "Read", "Direct", "Ahead", "Write", "Erase",
+			       "Hits", "Misses");
+			first = false;
 		}
 
 		stats = &blk->stats;
 
-		printf("%-16s %10llu %10llu %10llu\n", blk->cdev.name,
-		       stats->read_sectors, stats->write_sectors, stats->erase_sectors);
+		printf("%-16s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+		       blk->cdev.name, stats->read_sectors,
+		       stats->direct_read_sectors, stats->readahead_sectors,
+		       stats->write_sectors, stats->erase_sectors,
+		       stats->cache_hits, stats->cache_misses);
 	}
 
 	return 0;
@@ -52,6 +56,9 @@ static int do_blkstats(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(blkstats)
 BAREBOX_CMD_HELP_TEXT("Display a block device's number of read, written and erased sectors")
+BAREBOX_CMD_HELP_TEXT("The Direct column counts the read sectors that bypassed the block cache,")
+BAREBOX_CMD_HELP_TEXT("Ahead those that were read ahead for sequential streams. Hits and Misses")
+BAREBOX_CMD_HELP_TEXT("count sector lookups in the block cache.")
 BAREBOX_CMD_HELP_TEXT("")
 BAREBOX_CMD_HELP_TEXT("Options:")
 BAREBOX_CMD_HELP_OPT("-l",  "list all currently registered block devices")
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <common.h>
+#include <command.h>
+#include <boottrace.h>
+#include <getopt.h>
+#include <libfile.h>
+#include <malloc.h>
+
+static int do_boottrace(int argc, char *argv[])
+{
+	bool clear = false;
+	ssize_t len;
+	char *buf;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "c")) > 0) {
+		switch (opt) {
+		case 'c':
+			clear = true;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	argv += optind;
+	argc -= optind;
+
+	if (clear && !argc) {
+		boottrace_clear();
+		return 0;
+	}
+
+	len = boottrace_format(NULL, 0);
+	if (len < 0)
+		return len;
+
+	buf = malloc(len + 1);
+	if (!buf)
+		return -ENOMEM;
+
+	len = boottrace_format(buf, len + 1);
+	if (len < 0) {
+		ret = len;
+		goto out;
+	}
+
+	if (argc) {
+		ret = write_file(argv[0], buf, len);
+		if (ret)
+			printf("Cannot write %s: %pe\n", argv[0], ERR_PTR(ret));
+	} else {
+		puts(buf);
+	}
+
+	if (clear && !ret)
+		boottrace_clear();
+out:
+	free(buf);
+
+	return ret ? COMMAND_ERROR : 0;
+}
+
+BAREBOX_CMD_HELP_START(boottrace)
+BAREBOX_CMD_HELP_TEXT("Output the recorded boot trace in Chrome trace event JSON format.")
+BAREBOX_CMD_HELP_TEXT("The result can be loaded into chrome://tracing or ui.perfetto.dev.")
+BAREBOX_CMD_HELP_TEXT("Without FILE, the trace is printed to the console.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT("-c",  "clear the trace buffer (after writing FILE, if given)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(boottrace)
+	.cmd		= do_boottrace,
+	BAREBOX_CMD_DESC("export the boot trace")
+	BAREBOX_CMD_OPTS("[-c] [FILE]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_boottrace_help)
+BAREBOX_CMD_END
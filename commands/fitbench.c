@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/* fitbench.c - measure the stages of loading an image from a FIT */
+
+#include <common.h>
+#include <command.h>
+#include <clock.h>
+#include <digest.h>
+#include <getopt.h>
+#include <image-fit.h>
+#include <malloc.h>
+#include <of.h>
+#include <uncompress.h>
+#include <linux/err.h>
+
+static void fitbench_report(const char *stage, size_t bytes, u64 ns)
+{
+	u64 kbps = ns ? div64_u64((u64)bytes * 1000000, ns) : 0;
+	u32 frac;
+	u64 mbps = div_u64_rem(kbps, 1000, &frac);
+
+	printf("%-22s %10zu bytes %8llu us %6llu.%03u MB/s\n", stage, bytes,
+	       div_u64(ns, 1000), mbps, frac);
+}
+
+static struct digest *fitbench_digest(struct device_node *image)
+{
+	struct device_node *hash;
+	const char *algo = "sha256";
+
+	hash = of_get_child_by_name(image, "hash-1");
+	if (!hash)
+		hash = of_get_child_by_name(image, "hash@1");
+	if (hash)
+		of_property_read_string(hash, "algo", &algo);
+
+	return digest_alloc(algo);
+}
+
+static int do_fitbench(int argc, char *argv[])
+{
+	const char *confname = NULL, *imgname = "kernel", *unit;
+	struct fit_handle *fit;
+	struct device_node *conf, *image;
+	const char *compression = NULL;
+	struct digest *d = NULL;
+	void *uc_data = NULL, *dest = NULL;
+	const void *data;
+	ssize_t uc_len = 0;
+	int opt, data_len, ret;
+	u64 start, t_hash, t_uncompress = 0, t_copy, t_single = 0;
+
+	while ((opt = getopt(argc, argv, "c:n:")) > 0) {
+		switch (opt) {
+		case 'c':
+			confname = optarg;
+			break;
+		case 'n':
+			imgname = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind != argc - 1)
+		return COMMAND_ERROR_USAGE;
+
+	fit = fit_open(argv[optind], false, BOOTM_VERIFY_NONE);
+	if (IS_ERR(fit)) {
+		printf("Cannot open %s: %pe\n", argv[optind], fit);
+		return COMMAND_ERROR;
+	}
+
+	conf = fit_open_configuration(fit, confname, NULL);
+	if (IS_ERR(conf)) {
+		ret = PTR_ERR(conf);
+		goto out;
+	}
+
+	ret = -ENOENT;
+	if (of_property_read_string(conf, imgname, &unit)) {
+		printf("configuration has no %s image\n", imgname);
+		goto out;
+	}
+
+	image = of_get_child_by_name(fit->images, unit);
+	data = image ? of_get_property(image, "data", &data_len) : NULL;
+	if (!data) {
+		printf("image %s has no data\n", unit);
+		goto out;
+	}
+
+	of_property_read_string(image, "compression", &compression);
+	if (compression && !strcmp(compression, "none"))
+		compression = NULL;
+
+	d = fitbench_digest(image);
+	if (!d) {
+		printf("unsupported hash algorithm\n");
+		goto out;
+	}
+
+	printf("image '%s': %d bytes, compression %s, %s\n", unit, data_len,
+	       compression ?: "none", digest_name(d));
+
+	/* the current path: hash, then decompress, then copy to load address */
+	start = get_time_ns();
+	digest_init(d);
+	digest_update(d, data, data_len);
+	t_hash = get_time_ns() - start;
+	fitbench_report("hash", data_len, t_hash);
+
+	if (compression) {
+		start = get_time_ns();
+		uc_len = uncompress_buf_to_buf(data, data_len, &uc_data,
+					       uncompress_err_stdout);
+		t_uncompress = get_time_ns() - start;
+		if (uc_len < 0) {
+			ret = uc_len;
+			goto out;
+		}
+		fitbench_report("decompress", uc_len, t_uncompress);
+	} else {
+		uc_data = xmemdup(data, data_len);
+		uc_len = data_len;
+	}
+
+	dest = malloc(uc_len);
+	if (!dest) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	start = get_time_ns();
+	memcpy(dest, uc_data, uc_len);
+	t_copy = get_time_ns() - start;
+	fitbench_report("copy", uc_len, t_copy);
+	fitbench_report("total", uc_len, t_hash + t_uncompress + t_copy);
+
+	if (compression) {
+		free(uc_data);
+		uc_data = NULL;
+
+		/* the single pass: hash while decompressing */
+		start = get_time_ns();
+		digest_init(d);
+		uc_len = uncompress_buf_to_buf_digest(data, data_len, &uc_data, d,
+						      uncompress_err_stdout);
+		t_single = get_time_ns() - start;
+		if (uc_len < 0) {
+			ret = uc_len;
+			goto out;
+		}
+		fitbench_report("hash+decompress", uc_len, t_single);
+
+		start = get_time_ns();
+		memcpy(dest, uc_data, uc_len);
+		t_copy = get_time_ns() - start;
+		fitbench_report("total (single pass)", uc_len, t_single + t_copy);
+	}
+
+	ret = 0;
+out:
+	free(dest);
+	free(uc_data);
+	digest_free(d);
+	fit_close(fit);
+
+	if (ret)
+		printf("fitbench failed: %pe\n", ERR_PTR(ret));
+
+	return ret ? COMMAND_ERROR : 0;
+}
+
+BAREBOX_CMD_HELP_START(fitbench)
+BAREBOX_CMD_HELP_TEXT("Measure hashing, decompressing and copying an image from a FIT")
+BAREBOX_CMD_HELP_TEXT("image, once in separate passes as done by default and once with")
+BAREBOX_CMD_HELP_TEXT("hashing and decompressing in a single pass.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT("-c CONFIG", "use configuration CONFIG instead of the default one")
+BAREBOX_CMD_HELP_OPT("-n NAME", "measure image NAME of the configuration (default: kernel)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(fitbench)
+	.cmd		= do_fitbench,
+	BAREBOX_CMD_DESC("benchmark loading an image from a FIT")
+	BAREBOX_CMD_OPTS("[-cn] FILE")
+	BAREBOX_CMD_GROUP(CMD_GRP_BOOT)
+	BAREBOX_CMD_HELP(cmd_fitbench_help)
+BAREBOX_CMD_END
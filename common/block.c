@@ -10,10 +10,13 @@
 #include <malloc.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 #include <dma.h>
 #include <range.h>
 #include <bootargs.h>
 #include <file-list.h>
+#include <boottrace.h>
 
 LIST_HEAD(block_device_list);
 EXPORT_SYMBOL(block_device_list);
@@ -23,12 +26,20 @@ struct chunk {
 	void *data; /* data buffer */
 	sector_t block_start; /* first block in this chunk */
 	int dirty; /* need to write back to device */
-	int num; /* number of chunk, debugging only */
+	int num; /* slot of this chunk in blk->chunks */
 	struct list_head list;
+	struct hlist_node hnode;
+	struct blk_request req; /* read-ahead or write-back in flight */
 };
 
 #define BUFSIZE (PAGE_SIZE * 16)
 
+/* Default number of chunks cached per device if the driver doesn't set one */
+#define BLOCK_CACHE_CHUNKS	8
+
+/* Upper limit for the number of requests kept in flight by one caller */
+#define BLOCK_MAX_INFLIGHT	32
+
 static int writebuffer_io_len(struct block_device *blk, struct chunk *chunk)
 {
 	return min_t(blkcnt_t, blk->rdbufsize, blk->num_blocks - chunk->block_start);
@@ -39,6 +50,21 @@ static void blk_stats_record_read(struct block_device *blk, blkcnt_t count)
 {
 	blk->stats.read_sectors += count;
 }
+static void blk_stats_record_direct_read(struct block_device *blk, blkcnt_t count)
+{
+	blk->stats.direct_read_sectors += count;
+}
+static void blk_stats_record_readahead(struct block_device *blk, blkcnt_t count)
+{
+	blk->stats.readahead_sectors += count;
+}
+static void blk_stats_record_cache(struct block_device *blk, bool hit)
+{
+	if (hit)
+		blk->stats.cache_hits++;
+	else
+		blk->stats.cache_misses++;
+}
 static void blk_stats_record_write(struct block_device *blk, blkcnt_t count)
 {
 	blk->stats.write_sectors += count;
@@ -49,10 +75,195 @@ static void blk_stats_record_erase(struct block_device *blk, blkcnt_t count)
 }
 #else
 static void blk_stats_record_read(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_direct_read(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_readahead(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_cache(struct block_device *blk, bool hit) { }
 static void blk_stats_record_write(struct block_device *blk, blkcnt_t count) { }
 static void blk_stats_record_erase(struct block_device *blk, blkcnt_t count) { }
 #endif
 
+/*
+ * Drivers without a submit operation get their requests executed
+ * synchronously.
+ */
+static int blk_submit_sync(struct block_device *blk, struct blk_request *req)
+{
+	int ret;
+
+	if (req->write)
+		ret = blk->ops->write(blk, req->buf, req->block, req->num_blocks);
+	else
+		ret = blk->ops->read(blk, req->buf, req->block, req->num_blocks);
+
+	blk_request_complete(req, ret);
+
+	return 0;
+}
+
+/**
+ * blk_submit - queue a request
+ * @blk: The block device
+ * @req: The request
+ *
+ * Hands @req to the driver, waiting for a free slot if the driver's queue
+ * is full. The request completes asynchronously, use blk_wait() or a
+ * completion callback to pick up the result. The completion callback is
+ * called exactly once, also when submitting fails.
+ *
+ * Return: 0 if the request was queued, a negative error code otherwise
+ */
+int blk_submit(struct block_device *blk, struct blk_request *req)
+{
+	int ret;
+
+	req->blk = blk;
+	req->status = -EINPROGRESS;
+	req->start = get_time_ns();
+
+	if (!blk->ops->submit)
+		return blk_submit_sync(blk, req);
+
+	while (1) {
+		ret = blk->ops->submit(blk, req);
+		if (ret != -EBUSY)
+			break;
+		blk_poll(blk);
+	}
+
+	if (ret)
+		blk_request_complete(req, ret);
+
+	return ret;
+}
+EXPORT_SYMBOL(blk_submit);
+
+/**
+ * blk_poll - reap finished requests
+ * @blk: The block device
+ *
+ * Return: The number of requests completed
+ */
+int blk_poll(struct block_device *blk)
+{
+	if (!blk->ops->poll)
+		return 0;
+
+	return blk->ops->poll(blk);
+}
+EXPORT_SYMBOL(blk_poll);
+
+/**
+ * blk_wait - wait for a request to finish
+ * @req: The request
+ *
+ * Drivers are responsible for failing requests which take too long, so
+ * this returns eventually.
+ *
+ * Return: The status of the request
+ */
+int blk_wait(struct blk_request *req)
+{
+	while (blk_request_pending(req))
+		blk_poll(req->blk);
+
+	return req->status;
+}
+EXPORT_SYMBOL(blk_wait);
+
+/**
+ * blk_request_complete - finish a request
+ * @req: The request
+ * @status: 0 for success or a negative error code
+ *
+ * Called by drivers when they are done with a request.
+ */
+void blk_request_complete(struct blk_request *req, int status)
+{
+	struct block_device *blk = req->blk;
+
+	req->status = status;
+
+	boottrace_addf(BOOTTRACE_BLOCK, req->start, "%s %s %llu+%llu",
+		       blk->cdev.name, req->write ? "write" : "read",
+		       req->block, req->num_blocks);
+
+	if (req->complete)
+		req->complete(req);
+}
+EXPORT_SYMBOL(blk_request_complete);
+
+/**
+ * blk_rw_sync - read or write blocks and wait for the result
+ * @blk: The block device
+ * @write: true for writing
+ * @buf: The data buffer
+ * @block: The first block
+ * @num_blocks: The number of blocks
+ *
+ * Transfers larger than the driver's request size limit are split up and
+ * up to queue_depth of the pieces are kept in flight at the same time.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int blk_rw_sync(struct block_device *blk, bool write, void *buf,
+		sector_t block, blkcnt_t num_blocks)
+{
+	unsigned int depth = clamp_t(unsigned int, blk->queue_depth, 1,
+				     BLOCK_MAX_INFLIGHT);
+	blkcnt_t max = blk->max_request_blocks ?: num_blocks;
+	struct blk_request single, *reqs = &single;
+	unsigned int n, i;
+	int ret = 0;
+
+	if (num_blocks <= max)
+		depth = 1;
+	else
+		depth = min_t(blkcnt_t, depth, DIV_ROUND_UP(num_blocks, max));
+
+	if (depth > 1)
+		reqs = xmalloc(depth * sizeof(*reqs));
+
+	for (n = 0; num_blocks; n++) {
+		struct blk_request *req = &reqs[n % depth];
+		blkcnt_t now = min(num_blocks, max);
+
+		if (n >= depth) {
+			ret = blk_wait(req);
+			if (ret)
+				break;
+		}
+
+		blk_request_init(req, blk, write, buf, block, now);
+		ret = blk_submit(blk, req);
+		if (ret) {
+			n++;
+			break;
+		}
+
+		buf += now << blk->blockbits;
+		block += now;
+		num_blocks -= now;
+	}
+
+	for (i = 0; i < min(n, depth); i++) {
+		int err = blk_wait(&reqs[i]);
+
+		if (!ret)
+			ret = err;
+	}
+
+	if (reqs != &single)
+		free(reqs);
+
+	return ret;
+}
+EXPORT_SYMBOL(blk_rw_sync);
+
+static bool blk_can_write(struct block_device *blk)
+{
+	return blk->ops->write || blk->ops->submit;
+}
+
 static int chunk_flush(struct block_device *blk, struct chunk *chunk)
 {
 	size_t len;
@@ -61,11 +272,11 @@ static int chunk_flush(struct block_device *blk, struct chunk *chunk)
 	if (!chunk->dirty)
 		return 0;
 
-	if (!blk->ops->write)
+	if (!blk_can_write(blk))
 		return 0;
 
 	len = writebuffer_io_len(blk, chunk);
-	ret = blk->ops->write(blk, chunk->data, chunk->block_start, len);
+	ret = blk_rw_sync(blk, true, chunk->data, chunk->block_start, len);
 	if (ret < 0)
 		return ret;
 
@@ -77,50 +288,110 @@ static int chunk_flush(struct block_device *blk, struct chunk *chunk)
 }
 
 /*
- * Write all dirty chunks back to the device
+ * Write all dirty chunks back to the device. All chunks are submitted
+ * before waiting for the first one, so that queueing drivers can work on
+ * them in parallel.
  */
 static int writebuffer_flush(struct block_device *blk)
 {
 	struct chunk *chunk;
-	int ret;
+	int ret = 0;
 
 	if (!IS_ENABLED(CONFIG_BLOCK_WRITE))
 		return 0;
 
+	if (!blk_can_write(blk))
+		return 0;
+
 	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		ret = chunk_flush(blk, chunk);
-		if (ret < 0)
-			return ret;
+		if (!chunk->dirty)
+			continue;
+
+		blk_request_init(&chunk->req, blk, true, chunk->data,
+				 chunk->block_start, writebuffer_io_len(blk, chunk));
+		blk_submit(blk, &chunk->req);
+	}
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		int err;
+
+		if (!chunk->dirty)
+			continue;
+
+		err = blk_wait(&chunk->req);
+		if (err) {
+			ret = ret ?: err;
+			continue;
+		}
+
+		blk_stats_record_write(blk, chunk->req.num_blocks);
+		chunk->dirty = 0;
 	}
 
+	if (ret)
+		return ret;
+
 	if (blk->ops->flush)
 		return blk->ops->flush(blk);
 
 	return 0;
 }
 
+static struct hlist_head *chunk_hash_head(struct block_device *blk,
+					  sector_t block_start)
+{
+	return &blk->chunk_hash[hash_64(block_start, blk->chunk_hash_bits)];
+}
+
+static struct chunk *chunk_lookup(struct block_device *blk, sector_t block_start)
+{
+	struct chunk *chunk;
+
+	hlist_for_each_entry(chunk, chunk_hash_head(blk, block_start), hnode)
+		if (chunk->block_start == block_start)
+			return chunk;
+
+	return NULL;
+}
+
+/*
+ * Take a chunk out of the cache and put it on the idle list.
+ */
+static void chunk_release(struct block_device *blk, struct chunk *chunk)
+{
+	hlist_del_init(&chunk->hnode);
+	list_move(&chunk->list, &blk->idle_blocks);
+}
+
 /*
  * get the chunk containing a given block. Will return NULL if the
- * block is not cached, the chunk otherwise.
+ * block is not cached, the chunk otherwise. A chunk still being read
+ * ahead is waited for, if that read failed the chunk is dropped.
  */
 static struct chunk *chunk_get_cached(struct block_device *blk, sector_t block)
 {
 	struct chunk *chunk;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
-			dev_vdbg(blk->dev, "%s: found %llu in %d\n", __func__,
-				block, chunk->num);
-			/*
-			 * move most recently used entry to the head of the list
-			 */
-			list_move(&chunk->list, &blk->buffered_blocks);
-			return chunk;
-		}
+	chunk = chunk_lookup(blk, block & ~blk->blkmask);
+	if (!chunk)
+		return NULL;
+
+	if (blk_wait(&chunk->req) && !chunk->req.write) {
+		dev_dbg(blk->dev, "read-ahead of %llu failed: %pe\n",
+			chunk->block_start, ERR_PTR(chunk->req.status));
+		chunk->req.status = 0;
+		chunk_release(blk, chunk);
+		return NULL;
 	}
 
-	return NULL;
+	dev_vdbg(blk->dev, "%s: found %llu in %d\n", __func__,
+		block, chunk->num);
+	/*
+	 * move most recently used entry to the head of the list
+	 */
+	list_move(&chunk->list, &blk->buffered_blocks);
+
+	return chunk;
 }
 
 /*
@@ -139,28 +410,143 @@ static void *block_get_cached(struct block_device *blk, sector_t block)
 }
 
 /*
- * Get a data chunk, either from the idle list or if the idle list
- * is empty, the least recently used is written back to disk and
- * returned.
+ * Get @num chunks with adjacent data buffers so that they can be filled
+ * with a single read. The range starts at the first idle chunk or, if
+ * there is none, at the least recently used one. Dirty chunks in the
+ * range are written back to disk first. The chunks are returned
+ * detached from all lists.
  */
-static struct chunk *get_chunk(struct block_device *blk)
+static struct chunk *get_chunks(struct block_device *blk, unsigned int num)
 {
-	struct chunk *chunk;
+	struct chunk *victim;
+	unsigned int first, i;
 	int ret;
 
-	if (list_empty(&blk->idle_blocks)) {
-		/* use last entry which is the most unused */
-		chunk = list_last_entry(&blk->buffered_blocks, struct chunk, list);
+	if (list_empty(&blk->idle_blocks))
+		victim = list_last_entry(&blk->buffered_blocks, struct chunk, list);
+	else
+		victim = list_first_entry(&blk->idle_blocks, struct chunk, list);
+
+	first = min_t(unsigned int, victim->num, blk->cache_chunks - num);
+
+	for (i = first; i < first + num; i++) {
+		struct chunk *chunk = &blk->chunks[i];
+
+		/* the data is thrown away, so the result doesn't matter */
+		blk_wait(&chunk->req);
+		chunk->req.status = 0;
+
 		ret = chunk_flush(blk, chunk);
 		if (ret < 0)
 			return ERR_PTR(ret);
-	} else {
-		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
 	}
 
-	list_del(&chunk->list);
+	for (i = first; i < first + num; i++) {
+		hlist_del_init(&blk->chunks[i].hnode);
+		list_del(&blk->chunks[i].list);
+	}
 
-	return chunk;
+	return &blk->chunks[first];
+}
+
+/*
+ * Return the number of chunks to read when @block_start is missing from
+ * the cache. A miss directly following the previous one is treated as a
+ * sequential stream and doubles the read-ahead window, any other miss
+ * resets it. The window is limited to half of the cache so that a stream
+ * cannot evict everything else.
+ */
+static unsigned int block_readahead_chunks(struct block_device *blk,
+					   sector_t block_start)
+{
+	unsigned int max = max(blk->cache_chunks / 2, 1U);
+	loff_t chunk_bytes = (loff_t)blk->rdbufsize << blk->blockbits;
+	unsigned int num;
+
+	if (block_start == blk->ra_next)
+		blk->ra_chunks = min(blk->ra_chunks * 2, max);
+	else
+		blk->ra_chunks = 1;
+
+	for (num = 1; num < blk->ra_chunks; num++) {
+		sector_t next = block_start + (sector_t)num * blk->rdbufsize;
+
+		if (next >= blk->num_blocks)
+			break;
+		if (region_overlap_size(next << blk->blockbits, chunk_bytes,
+					blk->discard_start, blk->discard_size))
+			break;
+		/* don't read a chunk we already have a copy of */
+		if (chunk_lookup(blk, next))
+			break;
+	}
+
+	return num;
+}
+
+/*
+ * Variant of block_cache() for drivers with a request queue: every chunk
+ * gets a request of its own, only the first one is waited for. The
+ * read-ahead chunks are hashed right away and are waited for when they
+ * are looked up.
+ */
+static int block_cache_queued(struct block_device *blk, struct chunk *chunks,
+			      unsigned int num, sector_t block_start, blkcnt_t len)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = num; i > 0; i--) {
+		struct chunk *chunk = &chunks[i - 1];
+
+		chunk->block_start = block_start + (sector_t)(i - 1) * blk->rdbufsize;
+		list_add(&chunk->list, &blk->buffered_blocks);
+		hlist_add_head(&chunk->hnode, chunk_hash_head(blk, chunk->block_start));
+	}
+
+	for (i = 0; i < num; i++) {
+		struct chunk *chunk = &chunks[i];
+
+		blk_request_init(&chunk->req, blk, false, chunk->data,
+				 chunk->block_start, writebuffer_io_len(blk, chunk));
+		blk_submit(blk, &chunk->req);
+	}
+
+	ret = blk_wait(&chunks->req);
+	if (ret) {
+		chunks->req.status = 0;
+		chunk_release(blk, chunks);
+		blk->ra_chunks = 1;
+		return ret;
+	}
+
+	blk_stats_record_read(blk, len);
+	blk_stats_record_readahead(blk, len - min_t(blkcnt_t, len, blk->rdbufsize));
+
+	blk->ra_next = block_start + (sector_t)num * blk->rdbufsize;
+
+	return 0;
+}
+
+/*
+ * Chunks which lie entirely in the discard range are not read from the
+ * device, they read as zeroes. Returns them as a range of blocks.
+ */
+static void block_discarded_chunks(struct block_device *blk,
+				   sector_t *start, sector_t *end)
+{
+	loff_t chunk_bytes = (loff_t)blk->rdbufsize << blk->blockbits;
+	loff_t first = round_up(blk->discard_start, chunk_bytes);
+	loff_t last = round_down(blk->discard_start + blk->discard_size,
+				 chunk_bytes);
+
+	if (last <= first) {
+		*start = *end = 0;
+		return;
+	}
+
+	*start = first >> blk->blockbits;
+	*end = last >> blk->blockbits;
 }
 
 /*
@@ -170,36 +556,63 @@ static struct chunk *get_chunk(struct block_device *blk)
  */
 static int block_cache(struct block_device *blk, sector_t block)
 {
-	struct chunk *chunk;
-	size_t len;
+	sector_t block_start = block & ~blk->blkmask;
+	sector_t discard_start, discard_end;
+	struct chunk *chunks;
+	unsigned int num, i;
+	blkcnt_t len;
 	int ret;
 
-	chunk = get_chunk(blk);
-	if (IS_ERR(chunk))
-		return PTR_ERR(chunk);
-
-	chunk->block_start = block & ~blk->blkmask;
+	block_discarded_chunks(blk, &discard_start, &discard_end);
 
-	dev_vdbg(blk->dev, "%s: %llu to %d\n", __func__, chunk->block_start,
-		chunk->num);
+	if (block_start >= discard_start && block_start < discard_end) {
+		chunks = get_chunks(blk, 1);
+		if (IS_ERR(chunks))
+			return PTR_ERR(chunks);
 
-	len = writebuffer_io_len(blk, chunk);
-	if (chunk->block_start * BLOCKSIZE(blk) >= blk->discard_start &&
-	    chunk->block_start * BLOCKSIZE(blk) + len
-	    <= blk->discard_start + blk->discard_size) {
-		memset(chunk->data, 0, len);
-		list_add(&chunk->list, &blk->buffered_blocks);
+		chunks->block_start = block_start;
+		memset(chunks->data, 0, writebuffer_io_len(blk, chunks));
+		list_add(&chunks->list, &blk->buffered_blocks);
+		hlist_add_head(&chunks->hnode, chunk_hash_head(blk, block_start));
 		return 0;
 	}
 
-	ret = blk->ops->read(blk, chunk->data, chunk->block_start, len);
+	num = block_readahead_chunks(blk, block_start);
+
+	chunks = get_chunks(blk, num);
+	if (IS_ERR(chunks))
+		return PTR_ERR(chunks);
+
+	dev_vdbg(blk->dev, "%s: %llu to %d (%u chunks)\n", __func__,
+		block_start, chunks->num, num);
+
+	len = min_t(blkcnt_t, (blkcnt_t)num * blk->rdbufsize,
+		    blk->num_blocks - block_start);
+
+	if (blk->queue_depth > 1)
+		return block_cache_queued(blk, chunks, num, block_start, len);
+
+	ret = blk_rw_sync(blk, false, chunks->data, block_start, len);
 	if (ret) {
-		list_add_tail(&chunk->list, &blk->idle_blocks);
+		for (i = 0; i < num; i++)
+			list_add_tail(&chunks[i].list, &blk->idle_blocks);
+		blk->ra_chunks = 1;
 		return ret;
 	}
 
 	blk_stats_record_read(blk, len);
-	list_add(&chunk->list, &blk->buffered_blocks);
+	blk_stats_record_readahead(blk, len - min_t(blkcnt_t, len, blk->rdbufsize));
+
+	/* add in reverse order so that the requested chunk ends up first */
+	for (i = num; i > 0; i--) {
+		struct chunk *chunk = &chunks[i - 1];
+
+		chunk->block_start = block_start + (sector_t)(i - 1) * blk->rdbufsize;
+		list_add(&chunk->list, &blk->buffered_blocks);
+		hlist_add_head(&chunk->hnode, chunk_hash_head(blk, chunk->block_start));
+	}
+
+	blk->ra_next = block_start + (sector_t)num * blk->rdbufsize;
 
 	return 0;
 }
@@ -217,6 +630,7 @@ static void *block_get(struct block_device *blk, sector_t block)
 		return ERR_PTR(-ENXIO);
 
 	outdata = block_get_cached(blk, block);
+	blk_stats_record_cache(blk, outdata);
 	if (outdata)
 		return outdata;
 
@@ -231,6 +645,73 @@ static void *block_get(struct block_device *blk, sector_t block)
 	return outdata;
 }
 
+/*
+ * Large reads into a suitably aligned buffer are passed to the driver
+ * directly instead of going through the chunk cache. This avoids copying
+ * the data twice and keeps bulk reads from evicting the cached metadata.
+ */
+static bool block_can_read_direct(struct block_device *blk, const void *buf,
+				  sector_t block, blkcnt_t num_blocks)
+{
+	return num_blocks >= blk->rdbufsize &&
+	       block + num_blocks <= blk->num_blocks &&
+	       IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT);
+}
+
+/*
+ * Read blocks from the device straight into buf. Discarded chunks read as
+ * zeroes, as in block_cache(). Dirty chunks hold newer data than the
+ * device, so they are copied over the data just read.
+ */
+static int block_read_direct(struct block_device *blk, void *buf,
+			     sector_t block, blkcnt_t num_blocks)
+{
+	sector_t last = block + num_blocks, discard_start, discard_end;
+	struct chunk *chunk;
+	int ret = 0;
+
+	dev_vdbg(blk->dev, "%s: %llu blocks at %llu\n", __func__,
+		 num_blocks, block);
+
+	block_discarded_chunks(blk, &discard_start, &discard_end);
+	discard_start = clamp(discard_start, block, last);
+	discard_end = clamp(discard_end, discard_start, last);
+
+	if (discard_start > block)
+		ret = blk_rw_sync(blk, false, buf, block, discard_start - block);
+	if (!ret && last > discard_end)
+		ret = blk_rw_sync(blk, false,
+				  buf + ((discard_end - block) << blk->blockbits),
+				  discard_end, last - discard_end);
+	if (ret)
+		return ret;
+
+	memset(buf + ((discard_start - block) << blk->blockbits), 0,
+	       (discard_end - discard_start) << blk->blockbits);
+
+	blk_stats_record_read(blk, num_blocks - (discard_end - discard_start));
+	blk_stats_record_direct_read(blk, num_blocks - (discard_end - discard_start));
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		sector_t start, end;
+
+		if (!chunk->dirty)
+			continue;
+
+		start = max_t(sector_t, block, chunk->block_start);
+		end = min_t(sector_t, block + num_blocks,
+			    chunk->block_start + blk->rdbufsize);
+		if (start >= end)
+			continue;
+
+		memcpy(buf + ((start - block) << blk->blockbits),
+		       chunk->data + ((start - chunk->block_start) << blk->blockbits),
+		       (end - start) << blk->blockbits);
+	}
+
+	return 0;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -239,6 +720,7 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	sector_t block = offset >> blk->blockbits;
 	size_t icount = count;
 	blkcnt_t blocks;
+	int ret;
 
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
@@ -257,6 +739,17 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 	blocks = count >> blk->blockbits;
 
+	if (block_can_read_direct(blk, buf, block, blocks)) {
+		ret = block_read_direct(blk, buf, block, blocks);
+		if (ret)
+			return ret;
+
+		buf += blocks << blk->blockbits;
+		count -= blocks << blk->blockbits;
+		block += blocks;
+		blocks = 0;
+	}
+
 	while (blocks) {
 		void *iobuf = block_get(blk, block);
 
@@ -424,10 +917,12 @@ static __maybe_unused int block_op_erase(struct cdev *cdev, loff_t count, loff_t
 
 	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
 		if (region_overlap_size(offset, count, chunk->block_start, blk->rdbufsize)) {
+			blk_wait(&chunk->req);
+			chunk->req.status = 0;
 			ret = chunk_flush(blk, chunk);
 			if (ret < 0)
 				return ret;
-			list_move(&chunk->list, &blk->idle_blocks);
+			chunk_release(blk, chunk);
 		}
 	}
 
@@ -462,23 +957,46 @@ int blockdevice_register(struct block_device *blk)
 	blk->cdev.ops = &block_ops;
 	blk->cdev.priv = blk;
 	blk->cdev.flags |= DEVFS_IS_BLOCK_DEV;
-	blk->rdbufsize = BUFSIZE >> blk->blockbits;
+	if (!blk->rdbufsize)
+		blk->rdbufsize = BUFSIZE >> blk->blockbits;
+	if (!blk->cache_chunks)
+		blk->cache_chunks = BLOCK_CACHE_CHUNKS;
 
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
 	blk->blkmask = blk->rdbufsize - 1;
+	blk->ra_chunks = 1;
 
-	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x\n",
-		blk->rdbufsize, blk->blockbits, blk->blkmask);
+	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x chunks: %u\n",
+		blk->rdbufsize, blk->blockbits, blk->blkmask, blk->cache_chunks);
 
 	if (!blk->rdbufsize) {
 		pr_warn("block size of %u not supported\n", BLOCKSIZE(blk));
 		return -ENOSYS;
 	}
 
-	for (i = 0; i < 8; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
+	if (!is_power_of_2(blk->rdbufsize)) {
+		pr_warn("cache chunk size of %d blocks not supported\n",
+			blk->rdbufsize);
+		return -EINVAL;
+	}
+
+	/*
+	 * All chunks share one buffer, so that adjacent chunks can be filled
+	 * with a single read when reading ahead.
+	 */
+	blk->cache_data = dma_alloc(blk->cache_chunks * (blk->rdbufsize << blk->blockbits));
+	if (!blk->cache_data)
+		return -ENOMEM;
+
+	blk->chunks = xzalloc(blk->cache_chunks * sizeof(*blk->chunks));
+	blk->chunk_hash_bits = fls(blk->cache_chunks);
+	blk->chunk_hash = xzalloc(sizeof(*blk->chunk_hash) << blk->chunk_hash_bits);
+
+	for (i = 0; i < blk->cache_chunks; i++) {
+		struct chunk *chunk = &blk->chunks[i];
+
+		chunk->data = blk->cache_data + i * (blk->rdbufsize << blk->blockbits);
 		chunk->num = i;
 		list_add_tail(&chunk->list, &blk->idle_blocks);
 	}
@@ -493,7 +1011,7 @@ int blockdevice_register(struct block_device *blk)
 
 	ret = devfs_create(&blk->cdev);
 	if (ret)
-		return ret;
+		goto err_free;
 
 	list_add_tail(&blk->list, &block_device_list);
 
@@ -503,23 +1021,31 @@ int blockdevice_register(struct block_device *blk)
 	(void)parse_partition_table(blk);
 
 	return 0;
+
+err_free:
+	INIT_LIST_HEAD(&blk->idle_blocks);
+	free(blk->chunk_hash);
+	blk->chunk_hash = NULL;
+	free(blk->chunks);
+	blk->chunks = NULL;
+	dma_free(blk->cache_data);
+	blk->cache_data = NULL;
+
+	return ret;
 }
 
 int blockdevice_unregister(struct block_device *blk)
 {
-	struct chunk *chunk, *tmp;
+	int i;
 
-	writebuffer_flush(blk);
+	for (i = 0; i < blk->cache_chunks; i++)
+		blk_wait(&blk->chunks[i].req);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	writebuffer_flush(blk);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	dma_free(blk->cache_data);
+	free(blk->chunks);
+	free(blk->chunk_hash);
 
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
@@ -20,6 +20,7 @@
 #include <linux/stat.h>
 #include <magicvar.h>
 #include <uncompress.h>
+#include <boottrace.h>
 #include <zero_page.h>
 #include <security/config.h>
 
@@ -243,6 +244,7 @@ static bool bootm_get_override(char **oldpath, const char *newpath)
 const struct resource *bootm_load_os(struct image_data *data,
 		ulong load_address, ulong end_address)
 {
+	u64 start;
 	int err;
 
 	if (data->os_res)
@@ -253,6 +255,8 @@ const struct resource *bootm_load_os(struct image_data *data,
 	if (end_address <= load_address)
 		return ERR_PTR(-EINVAL);
 
+	start = boottrace_start();
+
 	if (data->os_fit) {
 		err = bootm_load_fit_os(data, load_address);
 	} else if (image_is_uimage(data)) {
@@ -264,6 +268,8 @@ const struct resource *bootm_load_os(struct image_data *data,
 		err = -EINVAL;
 	}
 
+	boottrace_add(BOOTTRACE_BOOTM, start, "load os");
+
 	if (err)
 		return ERR_PTR(err);
 
@@ -295,6 +301,7 @@ bootm_load_initrd(struct image_data *data, ulong load_address, ulong end_address
 	struct resource *res = NULL;
 	const char *initrd, *initrd_part = NULL;
 	enum filetype type = filetype_unknown;
+	u64 start;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_BOOTM_INITRD))
@@ -320,6 +327,8 @@ bootm_load_initrd(struct image_data *data, ulong load_address, ulong end_address
 		}
 	}
 
+	start = boottrace_start();
+
 	if (type == filetype_uimage) {
 		res = bootm_load_uimage_initrd(data, load_address);
 		if (data->initrd_uimage->header.ih_type == IH_TYPE_MULTI)
@@ -334,6 +343,9 @@ bootm_load_initrd(struct image_data *data, ulong load_address, ulong end_address
 		type = filetype_fit;
 	}
 
+	if (res)
+		boottrace_add(BOOTTRACE_BOOTM, start, "load initrd");
+
 	if (IS_ERR_OR_NULL(res))
 		return res;
 
@@ -369,11 +381,14 @@ void *bootm_get_devicetree(struct image_data *data)
 	enum filetype type;
 	struct fdt_header *oftree;
 	bool from_fit = false;
+	u64 start;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_OFTREE))
 		return ERR_PTR(-ENOSYS);
 
+	start = boottrace_start();
+
 	from_fit = bootm_fit_has_fdt(data);
 	if (bootm_get_override(&data->oftree_file, bootm_overrides.oftree_file))
 		from_fit = false;
@@ -436,6 +451,9 @@ void *bootm_get_devicetree(struct image_data *data)
 	of_fix_tree(data->of_root_node);
 
 	oftree = of_flatten_dtb(data->of_root_node);
+
+	boottrace_add(BOOTTRACE_BOOTM, start, "devicetree");
+
 	if (!oftree)
 		return ERR_PTR(-EINVAL);
 
@@ -578,6 +596,7 @@ int bootm_boot(struct bootm_data *bootm_data)
 	struct image_handler *handler;
 	int ret;
 	const char *image_type_str;
+	u64 start;
 
 	if (!bootm_data->os_file) {
 		pr_err("no image given\n");
@@ -600,6 +619,8 @@ int bootm_boot(struct bootm_data *bootm_data)
 	data->os_entry = bootm_data->os_entry;
 	data->efi_boot = bootm_data->efi_boot;
 
+	start = boottrace_start();
+
 	ret = file_read_and_detect_boot_image_type(data->os_file, &data->os_header);
 	if (ret < 0)
 		goto err_out;
@@ -645,6 +666,8 @@ int bootm_boot(struct bootm_data *bootm_data)
 		break;
 	}
 
+	boottrace_add(BOOTTRACE_BOOTM, start, "open");
+
 	if (ret) {
 		pr_err("Loading %s image failed with: %pe\n", image_type_str, ERR_PTR(ret));
 		goto err_out;
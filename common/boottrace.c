@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * boottrace.c - record how long the steps of booting take
+ *
+ * Initcalls, driver probes, slow pollers, bthread switches, block I/O and
+ * bootm stages are recorded as spans into a fixed size buffer, which is
+ * dumped in the Chrome trace event format understood by Perfetto and
+ * chrome://tracing. Recording stops once the buffer is full, so the
+ * beginning of the boot is always kept.
+ */
+
+#define pr_fmt(fmt) "boottrace: " fmt
+
+#include <common.h>
+#include <boottrace.h>
+#include <globalvar.h>
+#include <init.h>
+#include <magicvar.h>
+#include <malloc.h>
+#include <of.h>
+#include <stdio.h>
+#include <linux/ioport.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+#define BOOTTRACE_NAME_LEN	48
+
+struct boottrace_event {
+	u64 start;
+	u64 duration;
+	enum boottrace_cat cat;
+	char name[BOOTTRACE_NAME_LEN];
+};
+
+static struct boottrace_event boottrace_events[CONFIG_BOOTTRACE_ENTRIES];
+static unsigned int boottrace_count;
+static unsigned int boottrace_dropped;
+
+static const char * const boottrace_cat_names[BOOTTRACE_NR_CATS] = {
+	[BOOTTRACE_INITCALL] = "initcall",
+	[BOOTTRACE_PROBE] = "probe",
+	[BOOTTRACE_POLLER] = "poller",
+	[BOOTTRACE_BTHREAD] = "bthread",
+	[BOOTTRACE_BLOCK] = "block",
+	[BOOTTRACE_BOOTM] = "bootm",
+};
+
+static struct boottrace_event *boottrace_next(enum boottrace_cat cat, u64 start)
+{
+	struct boottrace_event *ev;
+
+	if (boottrace_count == ARRAY_SIZE(boottrace_events)) {
+		boottrace_dropped++;
+		return NULL;
+	}
+
+	ev = &boottrace_events[boottrace_count++];
+	ev->start = start;
+	ev->duration = get_time_ns() - start;
+	ev->cat = cat;
+
+	return ev;
+}
+
+/**
+ * boottrace_add - record a span that started at @start and ends now
+ * @cat: category of the event, used as the trace's thread
+ * @start: start time as returned by boottrace_start()
+ * @name: name of the event, truncated to BOOTTRACE_NAME_LEN - 1 characters
+ */
+void boottrace_add(enum boottrace_cat cat, u64 start, const char *name)
+{
+	struct boottrace_event *ev = boottrace_next(cat, start);
+
+	if (ev)
+		strscpy(ev->name, name, sizeof(ev->name));
+}
+
+void boottrace_addf(enum boottrace_cat cat, u64 start, const char *fmt, ...)
+{
+	struct boottrace_event *ev = boottrace_next(cat, start);
+	va_list args;
+
+	if (!ev)
+		return;
+
+	va_start(args, fmt);
+	vsnprintf(ev->name, sizeof(ev->name), fmt, args);
+	va_end(args);
+}
+
+void boottrace_clear(void)
+{
+	boottrace_count = 0;
+	boottrace_dropped = 0;
+}
+
+static void boottrace_escape(char *dst, const char *src)
+{
+	for (; *src; src++) {
+		if (*src == '"' || *src == '\\')
+			*dst++ = '\\';
+		*dst++ = *src < 0x20 ? '?' : *src;
+	}
+
+	*dst = '\0';
+}
+
+static int boottrace_format_event(char *buf, size_t size,
+				  const struct boottrace_event *ev)
+{
+	char name[BOOTTRACE_NAME_LEN * 2];
+	u32 ts_ns, dur_ns;
+	u64 ts_us, dur_us;
+
+	boottrace_escape(name, ev->name);
+	ts_us = div_u64_rem(ev->start, 1000, &ts_ns);
+	dur_us = div_u64_rem(ev->duration, 1000, &dur_ns);
+
+	return snprintf(buf, size,
+			",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+			"\"tid\":%d,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+			name, boottrace_cat_names[ev->cat], ev->cat,
+			ts_us, ts_ns, dur_us, dur_ns);
+}
+
+static const char boottrace_trailer[] = "\n]}\n";
+
+/**
+ * boottrace_format - format the recorded events as Chrome trace JSON
+ * @buf: buffer to write to, may be NULL to query the needed size
+ * @size: size of @buf
+ *
+ * Events that don't fit into @buf are left out, the result is always a
+ * complete, NUL terminated JSON document.
+ *
+ * Return: length of the output without the terminating NUL, or -ENOSPC if
+ * @buf can't even take the empty document
+ */
+ssize_t boottrace_format(char *buf, size_t size)
+{
+	char line[256];
+	size_t len = 0;
+	unsigned int i;
+	int n;
+
+	n = snprintf(line, sizeof(line),
+		     "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%u},"
+		     "\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\","
+		     "\"pid\":1,\"args\":{\"name\":\"barebox\"}}",
+		     boottrace_dropped);
+	if (buf && n + sizeof(boottrace_trailer) > size)
+		return -ENOSPC;
+	if (buf)
+		memcpy(buf, line, n);
+	len += n;
+
+	for (i = 0; i < BOOTTRACE_NR_CATS + boottrace_count; i++) {
+		if (i < BOOTTRACE_NR_CATS)
+			n = snprintf(line, sizeof(line),
+				     ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				     "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				     i, boottrace_cat_names[i]);
+		else
+			n = boottrace_format_event(line, sizeof(line),
+					&boottrace_events[i - BOOTTRACE_NR_CATS]);
+
+		if (buf) {
+			if (len + n + sizeof(boottrace_trailer) > size)
+				break;
+			memcpy(buf + len, line, n);
+		}
+
+		len += n;
+	}
+
+	if (buf)
+		memcpy(buf + len, boottrace_trailer, sizeof(boottrace_trailer));
+
+	return len + sizeof(boottrace_trailer) - 1;
+}
+
+static int boottrace_kernel;
+static char *boottrace_kernel_buf;
+static size_t boottrace_kernel_size;
+
+/*
+ * Reserve a buffer for the trace in the kernel's device tree. It's filled
+ * here and once more right before barebox hands over control, to include
+ * the rest of the boot.
+ */
+static int boottrace_of_fixup(struct device_node *root, void *unused)
+{
+	struct resource res = {};
+	struct device_node *node;
+	size_t size;
+	char *name;
+	int ret;
+
+	if (!boottrace_kernel)
+		return 0;
+
+	size = PAGE_ALIGN(boottrace_format(NULL, 0) + SZ_16K);
+	if (size > boottrace_kernel_size) {
+		free(boottrace_kernel_buf);
+		boottrace_kernel_size = 0;
+		boottrace_kernel_buf = memalign(PAGE_SIZE, size);
+		if (!boottrace_kernel_buf)
+			return -ENOMEM;
+		boottrace_kernel_size = size;
+	}
+
+	boottrace_format(boottrace_kernel_buf, boottrace_kernel_size);
+
+	name = xasprintf("boottrace@%lx", (unsigned long)boottrace_kernel_buf);
+	res.name = name;
+	res.start = (unsigned long)boottrace_kernel_buf;
+	res.end = res.start + boottrace_kernel_size - 1;
+
+	ret = of_fixup_reserved_memory(root, &res);
+	if (!ret) {
+		node = of_get_child_by_name(root, "reserved-memory");
+		node = of_get_child_by_name(node, name);
+		ret = of_property_write_string(node, "compatible",
+					       "barebox,boottrace");
+	}
+
+	free(name);
+
+	return ret;
+}
+
+static void boottrace_shutdown(void)
+{
+	if (boottrace_kernel_buf)
+		boottrace_format(boottrace_kernel_buf, boottrace_kernel_size);
+}
+predevshutdown_exitcall(boottrace_shutdown);
+
+static int boottrace_init(void)
+{
+	globalvar_add_simple_bool("boottrace.kernel", &boottrace_kernel);
+
+	return of_register_fixup(boottrace_of_fixup, NULL);
+}
+late_initcall(boottrace_init);
+
+BAREBOX_MAGICVAR(global.boottrace.kernel,
+		 "Pass the boot trace to the kernel in a /reserved-memory node");
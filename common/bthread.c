@@ -12,6 +12,7 @@
 
 #include <common.h>
 #include <bthread.h>
+#include <boottrace.h>
 #include <asm/setjmp.h>
 #include <linux/overflow.h>
 
@@ -35,6 +36,13 @@ static struct bthread {
 
 struct bthread *current = &main_thread;
 
+/*
+ * Time the current thread was switched to. Only slices of other threads
+ * than main doing some work are traced, everything else is main anyway.
+ */
+static u64 __maybe_unused bthread_slice_start;
+#define BTHREAD_TRACE_MIN_NS	(10 * USECOND)
+
 /*
  * When using ASAN, it needs to be told when we switch stacks.
  */
@@ -202,6 +210,16 @@ void bthread_schedule(struct bthread *to)
 	void *stack_save = NULL;
 	int ret;
 
+	if (IS_ENABLED(CONFIG_BOOTTRACE)) {
+		u64 now = boottrace_start();
+
+		if (from != &main_thread &&
+		    now - bthread_slice_start >= BTHREAD_TRACE_MIN_NS)
+			boottrace_add(BOOTTRACE_BTHREAD, bthread_slice_start,
+				      from->name);
+		bthread_slice_start = now;
+	}
+
 	ret = setjmp(from->jmp_buf);
 	if (ret == 0) {
 		current = to;
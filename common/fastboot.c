@@ -51,6 +51,7 @@
 static unsigned int fastboot_max_download_size;
 static int fastboot_bbu;
 static char *fastboot_partitions;
+static char *fastboot_stream_partition;
 
 struct fb_variable {
 	char *name;
@@ -187,6 +188,9 @@ static int fastboot_add_partition_variables(struct fastboot *fb, struct list_hea
 	return ret;
 }
 
+static void fastboot_stream_do_work(struct work_struct *w);
+static void fastboot_stream_cancel_work(struct work_struct *w);
+
 int fastboot_generic_init(struct fastboot *fb, bool export_bbu)
 {
 	struct fb_variable *var;
@@ -211,6 +215,10 @@ int fastboot_generic_init(struct fastboot *fb, bool export_bbu)
 	if (export_bbu)
 		bbu_append_handlers_to_file_list(fb->files);
 
+	fb->stream_wq.fn = fastboot_stream_do_work;
+	fb->stream_wq.cancel = fastboot_stream_cancel_work;
+	wq_register(&fb->stream_wq);
+
 	return 0;
 }
 
@@ -226,9 +234,79 @@ static void fastboot_free_variables(struct list_head *list)
 	}
 }
 
+/*
+ * Sparse images for the partition in global.fastboot.stream_partition are
+ * written to it while they are downloaded instead of being stored in the
+ * temporary file first. The download data arrives in poller context, where
+ * the target must not be accessed, so it is queued to fb->stream_wq and
+ * written from there. The queue holds what the target has not taken yet,
+ * at most the download size like the temporary file. Errors are collected
+ * and reported by the following flash command.
+ */
+struct fastboot_stream {
+	struct file_list_entry *fentry;
+	struct sparse_stream_ctx *sparse;
+	struct fastboot_stream_work *fill;	/* queued, may be appended to */
+	int fd;
+	bool is_reg;
+	int err;
+};
+
+/* a piece of the download to be written, or the end of the stream */
+struct fastboot_stream_work {
+	struct work_struct work;
+	struct fastboot_stream *st;
+	bool release;
+	size_t len;
+	size_t size;
+	u8 data[];
+};
+
+/* download data is queued in pieces of at least this size */
+#define FASTBOOT_STREAM_WORK_SIZE	SZ_64K
+
+static void fastboot_stream_release(struct fastboot_stream *st)
+{
+	if (st->fd >= 0)
+		close(st->fd);
+	sparse_stream_free(st->sparse);
+	free(st);
+}
+
+/*
+ * Detach the stream from the download and queue its release, which closes
+ * the target. Data still queued is dropped. Safe to call from pollers.
+ */
+static void fastboot_stream_detach(struct fastboot *fb)
+{
+	struct fastboot_stream *st = fb->stream;
+	struct fastboot_stream_work *sw;
+
+	if (!st)
+		return;
+
+	fb->stream = NULL;
+	st->fill = NULL;
+	if (!st->err)
+		st->err = -ECANCELED;
+
+	sw = xzalloc(sizeof(*sw));
+	sw->st = st;
+	sw->release = true;
+	wq_queue_work(&fb->stream_wq, &sw->work);
+}
+
+static void fastboot_stream_free(struct fastboot *fb)
+{
+	fastboot_stream_detach(fb);
+	wq_flush(&fb->stream_wq);
+}
+
 void fastboot_generic_free(struct fastboot *fb)
 {
 	fastboot_free_variables(&fb->variables);
+	fastboot_stream_free(fb);
+	wq_unregister(&fb->stream_wq);
 
 	free(fb->tempname);
 
@@ -389,15 +467,203 @@ static void cb_getvar(struct fastboot *fb, const char *cmd)
 	fastboot_free_variables(&partition_list);
 }
 
-int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
-				  unsigned int len)
+static int fastboot_stream_write(void *priv, const void *buf, size_t len,
+				 loff_t pos)
+{
+	struct fastboot_stream *st = priv;
+	int ret;
+
+	/* The range is overwritten completely, no need to read it first */
+	discard_range(st->fd, len, pos);
+
+	ret = pwrite_full(st->fd, buf, len, pos);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int fastboot_stream_dont_care(void *priv, loff_t len, loff_t pos)
+{
+	struct fastboot_stream *st = priv;
+
+	/* Best effort, not every device can erase arbitrary ranges */
+	if (!st->is_reg)
+		erase(st->fd, len, pos, ERASE_TO_WRITE);
+
+	return 0;
+}
+
+static const struct sparse_stream_ops fastboot_stream_ops = {
+	.write = fastboot_stream_write,
+	.dont_care = fastboot_stream_dont_care,
+};
+
+/* called from poller context, so only decides, the target is opened later */
+static struct fastboot_stream *fastboot_stream_start(struct fastboot *fb)
 {
+	struct fastboot_stream *st;
+	struct file_list_entry *fentry;
+
+	/* Board specific flash handlers and ubiformat need the whole image */
+	if (fb->cmd_flash)
+		return NULL;
+
+	fentry = file_list_entry_by_name(fb->files, fastboot_stream_partition);
+	if (!fentry || fentry->flags & FILE_LIST_FLAG_UBI) {
+		pr_warn("Cannot stream to partition %s, downloading to RAM\n",
+			fastboot_stream_partition);
+		return NULL;
+	}
+
+	st = xzalloc(sizeof(*st));
+	st->fentry = fentry;
+	st->fd = -1;
+
+	return st;
+}
+
+static int fastboot_stream_open(struct fastboot_stream *st)
+{
+	struct file_list_entry *fentry = st->fentry;
+	unsigned int flags = O_RDWR;
+	struct stat s;
 	int ret;
 
-	ret = write(fb->download_fd, buffer, len);
+	ret = fb_file_available(fentry);
 	if (ret < 0)
 		return ret;
 
+	if (stat(fentry->filename, &s) && fentry->flags & FILE_LIST_FLAG_CREATE)
+		flags |= O_CREAT;
+
+	st->fd = open(fentry->filename, flags, 0666);
+	if (st->fd < 0)
+		return -errno;
+
+	if (!fstat(st->fd, &s))
+		st->is_reg = S_ISREG(s.st_mode);
+
+	st->sparse = sparse_stream_new(&fastboot_stream_ops, st);
+
+	pr_info("Streaming sparse image to %s\n", fentry->filename);
+
+	return 0;
+}
+
+static void fastboot_stream_do_work(struct work_struct *w)
+{
+	struct fastboot_stream_work *sw = container_of(w,
+			struct fastboot_stream_work, work);
+	struct fastboot_stream *st = sw->st;
+
+	if (sw->release) {
+		fastboot_stream_release(st);
+		goto out;
+	}
+
+	/* pollers running while we write must not append to it anymore */
+	if (st->fill == sw)
+		st->fill = NULL;
+
+	if (!st->err && st->fd < 0)
+		st->err = fastboot_stream_open(st);
+	if (!st->err)
+		st->err = sparse_stream_feed(st->sparse, sw->data, sw->len);
+out:
+	free(sw);
+}
+
+static void fastboot_stream_cancel_work(struct work_struct *w)
+{
+	struct fastboot_stream_work *sw = container_of(w,
+			struct fastboot_stream_work, work);
+
+	if (sw->release)
+		fastboot_stream_release(sw->st);
+	else if (sw->st->fill == sw)
+		sw->st->fill = NULL;
+
+	free(sw);
+}
+
+static int fastboot_stream_queue(struct fastboot *fb, const void *buf,
+				 size_t len)
+{
+	struct fastboot_stream *st = fb->stream;
+	struct fastboot_stream_work *sw = st->fill;
+	size_t size;
+
+	if (sw && sw->size - sw->len >= len) {
+		memcpy(sw->data + sw->len, buf, len);
+		sw->len += len;
+		return 0;
+	}
+
+	size = max_t(size_t, len, FASTBOOT_STREAM_WORK_SIZE);
+	sw = malloc(struct_size(sw, data, size));
+	if (!sw)
+		return -ENOMEM;
+
+	sw->st = st;
+	sw->release = false;
+	sw->size = size;
+	sw->len = len;
+	memcpy(sw->data, buf, len);
+
+	st->fill = sw;
+	wq_queue_work(&fb->stream_wq, &sw->work);
+
+	return 0;
+}
+
+static int fastboot_stream_finish(struct fastboot *fb, const char *partition)
+{
+	struct fastboot_stream *st = fb->stream;
+	int ret;
+
+	if (strcmp(partition, st->fentry->name)) {
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+				  "image was streamed to %s", st->fentry->name);
+		return -EINVAL;
+	}
+
+	ret = st->err;
+	if (!ret)
+		ret = sparse_stream_finish(st->sparse);
+	if (!ret && st->is_reg)
+		ret = ftruncate(st->fd, sparse_stream_size(st->sparse));
+
+	if (!ret) {
+		ret = close(st->fd);
+		st->fd = -1;
+	}
+
+	if (ret)
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+				  "writing sparse image: %pe", ERR_PTR(ret));
+
+	return ret;
+}
+
+int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
+				  unsigned int len)
+{
+	int ret;
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_SPARSE) && !fb->download_bytes &&
+	    fastboot_stream_partition && *fastboot_stream_partition &&
+	    len >= sizeof(struct sparse_header) && is_sparse_image(buffer))
+		fb->stream = fastboot_stream_start(fb);
+
+	if (fb->stream) {
+		ret = fastboot_stream_queue(fb, buffer, len);
+		if (ret < 0)
+			return ret;
+	} else {
+		ret = write(fb->download_fd, buffer, len);
+		if (ret < 0)
+			return ret;
+	}
+
 	fb->download_bytes += len;
 	show_progress(fb->download_bytes);
 	return 0;
@@ -425,6 +691,7 @@ void fastboot_abort(struct fastboot *fb)
 
 	fb->active = false;
 
+	fastboot_stream_detach(fb);
 	unlink(fb->tempname);
 }
 
@@ -433,6 +700,9 @@ static void cb_download(struct fastboot *fb, const char *cmd)
 	fb->download_size = simple_strtoul(cmd, NULL, 16);
 	fb->download_bytes = 0;
 
+	/* A streamed image not followed by a flash command */
+	fastboot_stream_free(fb);
+
 	fastboot_tx_print(fb, FASTBOOT_MSG_INFO, "Downloading %zu bytes...",
 			  fb->download_size);
 
@@ -690,6 +960,14 @@ static void cb_flash(struct fastboot *fb, const char *cmd)
 	const char *filename = NULL;
 	enum filetype filetype;
 
+	if (fb->stream) {
+		/* write what is still queued of the download */
+		wq_flush(&fb->stream_wq);
+		ret = fastboot_stream_finish(fb, cmd);
+		fastboot_stream_free(fb);
+		goto out;
+	}
+
 	ret = file_name_detect_type(fb->tempname, &filetype);
 	if (ret) {
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL, "internal error");
@@ -1051,6 +1329,8 @@ static int fastboot_globalvars_init(void)
 						     SZ_8M, SZ_128M));
 		globalvar_add_simple_int("fastboot.max_download_size",
 				 &fastboot_max_download_size, "%u");
+		globalvar_add_simple_string("fastboot.stream_partition",
+					    &fastboot_stream_partition);
 	}
 
 	globalvar_add_simple_bool("fastboot.bbu", &fastboot_bbu);
@@ -1071,6 +1351,8 @@ device_initcall(fastboot_globalvars_init);
 
 BAREBOX_MAGICVAR(global.fastboot.max_download_size,
 		 "Fastboot maximum download size");
+BAREBOX_MAGICVAR(global.fastboot.stream_partition,
+		 "Partition sparse images are written to while downloading");
 BAREBOX_MAGICVAR(global.fastboot.partitions,
 		       "Partitions exported for update via fastboot");
 BAREBOX_MAGICVAR(global.fastboot.bbu,
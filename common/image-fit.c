@@ -469,8 +469,14 @@ static int fit_verify_signature(struct fit_handle *handle,
 	return ret;
 }
 
-static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
-			   const void *data, int data_len)
+/*
+ * Allocate the digest to check the hash of @image with. Returns NULL if
+ * there is nothing to check according to the verification mode.
+ */
+static struct digest *fit_image_hash_alloc(struct fit_handle *handle,
+					   struct device_node *image,
+					   struct device_node **hash_node,
+					   const void **value)
 {
 	struct digest *d;
 	const char *algo;
@@ -480,7 +486,7 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 
 	switch (handle->verify) {
 	case BOOTM_VERIFY_NONE:
-		return 0;
+		return NULL;
 	case BOOTM_VERIFY_AVAILABLE:
 		ret = 0;
 		break;
@@ -494,36 +500,49 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 	if (!hash) {
 		if (ret)
 			pr_err("image %pOF does not have hashes\n", image);
-		return ret;
+		return ret ? ERR_PTR(ret) : NULL;
 	}
 
 	value_read = of_get_property(hash, "value", &hash_len);
 	if (!value_read) {
 		pr_err("%pOF: \"value\" property not found\n", hash);
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
 
 	if (of_property_read_string(hash, "algo", &algo)) {
 		pr_err("%pOF: \"algo\" property not found\n", hash);
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
 
 	d = digest_alloc(algo);
 	if (!d) {
 		pr_err("%pOF: unsupported algo %s\n", hash, algo);
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
 
 	if (hash_len != digest_length(d)) {
 		pr_err("%pOF: invalid hash length %d\n", hash, hash_len);
-		ret = -EINVAL;
-		goto err_digest_free;
+		digest_free(d);
+		return ERR_PTR(-EINVAL);
 	}
 
-	digest_init(d);
-	digest_update(d, data, data_len);
+	*hash_node = hash;
+	*value = value_read;
 
-	if (digest_verify(d, value_read)) {
+	return d;
+}
+
+/*
+ * Compare the digest over the image data with the expected value and free
+ * the digest.
+ */
+static int fit_image_hash_check(struct fit_handle *handle,
+				struct device_node *hash,
+				struct digest *d, const void *value)
+{
+	int ret;
+
+	if (digest_verify(d, value)) {
 		pr_err("%pOF: hash BAD\n", hash);
 		ret =  -EBADMSG;
 	} else {
@@ -532,12 +551,28 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 		ret = 0;
 	}
 
-err_digest_free:
 	digest_free(d);
 
 	return ret;
 }
 
+static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
+			   const void *data, int data_len)
+{
+	struct device_node *hash;
+	const void *value;
+	struct digest *d;
+
+	d = fit_image_hash_alloc(handle, image, &hash, &value);
+	if (IS_ERR_OR_NULL(d))
+		return PTR_ERR_OR_ZERO(d);
+
+	digest_init(d);
+	digest_update(d, data, data_len);
+
+	return fit_image_hash_check(handle, hash, d, value);
+}
+
 static int fit_image_verify_signature(struct fit_handle *handle,
 				      struct device_node *image,
 				      const void *data, int data_len)
@@ -731,6 +766,66 @@ static int fit_handle_decompression(struct device_node *image,
 	return 0;
 }
 
+/*
+ * Whether hashing and decompression of @image can be done in a single
+ * pass. This means that the decompressor sees the data before its hash
+ * has been verified, so it is only done when enabled in the config.
+ */
+static bool fit_image_stream(struct device_node *image, const char *type)
+{
+	return IS_ENABLED(CONFIG_FITIMAGE_STREAM_DECOMPRESS) &&
+		get_compression_type(image) && strcmp(type, "ramdisk");
+}
+
+static int fit_verify_hash_decompress(struct fit_handle *handle,
+				      struct device_node *image,
+				      const void **data, int *data_len)
+{
+	struct device_node *hash = NULL;
+	const void *value = NULL;
+	struct property *pp;
+	struct digest *d;
+	void *uc_data;
+	ssize_t len;
+	int ret;
+
+	/* only there if the hash has been verified before */
+	pp = of_find_property(image, "$uncompressed-data", NULL);
+	if (pp)
+		goto out;
+
+	d = fit_image_hash_alloc(handle, image, &hash, &value);
+	if (IS_ERR(d))
+		return PTR_ERR(d);
+
+	if (d)
+		digest_init(d);
+
+	len = uncompress_buf_to_buf_digest(*data, *data_len, &uc_data, d,
+					    fit_uncompress_error_fn);
+	if (len < 0) {
+		pr_err("%pOF: data couldn't be decompressed\n", image);
+		digest_free(d);
+		return len;
+	}
+
+	if (d) {
+		ret = fit_image_hash_check(handle, hash, d, value);
+		if (ret) {
+			free(uc_data);
+			return ret;
+		}
+	}
+
+	/* associate buffer with FIT, so it's not leaked */
+	pp = __of_new_property(image, "$uncompressed-data", uc_data, len);
+out:
+	*data = of_property_get_value(pp);
+	*data_len = pp->length;
+
+	return 0;
+}
+
 /**
  * fit_open_image - Open an image in a FIT image
  * @handle: The FIT image handle
@@ -778,6 +873,13 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 		return -EINVAL;
 	}
 
+	if (configuration && fit_image_stream(image, type)) {
+		ret = fit_verify_hash_decompress(handle, image, &data, &data_len);
+		if (ret)
+			return ret;
+		goto out;
+	}
+
 	if (configuration)
 		ret = fit_verify_hash(handle, image, data, data_len);
 	else
@@ -790,6 +892,7 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 	if (ret)
 		return ret;
 
+out:
 	*outdata = data;
 	*outsize = data_len;
 
@@ -1063,6 +1166,7 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	handle = xzalloc(sizeof(struct fit_handle));
 
 	handle->verbose = verbose;
+	handle->fit_fd = -1;
 	handle->fit = buf;
 	handle->size = size;
 	handle->verify = verify;
@@ -1114,6 +1218,7 @@ struct fit_handle *fit_open(const char *_filename, bool verbose,
 
 	handle->verbose = verbose;
 	handle->verify = verify;
+	handle->fit_fd = -1;
 
 	fd = open_fdt(filename, &handle->size);
 	if (fd < 0) {
@@ -1121,6 +1226,17 @@ struct fit_handle *fit_open(const char *_filename, bool verbose,
 		goto free_handle;
 	}
 
+	/*
+	 * Use the image in place when the file is in memory already, e.g. in
+	 * ramfs or a memory mapped squashfs. This saves copying the whole
+	 * FIT before its images are copied to their load addresses.
+	 */
+	handle->fit = memmap(fd, PROT_READ);
+	if (handle->fit != MAP_FAILED && IS_ALIGNED((ulong)handle->fit, 8)) {
+		handle->fit_fd = fd;
+		goto opened;
+	}
+
 	handle->fit_alloc = malloc(handle->size);
 	if (!handle->fit_alloc) {
 		ret = -ENOMEM;
@@ -1140,6 +1256,7 @@ struct fit_handle *fit_open(const char *_filename, bool verbose,
 	close(fd);
 
 	handle->fit = handle->fit_alloc;
+opened:
 	handle->filename = filename;
 
 	refcount_set(&handle->users, 1);
@@ -1178,6 +1295,8 @@ static bool __fit_close(struct fit_handle *handle)
 
 	free(handle->filename);
 	free(handle->fit_alloc);
+	if (handle->fit_fd >= 0)
+		close(handle->fit_fd);
 	return true;
 }
 
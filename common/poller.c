@@ -13,6 +13,8 @@
 #include <linux/ktime.h>
 #include <poller.h>
 #include <clock.h>
+#include <boottrace.h>
+#include <linux/math64.h>
 #include <linux/ktime.h>
 
 /*
@@ -21,21 +23,47 @@
  */
 #define POLLER_MAX_RUNTIME_MS	20
 
+/* Only pollers that actually did some work end up in the boot trace */
+#define POLLER_TRACE_MIN_NS	(10 * USECOND)
+
+/*
+ * Registered pollers, sorted by deadline. poller_call() only needs to look
+ * at the head of the list to find out whether anything is due at all, so
+ * pollers that wait for a timeout or for being woken up don't slow down
+ * tight loops calling resched().
+ */
 static LIST_HEAD(poller_list);
 static int __poller_active;
+/* the poller currently being called, cleared when it unregisters itself */
+static struct poller_struct *poller_current;
 
 bool poller_active(void)
 {
 	return __poller_active;
 }
 
+static void poller_enqueue(struct poller_struct *poller)
+{
+	struct poller_struct *pos;
+
+	/* insert behind pollers with the same deadline to keep them fair */
+	list_for_each_entry(pos, &poller_list, list) {
+		if (pos->deadline > poller->deadline) {
+			list_add_tail(&poller->list, &pos->list);
+			return;
+		}
+	}
+
+	list_add_tail(&poller->list, &poller_list);
+}
+
 int poller_register(struct poller_struct *poller, const char *name)
 {
 	if (poller->registered)
 		return -EBUSY;
 
 	poller->name = xstrdup_const(name);
-	list_add_tail(&poller->list, &poller_list);
+	poller_enqueue(poller);
 	poller->registered = 1;
 
 	return 0;
@@ -46,6 +74,8 @@ int poller_unregister(struct poller_struct *poller)
 	if (!poller->registered)
 		return -ENODEV;
 
+	if (poller == poller_current)
+		poller_current = NULL;
 
 	list_del(&poller->list);
 	poller->registered = 0;
@@ -54,14 +84,35 @@ int poller_unregister(struct poller_struct *poller)
 	return 0;
 }
 
+/**
+ * poller_set_deadline - set the time at which a poller is due next
+ * @poller: the poller
+ * @deadline: absolute time in ns, 0 to call the poller on every scheduler
+ *            invocation, or POLLER_DEADLINE_NONE to not call it at all
+ *
+ * This may be called from the poller itself to declare when it wants to
+ * run again. Pollers with a period have their deadline advanced after
+ * each call, overriding what they set from within the poll function.
+ */
+void poller_set_deadline(struct poller_struct *poller, uint64_t deadline)
+{
+	poller->deadline = deadline;
+
+	/* the running poller is requeued by poller_call() */
+	if (!poller->registered || poller == poller_current)
+		return;
+
+	list_del(&poller->list);
+	poller_enqueue(poller);
+}
+
 static void poller_async_callback(struct poller_struct *poller)
 {
 	struct poller_async *pa = container_of(poller, struct poller_async, poller);
 
-	if (!pa->active)
-		return;
+	poller->deadline = POLLER_DEADLINE_NONE;
 
-	if (get_time_ns() < pa->end)
+	if (!pa->active)
 		return;
 
 	pa->active = 0;
@@ -81,6 +132,7 @@ static void poller_async_callback(struct poller_struct *poller)
 int poller_async_cancel(struct poller_async *pa)
 {
 	pa->active = 0;
+	poller_set_deadline(&pa->poller, POLLER_DEADLINE_NONE);
 
 	return 0;
 }
@@ -103,6 +155,7 @@ int poller_call_async(struct poller_async *pa, uint64_t delay_ns,
 	pa->end = get_time_ns() + delay_ns;
 	pa->fn = fn;
 	pa->active = 1;
+	poller_set_deadline(&pa->poller, pa->end);
 
 	return 0;
 }
@@ -110,6 +163,7 @@ int poller_call_async(struct poller_async *pa, uint64_t delay_ns,
 int poller_async_register(struct poller_async *pa, const char *name)
 {
 	pa->poller.func = poller_async_callback;
+	pa->poller.deadline = POLLER_DEADLINE_NONE;
 	pa->active = 0;
 
 	return poller_register(&pa->poller, name);
@@ -120,28 +174,86 @@ int poller_async_unregister(struct poller_async *pa)
 	return poller_unregister(&pa->poller);
 }
 
+static void poller_account(struct poller_struct *poller, ktime_t start,
+			   ktime_t end)
+{
+	s64 duration_ns = ktime_to_ns(ktime_sub(end, start));
+	s64 duration_ms;
+
+	poller->calls++;
+	poller->runtime += duration_ns;
+	if (duration_ns > poller->max_runtime)
+		poller->max_runtime = duration_ns;
+
+	if (duration_ns >= POLLER_TRACE_MIN_NS)
+		boottrace_add(BOOTTRACE_POLLER, ktime_to_ns(start), poller->name);
+
+	duration_ms = ktime_ms_delta(end, start);
+	if (duration_ms > POLLER_MAX_RUNTIME_MS) {
+		if (IS_ENABLED(CONFIG_POLLER_WARN_OVERTIME) &&
+		    poller->overtime == 2)
+			pr_warn("'%s' takes unexpectedly long: %llums\n",
+				poller->name, duration_ms);
+
+		if (poller->overtime < U16_MAX)
+			poller->overtime++;
+	}
+}
+
 void poller_call(void)
 {
-	struct poller_struct *poller, *tmp;
+	struct poller_struct *poller;
+	LIST_HEAD(due);
+	ktime_t now;
+
+	if (list_empty(&poller_list))
+		return;
+
+	poller = list_first_entry(&poller_list, struct poller_struct, list);
+	if (poller->deadline == POLLER_DEADLINE_NONE)
+		return;
+
+	now = ktime_get();
+	if (poller->deadline > now)
+		return;
 
 	__poller_active = 1;
 
-	list_for_each_entry_safe(poller, tmp, &poller_list, list) {
-		ktime_t start = ktime_get();
-		s64 duration_ms;
+	/*
+	 * Move all due pollers off the list first, so that the ones requeued
+	 * below with a deadline that has already passed again are not called
+	 * a second time in this round.
+	 */
+	while (!list_empty(&poller_list)) {
+		poller = list_first_entry(&poller_list, struct poller_struct, list);
+		if (poller->deadline > now)
+			break;
+		list_move_tail(&poller->list, &due);
+	}
 
+	while (!list_empty(&due)) {
+		ktime_t start, end;
+
+		poller = list_first_entry(&due, struct poller_struct, list);
+		list_del_init(&poller->list);
+		poller_current = poller;
+
+		start = ktime_get();
 		poller->func(poller);
+		end = ktime_get();
 
-		duration_ms = ktime_ms_delta(ktime_get(), start);
-		if (duration_ms > POLLER_MAX_RUNTIME_MS) {
-			if (IS_ENABLED(CONFIG_POLLER_WARN_OVERTIME) &&
-			    poller->overtime == 2)
-				pr_warn("'%s' takes unexpectedly long: %llums\n",
-					poller->name, duration_ms);
+		/* unregistered from within its own poll function */
+		if (!poller_current)
+			continue;
 
-			if (poller->overtime < U16_MAX)
-				poller->overtime++;
-		}
+		poller_current = NULL;
+
+		poller_account(poller, start, end);
+
+		if (poller->period)
+			poller->deadline = end + poller->period;
+
+		poller_enqueue(poller);
 	}
 
 	__poller_active = 0;
@@ -180,10 +292,28 @@ static void poller_info(void)
 		return;
 	}
 
+	printf("%-20s %10s %12s %10s %10s %s\n", "Name", "Calls",
+	       "Runtime/us", "Avg/us", "Max/us", "Due in/ms");
+
 	list_for_each_entry(poller, &poller_list, list) {
-		printf("%s", poller->name);
+		u64 avg = poller->calls ?
+			div64_u64(poller->runtime, poller->calls) : 0;
+
+		printf("%-20s %10llu %12llu %10llu %10llu ", poller->name,
+		       poller->calls, div_u64(poller->runtime, USECOND),
+		       div_u64(avg, USECOND),
+		       div_u64(poller->max_runtime, USECOND));
+
+		if (poller->deadline == POLLER_DEADLINE_NONE)
+			printf("%9s", "idle");
+		else if (poller->deadline <= get_time_ns())
+			printf("%9s", "now");
+		else
+			printf("%9llu", div_u64(poller->deadline - get_time_ns(),
+						MSECOND));
+
 		if (poller->overtime)
-			printf(": overtime %s%u",
+			printf(" overtime %s%u",
 			       poller->overtime == U16_MAX ? ">= " : "",
 			       poller->overtime);
 		printf("\n");
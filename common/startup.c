@@ -28,6 +28,7 @@
 #include <slice.h>
 #include <linux/stat.h>
 #include <envfs.h>
+#include <boottrace.h>
 #include <magicvar.h>
 #include <readkey.h>
 #include <linux/reboot-mode.h>
@@ -405,8 +406,11 @@ void __noreturn start_barebox(void)
 
 	for (initcall = __barebox_initcalls_start;
 			initcall < __barebox_initcalls_end; initcall++) {
+		u64 start = boottrace_start();
+
 		pr_debug("initcall-> %pS\n", *initcall);
 		result = (*initcall)();
+		boottrace_addf(BOOTTRACE_INITCALL, start, "%pS", *initcall);
 		if (result)
 			pr_err("initcall %pS failed: %pe\n", *initcall,
 					ERR_PTR(result));
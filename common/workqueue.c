@@ -2,13 +2,21 @@
 #include <common.h>
 #include <work.h>
 
-static void wq_do_pending_work(struct work_queue *wq)
+static void wq_do_pending_work(struct work_queue *wq, uint64_t now)
 {
 	struct work_struct *work, *tmp;
 
+	if (now < wq->next_timeout)
+		return;
+
+	/* lowered again by skipped work and by work queued from wq->fn */
+	wq->next_timeout = U64_MAX;
+
 	list_for_each_entry_safe(work, tmp, &wq->work, list) {
-		if (work->delayed && get_time_ns() < work->timeout)
+		if (work->delayed && now < work->timeout) {
+			wq->next_timeout = min(wq->next_timeout, work->timeout);
 			continue;
+		}
 
 		list_del(&work->list);
 		wq->fn(work);
@@ -23,6 +31,19 @@ void wq_cancel_work(struct work_queue *wq)
 		list_del(&work->list);
 		wq->cancel(work);
 	}
+
+	wq->next_timeout = U64_MAX;
+}
+
+/**
+ * wq_flush - do all work queued on a work queue
+ * @wq:    The work queue
+ *
+ * Delayed work is done right away as well.
+ */
+void wq_flush(struct work_queue *wq)
+{
+	wq_do_pending_work(wq, U64_MAX);
 }
 
 static LIST_HEAD(work_queues);
@@ -35,9 +56,15 @@ static LIST_HEAD(work_queues);
 void wq_do_all_works(void)
 {
 	struct work_queue *wq;
+	uint64_t now;
+
+	if (list_empty(&work_queues))
+		return;
+
+	now = get_time_ns();
 
 	list_for_each_entry(wq, &work_queues, list)
-		wq_do_pending_work(wq);
+		wq_do_pending_work(wq, now);
 }
 
 /**
@@ -47,6 +74,7 @@ void wq_do_all_works(void)
 void wq_register(struct work_queue *wq)
 {
 	INIT_LIST_HEAD(&wq->work);
+	wq->next_timeout = U64_MAX;
 	list_add_tail(&wq->list, &work_queues);
 }
 
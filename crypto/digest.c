@@ -23,6 +23,10 @@
 #include <module.h>
 #include <linux/err.h>
 #include <crypto.h>
+#include <smp.h>
+#include <clock.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
 #include <crypto/internal.h>
 
 static LIST_HEAD(digests);
@@ -102,11 +106,39 @@ void digest_algo_unregister(struct digest_algo *d)
 }
 EXPORT_SYMBOL(digest_algo_unregister);
 
-static struct digest_algo *digest_algo_get_by_name(const char *name)
+static enum digest_size_class digest_size_class(size_t size)
 {
+	if (!size)
+		return DIGEST_SIZE_LARGE;
+	if (size < SZ_4K)
+		return DIGEST_SIZE_SMALL;
+	if (size < SZ_256K)
+		return DIGEST_SIZE_MEDIUM;
+	return DIGEST_SIZE_LARGE;
+}
+
+/*
+ * Once both drivers have been benchmarked for the size class, the faster
+ * one wins. Until then the static priority decides.
+ */
+static bool digest_algo_better(struct digest_algo *a, struct digest_algo *b,
+			       enum digest_size_class class)
+{
+	if (!b)
+		return true;
+
+	if (a->bench_kbps[class] && b->bench_kbps[class])
+		return a->bench_kbps[class] > b->bench_kbps[class];
+
+	return a->base.priority > b->base.priority;
+}
+
+static struct digest_algo *digest_algo_get_by_name(const char *name,
+						   size_t size)
+{
+	enum digest_size_class class = digest_size_class(size);
 	struct digest_algo *d_by_name = NULL, *d_by_driver = NULL;
 	struct digest_algo *tmp;
-	int priority = -1;
 
 	if (!name)
 		return NULL;
@@ -118,11 +150,10 @@ static struct digest_algo *digest_algo_get_by_name(const char *name)
 		if (strcmp(tmp->base.name, name) != 0)
 			continue;
 
-		if (tmp->base.priority <= priority)
+		if (!digest_algo_better(tmp, d_by_name, class))
 			continue;
 
 		d_by_name = tmp;
-		priority = tmp->base.priority;
 	}
 
 	return d_by_name ?: d_by_driver;
@@ -132,17 +163,15 @@ static struct digest_algo *digest_algo_get_by_algo(enum hash_algo algo)
 {
 	struct digest_algo *d = NULL;
 	struct digest_algo *tmp;
-	int priority = -1;
 
 	list_for_each_entry(tmp, &digests, list) {
 		if (tmp->base.algo != algo)
 			continue;
 
-		if (tmp->base.priority <= priority)
+		if (!digest_algo_better(tmp, d, DIGEST_SIZE_LARGE))
 			continue;
 
 		d = tmp;
-		priority = tmp->base.priority;
 	}
 
 	return d;
@@ -160,12 +189,10 @@ void digest_algo_prints(const char *prefix)
 	}
 }
 
-struct digest *digest_alloc(const char *name)
+static struct digest *digest_alloc_algo(struct digest_algo *algo)
 {
 	struct digest *d;
-	struct digest_algo *algo;
 
-	algo = digest_algo_get_by_name(name);
 	if (!algo)
 		return NULL;
 
@@ -179,26 +206,32 @@ struct digest *digest_alloc(const char *name)
 
 	return d;
 }
-EXPORT_SYMBOL_GPL(digest_alloc);
 
-struct digest *digest_alloc_by_algo(enum hash_algo hash_algo)
+struct digest *digest_alloc(const char *name)
 {
-	struct digest *d;
-	struct digest_algo *algo;
-
-	algo = digest_algo_get_by_algo(hash_algo);
-	if (!algo)
-		return NULL;
+	return digest_alloc_algo(digest_algo_get_by_name(name, 0));
+}
+EXPORT_SYMBOL_GPL(digest_alloc);
 
-	d = xzalloc(sizeof(*d));
-	d->algo = algo;
-	d->ctx = xzalloc(algo->ctx_length);
-	if (d->algo->alloc(d)) {
-		digest_free(d);
-		return NULL;
-	}
+/**
+ * digest_alloc_size - allocate the best digest driver for a data size
+ * @name: algorithm or driver name
+ * @size: typical amount of data passed to the digest at once
+ *
+ * Like digest_alloc(), but if digest_benchmark() has been run, picks the
+ * driver that was fastest for data of about @size bytes. Hardware
+ * accelerators may lose against the CPU for small buffers because of
+ * their setup overhead.
+ */
+struct digest *digest_alloc_size(const char *name, size_t size)
+{
+	return digest_alloc_algo(digest_algo_get_by_name(name, size));
+}
+EXPORT_SYMBOL_GPL(digest_alloc_size);
 
-	return d;
+struct digest *digest_alloc_by_algo(enum hash_algo hash_algo)
+{
+	return digest_alloc_algo(digest_algo_get_by_algo(hash_algo));
 }
 EXPORT_SYMBOL_GPL(digest_alloc_by_algo);
 
@@ -318,3 +351,255 @@ int digest_file_by_name(const char *algo, const char *filename,
 	return ret;
 }
 EXPORT_SYMBOL_GPL(digest_file_by_name);
+
+static void digest_free_percpu(struct digest **d)
+{
+	unsigned int i;
+
+	for (i = 0; i < smp_num_cpus(); i++)
+		digest_free(d[i]);
+	free(d);
+}
+
+/* one digest per CPU, as smp_run_jobs() may run jobs on all of them */
+static struct digest **digest_alloc_percpu(const char *algo, size_t size)
+{
+	unsigned int ncpus = smp_num_cpus(), i;
+	struct digest **d;
+
+	d = xzalloc(ncpus * sizeof(*d));
+
+	for (i = 0; i < ncpus; i++) {
+		d[i] = digest_alloc_size(algo, size);
+		if (!d[i]) {
+			digest_free_percpu(d);
+			return NULL;
+		}
+	}
+
+	return d;
+}
+
+struct digest_blocks {
+	struct digest **d;
+	const void *buf;
+	size_t len;
+	size_t blocksize;
+	u8 *hashes;
+};
+
+static int digest_one_block(void *data, unsigned int job, unsigned int cpu)
+{
+	struct digest_blocks *db = data;
+	struct digest *d = db->d[cpu];
+	size_t offset = (size_t)job * db->blocksize;
+
+	return digest_digest(d, db->buf + offset,
+			     min(db->blocksize, db->len - offset),
+			     db->hashes + job * digest_length(d));
+}
+
+/**
+ * digest_blocks - hash a buffer block by block
+ * @algo: name of the digest algorithm
+ * @buf: data to hash
+ * @len: length of @buf
+ * @blocksize: size of the blocks, the last one may be shorter
+ * @hashes: returns DIV_ROUND_UP(@len, @blocksize) digests back to back
+ *
+ * Every block is hashed on its own like the data blocks of a hash tree,
+ * so the blocks are spread over all CPUs available to smp_run_jobs().
+ *
+ * Return: 0 on success, negative error code otherwise
+ */
+int digest_blocks(const char *algo, const void *buf, size_t len,
+		  size_t blocksize, u8 *hashes)
+{
+	struct digest_blocks db = {
+		.buf = buf,
+		.len = len,
+		.blocksize = blocksize,
+		.hashes = hashes,
+	};
+	int ret;
+
+	if (!len || !blocksize)
+		return -EINVAL;
+
+	db.d = digest_alloc_percpu(algo, blocksize);
+	if (!db.d)
+		return -EINVAL;
+
+	ret = smp_run_jobs(digest_one_block, &db, DIV_ROUND_UP(len, blocksize));
+
+	digest_free_percpu(db.d);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(digest_blocks);
+
+struct digest_multi {
+	struct digest **d;
+	const struct digest_stream *streams;
+};
+
+static int digest_one_stream(void *data, unsigned int job, unsigned int cpu)
+{
+	struct digest_multi *dm = data;
+	const struct digest_stream *s = &dm->streams[job];
+
+	return digest_digest(dm->d[cpu], s->data, s->len, s->md);
+}
+
+/**
+ * digest_multi - hash several independent buffers
+ * @algo: name of the digest algorithm
+ * @streams: the buffers to hash and where to put their digests
+ * @nstreams: number of entries in @streams
+ *
+ * Hashing all images of a FIT configuration or all blocks of a hash tree
+ * level are independent jobs. They are distributed over all CPUs available
+ * to smp_run_jobs(), with the driver picked for the average stream size.
+ *
+ * Return: 0 on success, negative error code otherwise
+ */
+int digest_multi(const char *algo, const struct digest_stream *streams,
+		 unsigned int nstreams)
+{
+	struct digest_multi dm = {
+		.streams = streams,
+	};
+	size_t total = 0;
+	unsigned int i;
+	int ret;
+
+	if (!nstreams)
+		return 0;
+
+	for (i = 0; i < nstreams; i++)
+		total += streams[i].len;
+
+	dm.d = digest_alloc_percpu(algo, total / nstreams);
+	if (!dm.d)
+		return -EINVAL;
+
+	ret = smp_run_jobs(digest_one_stream, &dm, nstreams);
+
+	digest_free_percpu(dm.d);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(digest_multi);
+
+#define DIGEST_BENCH_NS		(100 * MSECOND)
+
+static const unsigned int digest_bench_sizes[DIGEST_SIZE_CLASSES] = {
+	[DIGEST_SIZE_SMALL] = 512,
+	[DIGEST_SIZE_MEDIUM] = SZ_16K,
+	[DIGEST_SIZE_LARGE] = SZ_1M,
+};
+
+static int digest_benchmark_one(struct digest_algo *algo, const void *buf)
+{
+	struct digest *d;
+	u8 *md;
+	int class, ret = 0;
+
+	d = digest_alloc_algo(algo);
+	if (!d)
+		return -ENOMEM;
+
+	md = xmalloc(digest_length(d));
+
+	for (class = 0; class < DIGEST_SIZE_CLASSES; class++) {
+		unsigned int size = digest_bench_sizes[class];
+		u64 start, ns, bytes = 0;
+
+		start = get_time_ns();
+
+		do {
+			ret = digest_digest(d, buf, size, md);
+			if (ret)
+				goto out;
+			bytes += size;
+			ns = get_time_ns() - start;
+		} while (ns < DIGEST_BENCH_NS);
+
+		algo->bench_kbps[class] = div64_u64(bytes * SECOND, ns) >> 10;
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
+	}
+out:
+	free(md);
+	digest_free(d);
+
+	return ret;
+}
+
+/**
+ * digest_benchmark - measure the throughput of digest drivers
+ * @name: algorithm or driver name to benchmark, NULL for all
+ *
+ * Every matching driver is measured for each size class and the results
+ * are printed. From then on digest_alloc() and friends pick the fastest
+ * driver for the requested size instead of going by static priority.
+ *
+ * Return: 0 on success, negative error code otherwise
+ */
+int digest_benchmark(const char *name)
+{
+	struct digest_algo *algo;
+	void *buf;
+	int class, ret = 0;
+
+	buf = malloc(digest_bench_sizes[DIGEST_SIZE_LARGE]);
+	if (!buf)
+		return -ENOMEM;
+
+	memset(buf, 0x5a, digest_bench_sizes[DIGEST_SIZE_LARGE]);
+
+	list_for_each_entry(algo, &digests, list) {
+		if (name && strcmp(algo->base.name, name) &&
+		    strcmp(algo->base.driver_name, name))
+			continue;
+
+		/* keyed digests can't be measured without a key */
+		if (algo->base.flags & DIGEST_ALGO_NEED_KEY)
+			continue;
+
+		ret = digest_benchmark_one(algo, buf);
+		if (ret)
+			goto out;
+	}
+
+	printf("%-15s %-20s %12s %12s %12s\n", "name", "driver",
+	       "512B MiB/s", "16K MiB/s", "1M MiB/s");
+
+	list_for_each_entry(algo, &digests, list) {
+		if (!algo->bench_kbps[DIGEST_SIZE_LARGE])
+			continue;
+
+		printf("%-15s %-20s", algo->base.name, algo->base.driver_name);
+
+		for (class = 0; class < DIGEST_SIZE_CLASSES; class++) {
+			unsigned int kbps = algo->bench_kbps[class];
+			bool best = digest_algo_get_by_name(algo->base.name,
+					digest_bench_sizes[class]) == algo;
+
+			printf(" %10u.%u%c", kbps >> 10,
+			       (kbps & 1023) * 10 / 1024, best ? '*' : ' ');
+		}
+
+		printf("\n");
+	}
+
+	printf("* fastest driver, used from now on for this size\n");
+out:
+	free(buf);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(digest_benchmark);
@@ -112,20 +112,26 @@ static int ahci_link_ok(struct ahci_port *ahci_port, int verbose)
 	return false;
 }
 
-static void ahci_fill_cmd_slot(struct ahci_port *ahci_port, u32 opts)
+static void *ahci_cmd_tbl(struct ahci_port *ahci_port, int slot)
 {
-	ahci_port->cmd_slot->opts = cpu_to_le32(opts);
-	ahci_port->cmd_slot->status = 0;
-	ahci_port->cmd_slot->tbl_addr =
-		cpu_to_le32(lower_32_bits(ahci_port->cmd_tbl_dma));
+	return ahci_port->cmd_tbl + slot * AHCI_CMD_TBL_SZ;
+}
+
+static void ahci_fill_cmd_slot(struct ahci_port *ahci_port, int slot, u32 opts)
+{
+	struct ahci_cmd_hdr *cmd_slot = &ahci_port->cmd_slot[slot];
+	dma_addr_t tbl_dma = ahci_port->cmd_tbl_dma + slot * AHCI_CMD_TBL_SZ;
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32(lower_32_bits(tbl_dma));
 	if (ahci_port->ahci->cap & HOST_CAP_64)
-		ahci_port->cmd_slot->tbl_addr_hi =
-			cpu_to_le32(upper_32_bits(ahci_port->cmd_tbl_dma));
+		cmd_slot->tbl_addr_hi = cpu_to_le32(upper_32_bits(tbl_dma));
 }
 
-static int ahci_fill_sg(struct ahci_port *ahci_port, dma_addr_t buf_dma, int buf_len)
+static int ahci_fill_sg(struct ahci_port *ahci_port, struct ahci_sg *ahci_sg,
+			dma_addr_t buf_dma, int buf_len)
 {
-	struct ahci_sg *ahci_sg = ahci_port->cmd_tbl_sg;
 	u32 sg_count;
 
 	sg_count = ((buf_len - 1) / AHCI_MAX_DATA_BYTE_COUNT) + 1;
@@ -173,11 +179,12 @@ static int ahci_io(struct ahci_port *ahci_port, u8 *fis, int fis_len, void *rbuf
 
 	memcpy(ahci_port->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(ahci_port, buf_dma, buf_len);
+	sg_count = ahci_fill_sg(ahci_port, ahci_port->cmd_tbl_sg, buf_dma,
+				buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16);
 	if (wbuf)
 		opts |= CMD_LIST_OPTS_WRITE;
-	ahci_fill_cmd_slot(ahci_port, opts);
+	ahci_fill_cmd_slot(ahci_port, 0, opts);
 
 	ahci_port_write_f(ahci_port, PORT_CMD_ISSUE, 1);
 
@@ -270,6 +277,200 @@ static int ahci_write(struct ata_port *ata, const void *buf, sector_t block,
 	return ahci_rw(ata, NULL, buf, block, num_blocks);
 }
 
+static void ahci_ncq_finish(struct ahci_port *ahci_port, int slot, int status)
+{
+	struct ahci_ncq_slot *ncq = &ahci_port->ncq[slot];
+	struct blk_request *req = ncq->req;
+
+	dma_unmap_single(ahci_port->ahci->dev, ncq->dma,
+			 req->num_blocks * SECTOR_SIZE,
+			 req->write ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+
+	ncq->req = NULL;
+	ahci_port->ncq_issued &= ~BIT(slot);
+
+	blk_request_complete(req, status);
+}
+
+static int ahci_port_stop_engine(struct ahci_port *ahci_port, u32 cmd)
+{
+	ahci_port_write_f(ahci_port, PORT_CMD, cmd & ~PORT_CMD_START);
+
+	return wait_on_timeout(500 * MSECOND,
+			!(ahci_port_read(ahci_port, PORT_CMD) & PORT_CMD_LIST_ON));
+}
+
+/*
+ * A failed queued command aborts all others. Fail them as well, restart
+ * the command list engine and read the NCQ error log, which takes the
+ * drive out of its error state.
+ */
+static int ahci_ncq_error(struct ahci_port *ahci_port, int status)
+{
+	u8 fis[20] = {
+		0x27,			/* Host to device FIS. */
+		1 << 7,			/* Command FIS. */
+		ATA_CMD_READ_LOG_EXT,
+	};
+	int slot, done = 0;
+	u32 cmd, val;
+	void *log;
+
+	/*
+	 * The buffers of the commands belong to the HBA until the engine
+	 * has stopped. If it does not stop, reset the link.
+	 */
+	cmd = ahci_port_read(ahci_port, PORT_CMD);
+	if (ahci_port_stop_engine(ahci_port, cmd)) {
+		ahci_port_info(ahci_port, "engine does not stop, resetting link\n");
+
+		val = ahci_port_read(ahci_port, PORT_SCR_CTL);
+		ahci_port_write_f(ahci_port, PORT_SCR_CTL, (val & ~0xf) | 1);
+		mdelay(1);
+		ahci_port_write_f(ahci_port, PORT_SCR_CTL, val & ~0xf);
+
+		/* keep the commands, this is tried again on the next poll */
+		if (wait_on_timeout(WAIT_LINKUP,
+				    (ahci_port_read(ahci_port, PORT_SCR_STAT) &
+				     PORT_SCR_STAT_DET) == 0x3)) {
+			ahci_port_info(ahci_port, "link does not come back\n");
+			return 0;
+		}
+
+		if (ahci_port_stop_engine(ahci_port, cmd))
+			return 0;
+	}
+
+	for (slot = 0; slot < ahci_port->nslots; slot++) {
+		if (ahci_port->ncq_issued & BIT(slot)) {
+			ahci_ncq_finish(ahci_port, slot, status);
+			done++;
+		}
+	}
+
+	val = ahci_port_read(ahci_port, PORT_SCR_ERR);
+	ahci_port_write(ahci_port, PORT_SCR_ERR, val);
+	val = ahci_port_read(ahci_port, PORT_IRQ_STAT);
+	ahci_port_write(ahci_port, PORT_IRQ_STAT, val);
+
+	ahci_port_write_f(ahci_port, PORT_CMD, cmd | PORT_CMD_START);
+
+	fis[4] = ATA_LOG_SATA_NCQ;
+	fis[7] = 1 << 6;
+	fis[12] = 1;
+
+	log = dma_alloc(SECTOR_SIZE);
+	if (ahci_io(ahci_port, fis, sizeof(fis), log, NULL, SECTOR_SIZE))
+		ahci_port_info(ahci_port, "reading NCQ error log failed\n");
+	dma_free(log);
+
+	return done;
+}
+
+static int ahci_ncq_submit(struct ata_port *ata, struct blk_request *req)
+{
+	struct ahci_port *ahci_port = container_of(ata, struct ahci_port, ata);
+	enum dma_data_direction dma_dir;
+	struct ahci_ncq_slot *ncq;
+	struct ahci_sg *ahci_sg;
+	sector_t block = req->block;
+	int slot, sg_count, len;
+	u8 *fis;
+	u32 opts;
+
+	if (req->num_blocks > ATA_NCQ_MAX_BLOCKS)
+		return -EINVAL;
+
+	for (slot = 0; slot < ahci_port->nslots; slot++)
+		if (!(ahci_port->ncq_issued & BIT(slot)))
+			break;
+
+	if (slot == ahci_port->nslots)
+		return -EBUSY;
+
+	if (!ahci_link_ok(ahci_port, 1))
+		return -EIO;
+
+	ncq = &ahci_port->ncq[slot];
+	fis = ahci_cmd_tbl(ahci_port, slot);
+	ahci_sg = ahci_cmd_tbl(ahci_port, slot) + AHCI_CMD_TBL_HDR_SZ;
+	dma_dir = req->write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+
+	len = req->num_blocks * SECTOR_SIZE;
+	ncq->dma = dma_map_single(ahci_port->ahci->dev, req->buf, len, dma_dir);
+
+	sg_count = ahci_fill_sg(ahci_port, ahci_sg, ncq->dma, len);
+	if (sg_count < 0) {
+		dma_unmap_single(ahci_port->ahci->dev, ncq->dma, len, dma_dir);
+		return sg_count;
+	}
+
+	memset(fis, 0, 20);
+	fis[0] = 0x27;			/* Host to device FIS. */
+	fis[1] = 1 << 7;		/* Command FIS. */
+	fis[2] = req->write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	fis[3] = req->num_blocks & 0xff;	/* count goes to the features */
+	fis[11] = (req->num_blocks >> 8) & 0xff;
+	fis[4] = (block >> 0) & 0xff;
+	fis[5] = (block >> 8) & 0xff;
+	fis[6] = (block >> 16) & 0xff;
+	fis[7] = 1 << 6;		/* device reg: set LBA mode */
+	fis[8] = (block >> 24) & 0xff;
+	fis[9] = (block >> 32) & 0xff;
+	fis[10] = (block >> 40) & 0xff;
+	fis[12] = slot << 3;		/* tag */
+
+	opts = (20 >> 2) | (sg_count << 16);
+	if (req->write)
+		opts |= CMD_LIST_OPTS_WRITE;
+	ahci_fill_cmd_slot(ahci_port, slot, opts);
+
+	ncq->req = req;
+	ahci_port->ncq_issued |= BIT(slot);
+
+	ahci_port_write_f(ahci_port, PORT_SCR_ACT, BIT(slot));
+	ahci_port_write_f(ahci_port, PORT_CMD_ISSUE, BIT(slot));
+
+	return 0;
+}
+
+static int ahci_ncq_poll(struct ata_port *ata)
+{
+	struct ahci_port *ahci_port = container_of(ata, struct ahci_port, ata);
+	u32 irq, active;
+	int slot, done = 0;
+
+	if (!ahci_port->ncq_issued)
+		return 0;
+
+	irq = ahci_port_read(ahci_port, PORT_IRQ_STAT);
+	if (irq)
+		ahci_port_write(ahci_port, PORT_IRQ_STAT, irq);
+
+	if (irq & (PORT_IRQ_FATAL)) {
+		ahci_port_info(ahci_port, "NCQ error, irq status 0x%08x\n", irq);
+		return ahci_ncq_error(ahci_port, -EIO);
+	}
+
+	/* the drive clears a command's SActive bit when it's done */
+	active = ahci_port_read(ahci_port, PORT_SCR_ACT);
+
+	for (slot = 0; slot < ahci_port->nslots; slot++) {
+		if (!(ahci_port->ncq_issued & BIT(slot)))
+			continue;
+
+		if (!(active & BIT(slot))) {
+			ahci_ncq_finish(ahci_port, slot, 0);
+			done++;
+		} else if (blk_request_timed_out(ahci_port->ncq[slot].req, WAIT_DATAIO)) {
+			ahci_port_info(ahci_port, "NCQ command timeout\n");
+			return done + ahci_ncq_error(ahci_port, -ETIMEDOUT);
+		}
+	}
+
+	return done;
+}
+
 static int ahci_init_port(struct ahci_port *ahci_port)
 {
 	u32 val, cmd;
@@ -292,8 +493,14 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 		mdelay(500);
 	}
 
+	/* one command table for each slot the NCQ code may use */
+	if (ahci_port->ahci->cap & HOST_CAP_NCQ)
+		ahci_port->nslots = ((ahci_port->ahci->cap & HOST_CAP_NCS) >> 8) + 1;
+	else
+		ahci_port->nslots = 1;
+
 	mem = dma_alloc_coherent(DMA_DEVICE_BROKEN,
-				 AHCI_PORT_PRIV_DMA_SZ, &mem_dma);
+				 AHCI_PORT_PRIV_DMA_SZ(ahci_port->nslots), &mem_dma);
 	if (!mem) {
 		return -ENOMEM;
 	}
@@ -315,8 +522,8 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	ahci_port->rx_fis_dma = mem_dma + AHCI_CMD_LIST_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing the commands and their
+	 * scatter-gather tables, one for each slot
 	 */
 	ahci_port->cmd_tbl = mem + AHCI_CMD_LIST_SZ + AHCI_RX_FIS_SZ;
 	ahci_port->cmd_tbl_dma = mem_dma + AHCI_CMD_LIST_SZ + AHCI_RX_FIS_SZ;
@@ -409,14 +616,19 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 
 	ahci_port_debug(ahci_port, "status: 0x%08x\n", val);
 
-	if ((val & PORT_SCR_STAT_DET) == 0x3)
+	if ((val & PORT_SCR_STAT_DET) == 0x3) {
+		if (ahci_port->nslots > 1) {
+			ahci_port->ncq = xzalloc(ahci_port->nslots * sizeof(*ahci_port->ncq));
+			ahci_port->ata.queue_depth = ahci_port->nslots;
+		}
 		return 0;
+	}
 
 	ret = -ENODEV;
 
 err_init:
 	dma_free_coherent(DMA_DEVICE_BROKEN,
-			  mem, mem_dma, AHCI_PORT_PRIV_DMA_SZ);
+			  mem, mem_dma, AHCI_PORT_PRIV_DMA_SZ(ahci_port->nslots));
 	return ret;
 }
 
@@ -445,6 +657,8 @@ static struct ata_port_operations ahci_ops = {
 	.read_id = ahci_read_id,
 	.read = ahci_read,
 	.write = ahci_write,
+	.submit = ahci_ncq_submit,
+	.poll = ahci_ncq_poll,
 };
 
 #if 0
@@ -471,7 +685,7 @@ static int ata_io_flush(u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
 	mywritel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
 	if (waiting_for_cmd_completed(port_mmio + PORT_CMD_ISSUE,
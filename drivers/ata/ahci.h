@@ -17,7 +17,7 @@
 #define AHCI_CMD_TBL_CDB	0x40
 #define AHCI_CMD_TBL_ITM_SZ	16
 #define AHCI_CMD_TBL_SZ		(AHCI_CMD_TBL_HDR_SZ + (AHCI_MAX_SG * AHCI_CMD_TBL_ITM_SZ))
-#define AHCI_PORT_PRIV_DMA_SZ	(AHCI_CMD_LIST_SZ + AHCI_CMD_TBL_SZ + AHCI_RX_FIS_SZ)
+#define AHCI_PORT_PRIV_DMA_SZ(slots)	(AHCI_CMD_LIST_SZ + (slots) * AHCI_CMD_TBL_SZ + AHCI_RX_FIS_SZ)
 
 #define AHCI_CMD_ATAPI		(1 << 5)
 #define AHCI_CMD_WRITE		(1 << 6)
@@ -168,6 +168,12 @@
 
 struct ahci_device;
 
+/* a command slot used for native command queueing */
+struct ahci_ncq_slot {
+	struct blk_request	*req;
+	dma_addr_t		dma;
+};
+
 struct ahci_port {
 	struct ata_port		ata;
 	struct ahci_device	*ahci;
@@ -181,6 +187,9 @@ struct ahci_port {
 	dma_addr_t		cmd_tbl_dma;
 	void			*rx_fis;
 	dma_addr_t		rx_fis_dma;
+	unsigned int		nslots;		/* command tables allocated */
+	u32			ncq_issued;	/* slots with a queued command */
+	struct ahci_ncq_slot	*ncq;
 };
 
 struct ahci_device {
@@ -195,6 +195,29 @@ static struct block_device_ops ata_ops = {
 #endif
 };
 
+static int ata_submit(struct block_device *blk, struct blk_request *req)
+{
+	struct ata_port *port = container_of(blk, struct ata_port, blk);
+
+	if (!IS_ENABLED(CONFIG_BLOCK_WRITE) && req->write)
+		return -EROFS;
+
+	return port->ops->submit(port, req);
+}
+
+static int ata_poll(struct block_device *blk)
+{
+	struct ata_port *port = container_of(blk, struct ata_port, blk);
+
+	return port->ops->poll(port);
+}
+
+/* used when both the controller and the drive support NCQ */
+static struct block_device_ops ata_queued_ops = {
+	.submit = ata_submit,
+	.poll = ata_poll,
+};
+
 static int ata_port_init(struct ata_port *port)
 {
 	int rc;
@@ -234,6 +257,15 @@ static int ata_port_init(struct ata_port *port)
 
 	port->lba48 = ata_id_has_lba48(port->id);
 
+	if (ops->submit && port->queue_depth > 1 && port->lba48 &&
+	    ata_id_has_ncq(port->id)) {
+		port->blk.ops = &ata_queued_ops;
+		port->blk.queue_depth = min(port->queue_depth,
+					    ata_id_queue_depth(port->id));
+		port->blk.max_request_blocks = ATA_NCQ_MAX_BLOCKS;
+		dev_dbg(dev, "using NCQ with %u commands\n", port->blk.queue_depth);
+	}
+
 	if (port->devname) {
 		port->blk.cdev.name = xstrdup(port->devname);
 	} else {
@@ -24,11 +24,13 @@
 #include <fs.h>
 #include <of.h>
 #include <linux/list.h>
+#include <linux/hash.h>
 #include <linux/overflow.h>
 #include <linux/err.h>
 #include <complete.h>
 #include <pinctrl.h>
 #include <featctrl.h>
+#include <boottrace.h>
 #include <linux/clk/clk-conf.h>
 
 #ifdef CONFIG_DEBUG_PROBES
@@ -121,6 +123,7 @@ static void dev_report_permanent_probe_deferral(struct device *dev)
 int device_probe(struct device *dev)
 {
 	static int depth = 0;
+	u64 start;
 	int ret;
 
 	ret = of_feature_controller_check(dev->of_node);
@@ -140,6 +143,8 @@ int device_probe(struct device *dev)
 
 	list_add(&dev->active, &active_device_list);
 
+	start = boottrace_start();
+
 	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
 	else if (dev->driver->probe)
@@ -147,6 +152,8 @@ int device_probe(struct device *dev)
 	else
 		ret = 0;
 
+	boottrace_add(BOOTTRACE_PROBE, start, dev_name(dev));
+
 	depth--;
 
 	switch (ret) {
@@ -241,10 +248,140 @@ static int match(struct driver *drv, struct device *dev)
 	return -1;
 }
 
-int register_device(struct device *new_device)
+/*
+ * On buses using device_match() a device with a device node can only bind
+ * to drivers without an of_compatible table or to drivers listing one of its
+ * compatibles. The compatibles of all registered drivers are indexed by
+ * hash, so a new device is only matched against these drivers instead of
+ * calling of_match() for every driver on the bus.
+ */
+#define DRIVER_COMPAT_HASH_BITS		8
+#define DRIVER_COMPAT_MAX_CANDIDATES	8
+
+struct driver_compat {
+	struct hlist_node node;
+	const char *compatible;
+	struct driver *drv;
+};
+
+static struct hlist_head driver_compat_hash[1 << DRIVER_COMPAT_HASH_BITS];
+
+static bool driver_compat_indexed(const struct bus_type *bus)
+{
+	return IS_ENABLED(CONFIG_OFDEVICE) && bus->match == device_match;
+}
+
+/* compatibles are compared case insensitive, see of_compat_cmp() */
+static struct hlist_head *driver_compat_bucket(const char *compatible)
+{
+	u32 hash = 0;
+
+	while (*compatible)
+		hash = hash * 31 + tolower(*compatible++);
+
+	return &driver_compat_hash[hash_32(hash, DRIVER_COMPAT_HASH_BITS)];
+}
+
+static void driver_compat_add(struct driver *drv)
+{
+	const struct of_device_id *id;
+	struct driver_compat *dc;
+
+	if (!drv->of_compatible || !driver_compat_indexed(drv->bus))
+		return;
+
+	for (id = drv->of_compatible; id->compatible; id++) {
+		dc = xzalloc(sizeof(*dc));
+		dc->compatible = id->compatible;
+		dc->drv = drv;
+		hlist_add_head(&dc->node, driver_compat_bucket(id->compatible));
+	}
+}
+
+static void driver_compat_del(struct driver *drv)
+{
+	const struct of_device_id *id;
+	struct driver_compat *dc;
+	struct hlist_node *tmp;
+
+	if (!drv->of_compatible || !driver_compat_indexed(drv->bus))
+		return;
+
+	for (id = drv->of_compatible; id->compatible; id++) {
+		hlist_for_each_entry_safe(dc, tmp, driver_compat_bucket(id->compatible), node) {
+			if (dc->drv == drv) {
+				hlist_del(&dc->node);
+				free(dc);
+			}
+		}
+	}
+}
+
+/*
+ * Collect the drivers listing a compatible of @dev. Returns the number of
+ * drivers found or -1 if the index can't be used for this device.
+ */
+static int driver_compat_candidates(struct device *dev, struct driver **cand)
 {
+	const struct property *prop;
+	struct driver_compat *dc;
+	const char *compat;
+	int i, n = 0;
+
+	if (!dev->of_node || !driver_compat_indexed(dev->bus))
+		return -1;
+
+	of_property_for_each_string(dev->of_node, "compatible", prop, compat) {
+		hlist_for_each_entry(dc, driver_compat_bucket(compat), node) {
+			if (of_compat_cmp(dc->compatible, compat, 0))
+				continue;
+
+			for (i = 0; i < n; i++)
+				if (cand[i] == dc->drv)
+					break;
+			if (i < n)
+				continue;
+
+			if (n == DRIVER_COMPAT_MAX_CANDIDATES)
+				return -1;
+
+			cand[n++] = dc->drv;
+		}
+	}
+
+	return n;
+}
+
+/*
+ * Try the drivers of the bus in registration order until one binds to
+ * @dev. Returns 0 if the device has a driver now.
+ */
+static int device_match_drivers(struct device *dev)
+{
+	struct driver *cand[DRIVER_COMPAT_MAX_CANDIDATES];
 	struct driver *drv;
+	int i, ncand;
+
+	ncand = driver_compat_candidates(dev, cand);
+
+	bus_for_each_driver(dev->bus, drv) {
+		if (ncand >= 0 && drv->of_compatible) {
+			for (i = 0; i < ncand; i++)
+				if (cand[i] == drv)
+					break;
+			if (i == ncand)
+				continue;
+		}
+
+		if (!match(drv, dev))
+			return 0;
+	}
 
+	return -ENODEV;
+}
+
+int register_device(struct device *new_device)
+{
 	if (new_device->id == DEVICE_ID_DYNAMIC) {
 		new_device->id = get_free_deviceid(new_device->name);
 	} else {
@@ -279,10 +416,7 @@ int register_device(struct device *new_device)
 
 		list_add_tail(&new_device->bus_list, &new_device->bus->device_list);
 
-		bus_for_each_driver(new_device->bus, drv) {
-			if (!match(drv, new_device))
-				break;
-		}
+		device_match_drivers(new_device);
 	}
 
 	if (new_device->parent)
@@ -385,7 +519,6 @@ EXPORT_SYMBOL(free_device);
 static int device_probe_deferred(void)
 {
 	struct device *dev, *tmp;
-	struct driver *drv;
 	bool success;
 
 	do {
@@ -399,12 +532,8 @@ static int device_probe_deferred(void)
 			INIT_LIST_HEAD(&dev->active);
 
 			dev_dbg(dev, "re-probe device\n");
-			bus_for_each_driver(dev->bus, drv) {
-				if (match(drv, dev))
-					continue;
+			if (!device_match_drivers(dev))
 				success = true;
-				break;
-			}
 		}
 	} while (success);
 
@@ -440,6 +569,7 @@ int register_driver(struct driver *drv)
 
 	list_add_tail(&drv->list, &driver_list);
 	list_add_tail(&drv->bus_list, &drv->bus->driver_list);
+	driver_compat_add(drv);
 
 	bus_for_each_device(drv->bus, dev)
 		match(drv, dev);
@@ -454,6 +584,7 @@ void unregister_driver(struct driver *drv)
 
 	list_del(&drv->list);
 	list_del(&drv->bus_list);
+	driver_compat_del(drv);
 
 	bus_for_each_device(drv->bus, dev) {
 		if (dev->driver == drv) {
@@ -8,78 +8,170 @@
 #include <driver.h>
 #include <block.h>
 #include <disks.h>
+#include <dma.h>
+#include <linux/sizes.h>
 #include <linux/virtio_types.h>
 #include <linux/virtio.h>
 #include <linux/virtio_ring.h>
 #include <uapi/linux/virtio_blk.h>
 
+/* requests kept in flight */
+#define VIRTIO_BLK_QUEUE_DEPTH	16
+
+/* requests are limited in size so that large reads are pipelined */
+#define VIRTIO_BLK_MAX_REQUEST	(SZ_256K >> SECTOR_SHIFT)
+
+/* device gets reset when a request takes longer than this */
+#define VIRTIO_BLK_TIMEOUT	NSEC_PER_SEC
+
+/* Header and status of one in flight request */
+struct virtio_blk_slot {
+	struct virtio_blk_outhdr hdr;
+	u8 status;
+	bool busy;
+	struct blk_request *req;
+} __aligned(DMA_ALIGNMENT);
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
 	struct virtio_device *vdev;
 	struct block_device blk;
+	struct virtio_blk_slot *slots;
+	unsigned int num_slots;
 };
 
-static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
-			     sector_t sector, blkcnt_t blkcnt, u32 type)
+static int virtio_blk_submit(struct block_device *blk, struct blk_request *req)
 {
-	unsigned int num_out = 0, num_in = 0;
-	struct scatterlist hdr_sg, data_sg, status_sg, *sgs[3];
-	u8 status = VIRTIO_BLK_S_IOERR;
+	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
+	struct scatterlist hdr_sg, status_sg, data_sg;
+	struct scatterlist *sgs[3];
+	unsigned int num_out = 0, num_in = 0, i;
+	struct virtio_blk_slot *slot = NULL;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(priv->vdev, type),
-		.sector = cpu_to_virtio64(priv->vdev, sector),
-	};
+	for (i = 0; i < priv->num_slots; i++) {
+		if (!priv->slots[i].busy) {
+			slot = &priv->slots[i];
+			break;
+		}
+	}
 
-	sg_init_one(&hdr_sg, &out_hdr, sizeof(out_hdr));
-	sgs[num_out++] = &hdr_sg;
+	if (!priv->vq)
+		return -EIO;
+
+	if (!slot)
+		return -EBUSY;
 
-	sg_init_one(&data_sg, buffer, blkcnt * 512);
+	slot->hdr.type = cpu_to_virtio32(priv->vdev, req->write ?
+					 VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN);
+	slot->hdr.ioprio = 0;
+	slot->hdr.sector = cpu_to_virtio64(priv->vdev, req->block);
+	slot->status = VIRTIO_BLK_S_IOERR;
+
+	sg_init_one(&hdr_sg, &slot->hdr, sizeof(slot->hdr));
+	sgs[num_out++] = &hdr_sg;
 
-	switch(type) {
-	case VIRTIO_BLK_T_OUT:
+	sg_init_one(&data_sg, req->buf, req->num_blocks << SECTOR_SHIFT);
+	if (req->write)
 		sgs[num_out++] = &data_sg;
-		break;
-	case VIRTIO_BLK_T_IN:
+	else
 		sgs[num_out + num_in++] = &data_sg;
-		break;
-	}
 
-	sg_init_one(&status_sg, &status, sizeof(status));
+	sg_init_one(&status_sg, &slot->status, sizeof(slot->status));
 	sgs[num_out + num_in++] = &status_sg;
 
-	ret = virtqueue_add_sgs(priv->vq, sgs, num_out, num_in, &out_hdr);
+	ret = virtqueue_add_sgs(priv->vq, sgs, num_out, num_in, slot);
+	if (ret == -ENOSPC)
+		return -EBUSY;
 	if (ret)
 		return ret;
 
-	virtqueue_kick(priv->vq);
+	slot->busy = true;
+	slot->req = req;
 
-	if (!virtqueue_get_buf_timeout(priv->vq, NULL, NSEC_PER_SEC))
-		return -ETIMEDOUT;
+	virtqueue_kick(priv->vq);
 
-	return status == VIRTIO_BLK_S_OK ? 0 : -EIO;
+	return 0;
 }
 
-static int virtio_blk_read(struct block_device *blk, void *buffer,
-			   sector_t start, blkcnt_t blkcnt)
+/*
+ * The device owns the buffers of all requests in the virtqueue, so they can
+ * only be given back to their submitters after a reset. Fail all of them and
+ * set up the virtqueue again like the probe does.
+ */
+static int virtio_blk_reset(struct virtio_blk_priv *priv)
 {
-	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
-	return virtio_blk_do_req(priv, buffer, start, blkcnt,
-				 VIRTIO_BLK_T_IN);
+	struct virtio_device *vdev = priv->vdev;
+	struct blk_request *req;
+	int i, ret, done = 0;
+
+	dev_err(&vdev->dev, "request timed out, resetting device\n");
+
+	vdev->config->reset(vdev);
+	vdev->config->del_vqs(vdev);
+	priv->vq = NULL;
+
+	virtio_add_status(vdev, VIRTIO_CONFIG_S_ACKNOWLEDGE);
+	virtio_add_status(vdev, VIRTIO_CONFIG_S_DRIVER);
+
+	ret = virtio_finalize_features(vdev);
+	if (!ret)
+		ret = virtio_find_vqs(vdev, 1, &priv->vq);
+	if (ret) {
+		dev_err(&vdev->dev, "cannot reinitialize: %pe\n", ERR_PTR(ret));
+		priv->vq = NULL;
+	} else {
+		virtio_device_ready(vdev);
+	}
+
+	for (i = 0; i < priv->num_slots; i++) {
+		struct virtio_blk_slot *slot = &priv->slots[i];
+
+		if (!slot->busy)
+			continue;
+
+		req = slot->req;
+		slot->busy = false;
+		slot->req = NULL;
+		blk_request_complete(req, -ETIMEDOUT);
+		done++;
+	}
+
+	return done;
 }
 
-static int virtio_blk_write(struct block_device *blk, const void *buffer,
-			    sector_t start, blkcnt_t blkcnt)
+static int virtio_blk_poll(struct block_device *blk)
 {
 	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
-	return virtio_blk_do_req(priv, (void *)buffer, start, blkcnt,
-				 VIRTIO_BLK_T_OUT);
+	struct virtio_blk_slot *slot;
+	int i, done = 0;
+
+	if (!priv->vq)
+		return 0;
+
+	while ((slot = virtqueue_get_buf(priv->vq, NULL))) {
+		struct blk_request *req = slot->req;
+
+		slot->busy = false;
+		slot->req = NULL;
+
+		blk_request_complete(req, slot->status == VIRTIO_BLK_S_OK ? 0 : -EIO);
+		done++;
+	}
+
+	for (i = 0; i < priv->num_slots; i++) {
+		slot = &priv->slots[i];
+
+		if (slot->busy && blk_request_timed_out(slot->req, VIRTIO_BLK_TIMEOUT))
+			return done + virtio_blk_reset(priv);
+	}
+
+	return done;
 }
 
 static struct block_device_ops virtio_blk_ops = {
-	.read	= virtio_blk_read,
-	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 static int virtio_blk_probe(struct virtio_device *vdev)
@@ -98,6 +190,12 @@ static int virtio_blk_probe(struct virtio_device *vdev)
 	priv->vdev = vdev;
 	vdev->priv = priv;
 
+	/* a request needs three descriptors */
+	priv->num_slots = clamp_t(unsigned int,
+				  virtqueue_get_vring_size(priv->vq) / 3, 1,
+				  VIRTIO_BLK_QUEUE_DEPTH);
+	priv->slots = dma_zalloc(priv->num_slots * sizeof(*priv->slots));
+
 	devnum = cdev_find_free_index("virtioblk");
 	priv->blk.cdev.name = xasprintf("virtioblk%d", devnum);
 	cdev_set_of_node(&priv->blk.cdev, vdev->dev.device_node);
@@ -107,6 +205,8 @@ static int virtio_blk_probe(struct virtio_device *vdev)
 	priv->blk.num_blocks = cap;
 	priv->blk.ops = &virtio_blk_ops;
 	priv->blk.type = BLK_TYPE_VIRTUAL;
+	priv->blk.queue_depth = priv->num_slots;
+	priv->blk.max_request_blocks = VIRTIO_BLK_MAX_REQUEST;
 
 	return blockdevice_register(&priv->blk);
 }
@@ -115,10 +215,13 @@ static void virtio_blk_remove(struct virtio_device *vdev)
 {
 	struct virtio_blk_priv *priv = vdev->priv;
 
-	vdev->config->reset(vdev);
+	/* flushes the dirty cache, which still needs the virtqueue */
 	blockdevice_unregister(&priv->blk);
-	vdev->config->del_vqs(vdev);
+	vdev->config->reset(vdev);
+	if (priv->vq)
+		vdev->config->del_vqs(vdev);
 
+	dma_free(priv->slots);
 	free(priv);
 }
 
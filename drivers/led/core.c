@@ -111,6 +111,7 @@ int led_set(struct led *led, unsigned int value)
 
 static void led_blink_func(struct poller_struct *poller)
 {
+	uint64_t next = POLLER_DEADLINE_NONE;
 	struct led *led;
 
 	list_for_each_entry(led, &leds, list) {
@@ -121,6 +122,7 @@ static void led_blink_func(struct poller_struct *poller)
 			continue;
 
 		if (led->blink_next_event > now) {
+			next = min(next, led->blink_next_event);
 			continue;
 		}
 
@@ -137,9 +139,19 @@ static void led_blink_func(struct poller_struct *poller)
 			led->flash = 0;
 
 		__led_set(led, on);
+
+		if (led->blink || led->flash)
+			next = min(next, led->blink_next_event);
 	}
+
+	/* sleep until the next LED has to change its state */
+	poller_set_deadline(poller, next);
 }
 
+static struct poller_struct led_poller = {
+	.func = led_blink_func,
+};
+
 /**
  * led_blink_pattern - Blink a led with flexible timings.
  * @led LED used
@@ -168,6 +180,8 @@ int led_blink_pattern(struct led *led, const unsigned int *pattern,
 	led->blink = 1;
 	led->flash = 0;
 
+	poller_set_deadline(&led_poller, 0);
+
 	return 0;
 }
 
@@ -193,10 +207,6 @@ int led_flash(struct led *led, unsigned int duration_ms)
 	return 0;
 }
 
-static struct poller_struct led_poller = {
-	.func = led_blink_func,
-};
-
 static int led_blink_init(void)
 {
 	return poller_register(&led_poller, "led");
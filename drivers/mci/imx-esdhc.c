@@ -619,6 +619,9 @@ static int fsl_esdhc_probe(struct device *dev)
 	if (!usdhc_setup_tuning(host))
 		host->sdhci.quirks2 |= SDHCI_QUIRK2_BROKEN_HS200;
 
+	/* The eSDHC keeps its DMA select bits elsewhere in PROCTL */
+	host->sdhci.quirks |= SDHCI_QUIRK_BROKEN_ADMA;
+
 	ret = sdhci_setup_host(&host->sdhci);
 	if (ret)
 		goto err_clk_disable;
@@ -363,6 +363,21 @@ int mci_set_blockcount(struct mci *mci, unsigned int cmdarg)
 	return mci_send_cmd(mci, &cmd, NULL);
 }
 
+/*
+ * Whether a multi-block transfer can be announced with SET_BLOCK_COUNT, which
+ * saves the STOP_TRANSMISSION round trip after every read.
+ */
+static bool mci_use_cmd23(struct mci *mci, int blocks)
+{
+	if (!(mci->host->host_caps & MMC_CAP_CMD23) || blocks > 0xffff)
+		return false;
+
+	if (IS_SD(mci))
+		return mci->scr[0] & SD_SCR_CMD23_SUPPORT;
+
+	return mci->version >= MMC_VERSION_3;
+}
+
 /**
  * Read one or several block(s) of data from the card
  * @param mci MCI instance
@@ -375,13 +390,17 @@ static int mci_block_read(struct mci *mci, void *dst, int blocknum,
 {
 	struct mci_cmd cmd = {};
 	struct mci_data data;
+	bool cmd23 = false;
 	int ret;
 	unsigned mmccmd;
 
-	if (blocks > 1)
+	if (blocks > 1) {
 		mmccmd = MMC_CMD_READ_MULTIPLE_BLOCK;
-	else
+		cmd23 = mci_use_cmd23(mci, blocks) &&
+			!mci_set_blockcount(mci, blocks);
+	} else {
 		mmccmd = MMC_CMD_READ_SINGLE_BLOCK;
+	}
 
 	mci_setup_cmd(&cmd,
 		mmccmd,
@@ -395,7 +414,8 @@ static int mci_block_read(struct mci *mci, void *dst, int blocknum,
 
 	ret = mci_send_cmd(mci, &cmd, &data);
 
-	if (ret || blocks > 1) {
+	/* With SET_BLOCK_COUNT the card stops on its own */
+	if (ret || (blocks > 1 && !cmd23)) {
 		mci_setup_cmd(&cmd, MMC_CMD_STOP_TRANSMISSION, 0,
 			      IS_SD(mci) ? MMC_RSP_R1b : MMC_RSP_R1);
 		mci_send_cmd(mci, &cmd, NULL);
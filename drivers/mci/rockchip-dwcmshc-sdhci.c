@@ -61,7 +61,8 @@
 						SDHCI_INT_DATA_AVAIL | \
 						SDHCI_INT_DATA_TIMEOUT | \
 						SDHCI_INT_DATA_CRC | \
-						SDHCI_INT_DATA_END_BIT
+						SDHCI_INT_DATA_END_BIT | \
+						SDHCI_INT_ADMA_ERROR
 
 #define SDHCI_DWCMSHC_INT_CMD_MASK		SDHCI_INT_CMD_COMPLETE | \
 						SDHCI_INT_TIMEOUT | \
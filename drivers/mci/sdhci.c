@@ -446,7 +446,7 @@ void sdhci_setup_data_pio(struct sdhci *sdhci, struct mci_data *data)
 		      SDHCI_TRANSFER_BLOCK_SIZE(data->blocksize) | data->blocks << 16);
 }
 
-static void sdhci_config_dma(struct sdhci *host)
+static void sdhci_config_dma(struct sdhci *host, bool adma)
 {
 	u8 ctrl;
 	u16 ctrl2;
@@ -457,7 +457,8 @@ static void sdhci_config_dma(struct sdhci *host)
 	ctrl = sdhci_read8(host, SDHCI_HOST_CONTROL);
 	/* Note if DMA Select is zero then SDMA is selected */
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
-	sdhci_write8(host, SDHCI_HOST_CONTROL, ctrl);
+	if (adma)
+		ctrl |= SDHCI_CTRL_ADMA32;
 
 	if (host->flags & SDHCI_USE_64_BIT_DMA) {
 		/*
@@ -469,8 +470,52 @@ static void sdhci_config_dma(struct sdhci *host)
 			ctrl2 = sdhci_read16(host, SDHCI_HOST_CONTROL2);
 			ctrl2 |= SDHCI_CTRL_64BIT_ADDR;
 			sdhci_write16(host, SDHCI_HOST_CONTROL2, ctrl2);
+		} else if (adma) {
+			ctrl |= SDHCI_CTRL_ADMA64;
 		}
 	}
+
+	sdhci_write8(host, SDHCI_HOST_CONTROL, ctrl);
+}
+
+/*
+ * Describe a mapped buffer with ADMA2 descriptors. The whole transfer then
+ * runs without the boundary interrupts SDMA needs.
+ */
+static int sdhci_adma_write_table(struct sdhci *host, dma_addr_t addr,
+				  unsigned int len)
+{
+	bool dma64 = host->flags & SDHCI_USE_64_BIT_DMA;
+	struct sdhci_adma2_64_desc *desc = NULL;
+	void *p = host->adma_table;
+
+	if (!IS_ALIGNED(addr, 4) || !IS_ALIGNED(len, 4))
+		return -EINVAL;
+
+	if (!dma64 && upper_32_bits(addr + len - 1))
+		return -EINVAL;
+
+	if (DIV_ROUND_UP(len, SDHCI_ADMA2_MAX_LEN) > SDHCI_ADMA2_MAX_DESCS)
+		return -E2BIG;
+
+	while (len) {
+		unsigned int now = min_t(unsigned int, len, SDHCI_ADMA2_MAX_LEN);
+
+		desc = p;
+		desc->cmd = cpu_to_le16(SDHCI_ADMA2_VALID | SDHCI_ADMA2_ACT_TRAN);
+		desc->len = cpu_to_le16(now);
+		desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+		if (dma64)
+			desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+
+		addr += now;
+		len -= now;
+		p += host->adma_desc_sz;
+	}
+
+	desc->cmd |= cpu_to_le16(SDHCI_ADMA2_END);
+
+	return 0;
 }
 
 void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
@@ -504,7 +549,14 @@ void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
 		return;
 	}
 
-	sdhci_config_dma(sdhci);
+	if ((sdhci->flags & SDHCI_USE_ADMA) &&
+	    !sdhci_adma_write_table(sdhci, *dma, nbytes)) {
+		sdhci_config_dma(sdhci, true);
+		sdhci_set_adma_addr(sdhci, sdhci->adma_addr);
+		return;
+	}
+
+	sdhci_config_dma(sdhci, false);
 	sdhci_set_sdma_addr(sdhci, *dma);
 }
 
@@ -529,6 +581,7 @@ int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_cmd *cmd,
 			    struct mci_data *data, dma_addr_t dma)
 {
 	struct device *dev = sdhci_dev(sdhci);
+	dma_addr_t sdma_addr = dma;
 	u64 start;
 	int nbytes;
 	u32 irqcheck, irqstat;
@@ -563,22 +616,31 @@ int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_cmd *cmd,
 			goto out;
 		}
 
+		if (irqstat & SDHCI_INT_ADMA_ERROR) {
+			dev_err(dev, "ADMA error: 0x%08x\n",
+				sdhci_read32(sdhci, SDHCI_ADMA_ERROR));
+			ret = -EIO;
+			goto out;
+		}
+
 		/*
-		 * We currently don't do anything fancy with DMA
-		 * boundaries, but as we can't disable the feature
-		 * we need to at least restart the transfer.
+		 * Only SDMA stops at buffer boundaries, as we can't disable
+		 * the feature we need to restart the transfer there.
 		 *
 		 * According to the spec sdhci_readl(host, SDHCI_DMA_ADDRESS)
 		 * should return a valid address to continue from, but as
 		 * some controllers are faulty, don't trust them.
 		 */
 		if (irqstat & SDHCI_INT_DMA) {
+			u32 boundary = SZ_4K << ((sdhci->sdma_boundary >> 12) & 0x7);
+
 			/*
 			 * DMA engine has stopped on buffer boundary. Acknowledge
 			 * the interrupt and kick the DMA engine again.
 			 */
 			sdhci_write32(sdhci, SDHCI_INT_STATUS, SDHCI_INT_DMA);
-			sdhci_set_sdma_addr(sdhci, ALIGN(dma, SDHCI_DEFAULT_BOUNDARY_SIZE));
+			sdma_addr = ALIGN(sdma_addr + 1, boundary);
+			sdhci_set_sdma_addr(sdhci, sdma_addr);
 		}
 
 		if (irqstat & irqcheck)
@@ -1028,6 +1090,24 @@ int sdhci_setup_host(struct sdhci *host)
 	if (sdhci_can_64bit_dma(host))
 		host->flags |= SDHCI_USE_64_BIT_DMA;
 
+	if (!IN_PBL && host->version >= SDHCI_SPEC_200 &&
+	    (host->caps & SDHCI_CAN_DO_ADMA2) &&
+	    !(host->quirks & SDHCI_QUIRK_BROKEN_ADMA)) {
+		if (host->flags & SDHCI_USE_64_BIT_DMA)
+			host->adma_desc_sz = SDHCI_ADMA2_64_DESC_SZ(host);
+		else
+			host->adma_desc_sz = SDHCI_ADMA2_32_DESC_SZ;
+
+		host->adma_table = dma_alloc_coherent(DMA_DEVICE_BROKEN,
+						      SDHCI_ADMA2_MAX_DESCS * host->adma_desc_sz,
+						      &host->adma_addr);
+		if (host->adma_table)
+			host->flags |= SDHCI_USE_ADMA;
+	}
+
+	/* CMD23 is a plain command, the core sends it before multi-block reads */
+	mci->host_caps |= MMC_CAP_CMD23;
+
 	if (host->quirks2 & SDHCI_QUIRK2_NO_1_8_V) {
 		host->caps1 &= ~(SDHCI_SUPPORT_SDR104 | SDHCI_SUPPORT_SDR50 |
 				 SDHCI_SUPPORT_DDR50);
@@ -114,6 +114,7 @@
 #define  SDHCI_INT_CRC				BIT(17)
 #define  SDHCI_INT_TIMEOUT			BIT(16)
 #define  SDHCI_INT_ERROR			BIT(15)
+#define  SDHCI_INT_ADMA_ERROR			BIT(25)
 #define  SDHCI_INT_CARD_INT			BIT(8)
 #define  SDHCI_INT_CARD_INSERT			BIT(6)
 #define  SDHCI_INT_DATA_AVAIL			BIT(5)
@@ -202,6 +203,7 @@
 
 #define  SDHCI_CLOCK_MUL_SHIFT	16
 
+#define SDHCI_ADMA_ERROR					0x54
 #define SDHCI_ADMA_ADDRESS					0x58
 #define SDHCI_ADMA_ADDRESS_HI					0x5c
 
@@ -212,6 +214,29 @@
 
 #define SDHCI_CMD_DEFAULT_BUSY_TIMEOUT_NS	(10 * NSEC_PER_MSEC)
 
+/* ADMA2 descriptor attributes */
+#define SDHCI_ADMA2_VALID	BIT(0)
+#define SDHCI_ADMA2_END		BIT(1)
+#define SDHCI_ADMA2_ACT_TRAN	(0x2 << 4)
+
+/* 32-bit descriptors are 8 bytes, 64-bit ones 12 or, in v4 mode, 16 bytes */
+#define SDHCI_ADMA2_32_DESC_SZ		8
+#define SDHCI_ADMA2_64_DESC_SZ(host)	((host)->v4_mode ? 16 : 12)
+
+/*
+ * Length per descriptor, below the 64KiB some controllers get wrong, and
+ * number of descriptors. Larger or unaligned transfers fall back to SDMA.
+ */
+#define SDHCI_ADMA2_MAX_LEN	SZ_32K
+#define SDHCI_ADMA2_MAX_DESCS	128
+
+struct sdhci_adma2_64_desc {
+	__le16 cmd;
+	__le16 len;
+	__le32 addr_lo;
+	__le32 addr_hi;
+} __packed __aligned(4);
+
 struct sdhci {
 	u32 (*read32)(struct sdhci *host, int reg);
 	u16 (*read16)(struct sdhci *host, int reg);
@@ -247,6 +272,8 @@ struct sdhci {
 	bool v4_mode;		/* Host Version 4 Enable */
 
 	unsigned int quirks;
+/* Controller doesn't do ADMA2 the standard way */
+#define SDHCI_QUIRK_BROKEN_ADMA			BIT(6)
 #define SDHCI_QUIRK_MISSING_CAPS		BIT(27)
 	unsigned int quirks2;
 /* The system physically doesn't support 1.8v, even if the host does */
@@ -260,6 +287,10 @@ struct sdhci {
 	bool read_caps;	/* Capability flags have been read */
 	u32 sdma_boundary;
 
+	void *adma_table;	/* ADMA2 descriptors, with SDHCI_USE_ADMA */
+	dma_addr_t adma_addr;
+	unsigned int adma_desc_sz;
+
 	unsigned int		tuning_count;	/* Timer count for re-tuning */
 	unsigned int		tuning_mode;	/* Re-tuning mode supported by host */
 	unsigned int		tuning_err;	/* Error code for re-tuning */
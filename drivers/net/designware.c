@@ -141,23 +141,23 @@ static void rx_descs_init(struct eth_device *dev)
 	struct dw_eth_dev *priv = dev->priv;
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
 	struct dmamacdescr *desc_table_p = &priv->rx_mac_descrtable_cpu[0];
-	char *rxbuffs = &priv->rxbuffs[0];
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
 	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
 		desc_p = &desc_table_p[idx];
-		desc_p->dmamac_addr = virt_to_phys(&rxbuffs[idx * CONFIG_ETH_BUFSIZE]);
+		desc_p->dmamac_addr = virt_to_phys(priv->rxbuffs[idx]);
 		desc_p->dmamac_next = rx_dma_addr(priv, &desc_table_p[idx + 1]);
 
-		desc_p->dmamac_cntl = MAC_MAX_FRAME_SZ;
+		/* receive buffers come from the packet pool */
+		desc_p->dmamac_cntl = PKTSIZE;
 		if (priv->enh_desc)
 			desc_p->dmamac_cntl |= DESC_ENH_RXCTRL_RXCHAIN;
 		else
 			desc_p->dmamac_cntl |= DESC_RXCTRL_RXCHAIN;
 
 		dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
-					CONFIG_ETH_BUFSIZE, DMA_FROM_DEVICE);
+					PKTSIZE, DMA_FROM_DEVICE);
 		desc_p->txrx_status = DESC_RXSTS_OWNBYDMA;
 	}
 
@@ -324,18 +324,19 @@ static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static void dwc_ether_rx(struct eth_device *dev)
+static int dwc_ether_rx_one(struct eth_device *dev)
 {
 	struct dw_eth_dev *priv = dev->priv;
 	u32 desc_num = priv->rx_currdescnum;
 	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable_cpu[desc_num];
+	char *buf = priv->rxbuffs[desc_num];
 
 	u32 status = desc_p->txrx_status;
 	int length = 0;
 
 	/* Check  if the owner is the CPU */
 	if (status & DESC_RXSTS_OWNBYDMA)
-		return;
+		return -EAGAIN;
 
 	if ((status & (DESC_RXSTS_ERROR | DESC_RXSTS_DAFILTERFAIL |
 		       DESC_RXSTS_SAFILTERFAIL)) ||
@@ -343,6 +344,7 @@ static void dwc_ether_rx(struct eth_device *dev)
 		       DESC_RXSTS_RXFRAMEETHER)) ==
 	    DESC_RXSTS_RXIPC_GIANTFRAME) {
 		/* Error in packet - discard it */
+		dev->rx_dropped++;
 		dev_warn(&dev->dev, "Rx error status (%x)\n",
 			 status & (DESC_RXSTS_DAFILTERFAIL |
 				   DESC_RXSTS_ERROR |
@@ -362,7 +364,15 @@ static void dwc_ether_rx(struct eth_device *dev)
 
 		dma_sync_single_for_cpu(dev->parent, desc_p->dmamac_addr,
 					length, DMA_FROM_DEVICE);
-		net_receive(dev, dmamac_addr(desc_p), length);
+		net_receive(dev, buf, length);
+
+		/* a protocol may hold on to the packet, then use a fresh one */
+		priv->rxbuffs[desc_num] = net_packet_rx_recycle(buf);
+		if (priv->rxbuffs[desc_num] != buf) {
+			desc_p->dmamac_addr = virt_to_phys(priv->rxbuffs[desc_num]);
+			length = PKTSIZE;
+		}
+
 		dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
 					   length, DMA_FROM_DEVICE);
 	}
@@ -378,6 +388,18 @@ static void dwc_ether_rx(struct eth_device *dev)
 		desc_num = 0;
 
 	priv->rx_currdescnum = desc_num;
+
+	return 0;
+}
+
+static void dwc_ether_rx(struct eth_device *dev)
+{
+	int i;
+
+	/* handle all frames received since the last poll */
+	for (i = 0; i < CONFIG_RX_DESCR_NUM; i++)
+		if (dwc_ether_rx_one(dev))
+			break;
 }
 
 static void dwc_ether_halt (struct eth_device *dev)
@@ -497,7 +519,10 @@ struct dw_eth_dev *dwc_drv_probe(struct device *dev)
 		return ERR_PTR(-EFAULT);
 
 	priv->txbuffs = dma_alloc(TX_TOTAL_BUFSIZE);
-	priv->rxbuffs = dma_alloc(RX_TOTAL_BUFSIZE);
+
+	ret = net_alloc_rx_packets((void **)priv->rxbuffs, CONFIG_RX_DESCR_NUM);
+	if (ret)
+		return ERR_PTR(ret);
 
 	edev = &priv->netdev;
 	miibus = &priv->miibus;
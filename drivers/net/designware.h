@@ -10,6 +10,11 @@
 #include <net.h>
 #include <linux/types.h>
 
+#define CONFIG_TX_DESCR_NUM	16
+#define CONFIG_RX_DESCR_NUM	32
+#define CONFIG_ETH_BUFSIZE	2048
+#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
+
 struct dw_eth_dev {
 	struct eth_device netdev;
 	struct mii_bus miibus;
@@ -26,7 +31,7 @@ struct dw_eth_dev {
 	dma_addr_t rx_mac_descrtable_dev;
 
 	u8 *txbuffs;
-	u8 *rxbuffs;
+	char *rxbuffs[CONFIG_RX_DESCR_NUM];
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -60,12 +65,6 @@ static inline dma_addr_t rx_dma_addr(struct dw_eth_dev *priv,
 struct dw_eth_dev *dwc_drv_probe(struct device *dev);
 void dwc_drv_remove(struct device *dev);
 
-#define CONFIG_TX_DESCR_NUM	16
-#define CONFIG_RX_DESCR_NUM	16
-#define CONFIG_ETH_BUFSIZE	2048
-#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
-#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
-
 struct eth_mac_regs {
 	u32 conf;		/* 0x00 */
 	u32 framefilt;		/* 0x04 */
@@ -524,66 +524,54 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 	return 0;
 }
 
-/**
- * Pull one frame from the card
- * @param[in] dev Our ethernet device to handle
- * @return Length of packet read
+/*
+ * A protocol may hold on to the received packet. Put a fresh one into the
+ * ring then.
  */
-static void fec_recv(struct eth_device *dev)
+static void fec_recycle_packet(struct fec_priv *fec,
+			       struct buffer_descriptor __iomem *rbd)
+{
+	char *frame = fec->rx_buf[fec->rbd_index];
+	char *fresh = net_packet_rx_recycle(frame);
+	dma_addr_t dma;
+
+	if (fresh == frame)
+		return;
+
+	dma_unmap_single(fec->dev, readl(&rbd->data_pointer),
+			 FEC_MAX_PKT_SIZE, DMA_FROM_DEVICE);
+
+	dma = dma_map_single(fec->dev, fresh, FEC_MAX_PKT_SIZE, DMA_FROM_DEVICE);
+	BUG_ON(dma_mapping_error(fec->dev, dma));
+
+	fec->rx_buf[fec->rbd_index] = fresh;
+	writel(dma, &rbd->data_pointer);
+}
+
+static int fec_recv_one(struct eth_device *dev)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
 	struct buffer_descriptor __iomem *rbd = &fec->rbd_base[fec->rbd_index];
-	uint32_t ievent;
 	int len = 0;
 	uint16_t bd_status;
 
-	/*
-	 * Check if any critical events have happened
-	 */
-	ievent = readl(fec->regs + FEC_IEVENT);
-	ievent &= ~FEC_IEVENT_MII;
-	writel(ievent, fec->regs + FEC_IEVENT);
-
-	if (ievent & FEC_IEVENT_BABT) {
-		/* BABT, Rx/Tx FIFO errors */
-		fec_halt(dev);
-		fec_init(dev);
-		dev_err(&dev->dev, "some error: 0x%08x\n", ievent);
-		return;
-	}
-	if (!fec_is_imx28(fec)) {
-		if (ievent & FEC_IEVENT_HBERR) {
-			/* Heartbeat error */
-			writel(readl(fec->regs + FEC_X_CNTRL) | 0x1,
-					fec->regs + FEC_X_CNTRL);
-		}
-	}
-	if (ievent & FEC_IEVENT_GRA) {
-		/* Graceful stop complete */
-		if (readl(fec->regs + FEC_X_CNTRL) & 0x00000001) {
-			fec_halt(dev);
-			writel(readl(fec->regs + FEC_X_CNTRL) & ~0x00000001,
-					fec->regs + FEC_X_CNTRL);
-			fec_init(dev);
-		}
-	}
-
 	/*
 	 * ensure reading the right buffer status
 	 */
 	bd_status = readw(&rbd->status);
 
 	if (bd_status & FEC_RBD_EMPTY)
-		return;
+		return -EAGAIN;
 
 	if (bd_status & FEC_RBD_ERR) {
+		dev->rx_dropped++;
 		dev_warn(&dev->dev, "error frame: 0x%p 0x%08x\n",
 			 rbd, bd_status);
 	} else if (bd_status & FEC_RBD_LAST) {
 		const uint16_t data_length = readw(&rbd->data_length);
 
 		if (data_length - 4 > 14) {
-			void *frame = phys_to_virt(readl(&rbd->data_pointer));
+			void *frame = fec->rx_buf[fec->rbd_index];
 			/*
 			 * Sync the data for CPU so that endianness
 			 * fixup and net_receive below would get
@@ -604,6 +592,7 @@ static void fec_recv(struct eth_device *dev)
 			dma_sync_single_for_device(fec->dev, (unsigned long)frame,
 						   data_length,
 						   DMA_FROM_DEVICE);
+			fec_recycle_packet(fec, rbd);
 		}
 	}
 	/*
@@ -613,17 +602,67 @@ static void fec_recv(struct eth_device *dev)
 	fec_rbd_clean(fec->rbd_index == (FEC_RBD_NUM - 1) ? 1 : 0, rbd);
 	fec_rx_task_enable(fec);
 	fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+
+	return 0;
 }
 
-static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
+/**
+ * Pull all received frames from the card
+ * @param[in] dev Our ethernet device to handle
+ */
+static void fec_recv(struct eth_device *dev)
 {
-	void *p;
+	struct fec_priv *fec = (struct fec_priv *)dev->priv;
+	uint32_t ievent;
 	int i;
 
+	/*
+	 * Check if any critical events have happened
+	 */
+	ievent = readl(fec->regs + FEC_IEVENT);
+	ievent &= ~FEC_IEVENT_MII;
+	writel(ievent, fec->regs + FEC_IEVENT);
+
+	if (ievent & FEC_IEVENT_BABT) {
+		/* BABT, Rx/Tx FIFO errors */
+		fec_halt(dev);
+		fec_init(dev);
+		dev_err(&dev->dev, "some error: 0x%08x\n", ievent);
+		return;
+	}
+	if (!fec_is_imx28(fec)) {
+		if (ievent & FEC_IEVENT_HBERR) {
+			/* Heartbeat error */
+			writel(readl(fec->regs + FEC_X_CNTRL) | 0x1,
+					fec->regs + FEC_X_CNTRL);
+		}
+	}
+	if (ievent & FEC_IEVENT_GRA) {
+		/* Graceful stop complete */
+		if (readl(fec->regs + FEC_X_CNTRL) & 0x00000001) {
+			fec_halt(dev);
+			writel(readl(fec->regs + FEC_X_CNTRL) & ~0x00000001,
+					fec->regs + FEC_X_CNTRL);
+			fec_init(dev);
+		}
+	}
+
+	/* handle all frames received since the last poll */
+	for (i = 0; i < FEC_RBD_NUM; i++)
+		if (fec_recv_one(dev))
+			break;
+}
+
+static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
+{
+	int i, ret;
+
+	/* receive buffers come from the packet pool */
+	BUILD_BUG_ON(FEC_MAX_PKT_SIZE > PKTSIZE);
 
-	p = dma_alloc(size * count);
-	if (!p)
-		return -ENOMEM;
+	ret = net_alloc_rx_packets((void **)fec->rx_buf, count);
+	if (ret)
+		return ret;
 
 	for (i = 0; i < count; i++) {
 		dma_addr_t dma;
@@ -632,12 +671,12 @@ static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
 		 * region of memory we are going to use as receive
 		 * buffers as well as check that DMA mapping is valid
 		 */
-		dma = dma_map_single(fec->dev, p, size, DMA_FROM_DEVICE);
+		dma = dma_map_single(fec->dev, fec->rx_buf[i], size,
+				     DMA_FROM_DEVICE);
 		if (dma_mapping_error(fec->dev, dma))
 			return -EFAULT;
 
 		writel(dma, &fec->rbd_base[i].data_pointer);
-		p += size;
 	}
 
 	return 0;
@@ -645,8 +684,13 @@ static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
 
 static void fec_free_receive_packets(struct fec_priv *fec, int count, int size)
 {
-	void *p = phys_to_virt(fec->rbd_base[0].data_pointer);
-	dma_free(p);
+	int i;
+
+	for (i = 0; i < count; i++)
+		dma_unmap_single(fec->dev, readl(&fec->rbd_base[i].data_pointer),
+				 size, DMA_FROM_DEVICE);
+
+	net_free_packets((void **)fec->rx_buf, count);
 }
 
 #ifdef CONFIG_OFDEVICE
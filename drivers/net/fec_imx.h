@@ -134,6 +134,14 @@ enum fec_opt_clock {
 	FEC_OPT_CLK_NUM
 };
 
+/**
+ * @brief Numbers of buffer descriptors for receiving
+ *
+ * The number defines the stocked memory buffers for the receiving task.
+ * Larger values makes no sense in this limited environment.
+ */
+#define FEC_RBD_NUM		64
+
 /**
  * @brief i.MX27-FEC private structure
  */
@@ -143,6 +151,7 @@ struct fec_priv {
 	void __iomem *regs;
 	struct buffer_descriptor __iomem *rbd_base;	/* RBD ring                  */
 	int rbd_index;				/* next receive BD to read   */
+	char *rx_buf[FEC_RBD_NUM];		/* packets in the RBD ring   */
 	struct buffer_descriptor __iomem *tbd_base;	/* TBD ring                  */
 	int tbd_index;				/* next transmit BD to write */
 	int phy_addr;
@@ -171,14 +180,6 @@ static inline int fec_is_imx6(struct fec_priv *priv)
 	return priv->type == FEC_TYPE_IMX6;
 }
 
-/**
- * @brief Numbers of buffer descriptors for receiving
- *
- * The number defines the stocked memory buffers for the receiving task.
- * Larger values makes no sense in this limited environment.
- */
-#define FEC_RBD_NUM		64
-
 /**
  * @brief Define the ethernet packet size limit in memory
  *
@@ -683,7 +683,7 @@ static int gfar_probe(struct device *dev)
 	return eth_register(edev);
 
 free_received_packets:
-	free(priv->rx_buffer);
+	net_free_packets(priv->rx_buffer, ARRAY_SIZE(priv->rx_buffer));
 free_priv:
 	free(priv);
 
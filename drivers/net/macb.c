@@ -44,7 +44,7 @@
 
 #define MACB_RX_BUFFER_SIZE	128
 #define RX_BUFFER_MULTIPLE	64  /* bytes */
-#define RX_NB_PACKET		10
+#define RX_NB_PACKET		32
 #define TX_RING_SIZE		2 /* must be power of 2 */
 #define GEM_Q1_DESCS		2
 
@@ -172,6 +172,21 @@ static void reclaim_rx_buffers(struct macb_device *macb,
 	macb->rx_tail = new_tail;
 }
 
+/*
+ * The controller only flags that it had to drop frames because no buffer was
+ * free or the DMA could not keep up, so count the polls which saw that.
+ */
+static void macb_count_rx_drops(struct eth_device *edev)
+{
+	struct macb_device *macb = edev->priv;
+	u32 rsr = macb_readl(macb, RSR) & (MACB_BIT(BNA) | MACB_BIT(OVR));
+
+	if (rsr) {
+		edev->rx_dropped++;
+		macb_writel(macb, RSR, rsr);
+	}
+}
+
 static void gem_recv(struct eth_device *edev)
 {
 	struct macb_device *macb = edev->priv;
@@ -179,6 +194,8 @@ static void gem_recv(struct eth_device *edev)
 	int length;
 	u32 status;
 
+	macb_count_rx_drops(edev);
+
 	for (;;) {
 		if (!(readl(&macb->rx_ring[macb->rx_tail].addr) & MACB_BIT(RX_USED)))
 			return;
@@ -208,6 +225,8 @@ static void macb_recv(struct eth_device *edev)
 	int wrapped = 0;
 	u32 status;
 
+	macb_count_rx_drops(edev);
+
 	for (;;) {
 		if (!(readl(&macb->rx_ring[rx_tail].addr) & MACB_BIT(RX_USED)))
 			return;
@@ -31,7 +31,7 @@ struct virtio_net_priv {
 		};
 	};
 
-	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
+	char *rx_buff[VIRTIO_NET_NUM_RX_BUFS];
 	bool rx_running;
 	int net_hdr_len;
 	struct eth_device edev;
@@ -53,6 +53,11 @@ static int virtio_net_start(struct eth_device *edev)
 
 		/* setup the receive buffer address */
 		for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++) {
+			if (!priv->rx_buff[i])
+				priv->rx_buff[i] = net_alloc_rx_packet();
+			if (!priv->rx_buff[i])
+				return -ENOMEM;
+
 			/* receive buffer length is always 1526 */
 			sg.length = VIRTIO_NET_RX_BUF_SIZE;
 
@@ -102,22 +107,31 @@ static void virtio_net_recv(struct eth_device *edev)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
 	struct scatterlist sg;
-	unsigned int len;
-	void *buf, *addr;
+	unsigned int len, received = 0;
+	char *buf, *addr, *fresh;
+	int i;
 
-	addr = virtqueue_get_buf(priv->rx_vq, &len);
-	if (!addr)
-		return;
+	while ((addr = virtqueue_get_buf(priv->rx_vq, &len))) {
+		buf = addr + priv->net_hdr_len;
+		len -= priv->net_hdr_len;
 
-	sg_init_one(&sg, addr, VIRTIO_NET_RX_BUF_SIZE);
+		net_receive(edev, buf, len);
+		received++;
 
-	buf = sg.address + priv->net_hdr_len;
-	len -= priv->net_hdr_len;
+		/* Put the buffer back to the rx ring, unless it is still used */
+		fresh = net_packet_rx_recycle(addr);
+		if (fresh != addr) {
+			for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++)
+				if (priv->rx_buff[i] == addr)
+					priv->rx_buff[i] = fresh;
+		}
 
-	net_receive(edev, buf, len);
+		sg_init_one(&sg, fresh, VIRTIO_NET_RX_BUF_SIZE);
+		virtqueue_add_inbuf(priv->rx_vq, &sg, 1, fresh);
+	}
 
-	/* Put the buffer back to the rx ring */
-	virtqueue_add_inbuf(priv->rx_vq, &sg, 1, addr);
+	if (received)
+		virtqueue_kick(priv->rx_vq);
 }
 
 static void virtio_net_stop(struct eth_device *dev)
@@ -215,6 +229,7 @@ static void virtio_net_remove(struct virtio_device *vdev)
 	vdev->config->reset(vdev);
 	eth_unregister(&priv->edev);
 	vdev->config->del_vqs(vdev);
+	net_free_packets((void **)priv->rx_buff, VIRTIO_NET_NUM_RX_BUFS);
 
 	free(priv);
 }
@@ -306,78 +306,28 @@ static void nvme_setup_flush(struct nvme_ns *ns, struct nvme_command *cmnd)
 	cmnd->common.nsid = cpu_to_le32(ns->head->ns_id);
 }
 
-static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
-			       void *buffer, sector_t block, blkcnt_t num_blocks)
-{
-	/*
-	 * ns->ctrl->max_hw_sectors is in units of 512 bytes, so we
-	 * need to make sure we adjust it to discovered lba_shift
-	 */
-	const u32 max_hw_sectors =
-		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
-	int ret;
-
-	if (num_blocks > max_hw_sectors) {
-		while (num_blocks) {
-			const u32 chunk = min_t(blkcnt_t, num_blocks,
-						max_hw_sectors);
-
-			ret = nvme_submit_sync_rw(ns, cmnd, buffer, block,
-						  chunk);
-			if (ret)
-				break;
-
-			num_blocks -= chunk;
-			buffer += chunk;
-			block += chunk;
-		}
-
-		return ret;
-	}
-
-	nvme_setup_rw(ns, cmnd, block, num_blocks);
-
-	ret = __nvme_submit_sync_cmd(ns->ctrl, cmnd, NULL, buffer,
-				     num_blocks << ns->lba_shift,
-				     0, NVME_QID_IO);
-
-	if (ret) {
-		dev_err(ns->ctrl->dev,
-			"I/O failed: block: %llu, num blocks: %llu, status code type: %xh, status code %02xh\n",
-			block, num_blocks, (ret >> 8) & 0xf,
-			ret & 0xff);
-		return -EIO;
-	}
-
-	return 0;
-}
-
-
-static int nvme_block_device_read(struct block_device *blk, void *buffer,
-				  sector_t block, blkcnt_t num_blocks)
+static int nvme_block_device_submit(struct block_device *blk,
+				    struct blk_request *req)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
 	struct nvme_command cmnd = { };
 
-	cmnd.rw.opcode = nvme_cmd_read;
+	if (req->write && ns->readonly)
+		return -EINVAL;
+
+	cmnd.rw.opcode = req->write ? nvme_cmd_write : nvme_cmd_read;
+	nvme_setup_rw(ns, &cmnd, req->block, req->num_blocks);
 
-	return nvme_submit_sync_rw(ns, &cmnd, buffer, block, num_blocks);
+	return ns->ctrl->ops->submit_async_cmd(ns->ctrl, &cmnd, req->buf,
+					       req->num_blocks << ns->lba_shift,
+					       req);
 }
 
-static int __maybe_unused
-nvme_block_device_write(struct block_device *blk, const void *buffer,
-			sector_t block, blkcnt_t num_blocks)
+static int nvme_block_device_poll(struct block_device *blk)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
-	struct nvme_command cmnd = { };
-
-	if (ns->readonly)
-		return -EINVAL;
 
-	cmnd.rw.opcode = nvme_cmd_write;
-
-	return nvme_submit_sync_rw(ns, &cmnd, (void *)buffer, block,
-				   num_blocks);
+	return ns->ctrl->ops->poll(ns->ctrl);
 }
 
 static int __maybe_unused nvme_block_device_flush(struct block_device *blk)
@@ -406,9 +356,9 @@ nvme_block_device_erase(struct block_device *blk, sector_t block,
 }
 
 static struct block_device_ops nvme_block_device_ops = {
-	.read = nvme_block_device_read,
+	.submit = nvme_block_device_submit,
+	.poll = nvme_block_device_poll,
 #ifdef CONFIG_BLOCK_WRITE
-	.write = nvme_block_device_write,
 	.flush = nvme_block_device_flush,
 	.erase = nvme_block_device_erase,
 #endif
@@ -449,6 +399,13 @@ static void nvme_alloc_ns(struct nvme_ctrl *ctrl, unsigned nsid)
 	__nvme_revalidate_disk(&ns->blk, id);
 	kfree(id);
 
+	/*
+	 * ctrl->max_hw_sectors is in units of 512 bytes, so we need
+	 * to adjust it to the discovered lba_shift
+	 */
+	ns->blk.queue_depth = ctrl->io_queue_depth;
+	ns->blk.max_request_blocks = ctrl->max_hw_sectors >> (ns->lba_shift - 9);
+
 	ret = blockdevice_register(&ns->blk);
 	if (ret) {
 		dev_err(ctrl->dev, "Cannot register block device (%d)\n", ret);
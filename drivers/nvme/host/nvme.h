@@ -12,6 +12,7 @@
 
 #define ADMIN_TIMEOUT		(60 * HZ)
 #define SHUTDOWN_TIMEOUT	( 5 * HZ)
+#define NVME_IO_TIMEOUT		(30 * HZ)
 
 /*
  * Common request structure for NVMe passthrough.  All drivers must have
@@ -26,6 +27,12 @@ struct nvme_request {
 	unsigned int buffer_len;
 	dma_addr_t buffer_dma_addr;
 	enum dma_data_direction dma_dir;
+
+	bool busy;			/* command id in use */
+	struct blk_request *blk_req;	/* NULL for synchronous commands */
+	__le64 *prp_list;
+	dma_addr_t prp_dma;
+	unsigned int prp_list_size;
 };
 
 struct nvme_ctrl {
@@ -39,6 +46,7 @@ struct nvme_ctrl {
 	u32 page_size;
 	u32 max_hw_sectors;
 	u32 vs;
+	unsigned int io_queue_depth;	/* commands in flight on the I/O queue */
 };
 
 /*
@@ -78,6 +86,12 @@ struct nvme_ctrl_ops {
 			       void *buffer,
 			       unsigned bufflen,
 			       unsigned timeout, int qid);
+	/* queue a command on the I/O queue, -EBUSY if it's full */
+	int (*submit_async_cmd)(struct nvme_ctrl *ctrl,
+				struct nvme_command *cmd,
+				void *buffer, unsigned bufflen,
+				struct blk_request *req);
+	int (*poll)(struct nvme_ctrl *ctrl);
 };
 
 static inline bool nvme_ctrl_ready(struct nvme_ctrl *ctrl)
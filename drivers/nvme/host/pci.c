@@ -15,7 +15,7 @@
 
 #define NVME_MAX_KB_SZ	4096
 
-static int io_queue_depth = 2;
+static int io_queue_depth = 32;
 
 struct nvme_dev;
 
@@ -25,7 +25,8 @@ struct nvme_dev;
  */
 struct nvme_queue {
 	struct nvme_dev *dev;
-	struct nvme_request *req;
+	struct nvme_request *reqs;	/* indexed by command id */
+	unsigned int inflight;
 	struct nvme_command *sq_cmds;
 	volatile struct nvme_completion *cqes;
 	dma_addr_t sq_dma_addr;
@@ -53,10 +54,8 @@ struct nvme_dev {
 	u32 db_stride;
 	void __iomem *bar;
 	bool subsystem;
+	bool resetting;
 	struct nvme_ctrl ctrl;
-	__le64 *prp_pool;
-	unsigned int prp_pool_size;
-	dma_addr_t prp_dma;
 };
 
 static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
@@ -65,7 +64,7 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 }
 
 static int nvme_pci_setup_prps(struct nvme_dev *dev,
-			       const struct nvme_request *req,
+			       struct nvme_request *req,
 			       struct nvme_rw_command *cmnd)
 {
 	int length = req->buffer_len;
@@ -91,19 +90,20 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 		goto done;
 	}
 
+	/* every command id has a PRP list of its own */
 	nprps = DIV_ROUND_UP(length, page_size);
-	if (nprps > dev->prp_pool_size) {
+	if (nprps > req->prp_list_size) {
 		dma_free_coherent(DMA_DEVICE_BROKEN,
-				  dev->prp_pool, dev->prp_dma,
-				  dev->prp_pool_size * sizeof(u64));
-		dev->prp_pool_size = nprps;
-		dev->prp_pool = dma_alloc_coherent(DMA_DEVICE_BROKEN,
+				  req->prp_list, req->prp_dma,
+				  req->prp_list_size * sizeof(u64));
+		req->prp_list_size = nprps;
+		req->prp_list = dma_alloc_coherent(DMA_DEVICE_BROKEN,
 						   nprps * sizeof(u64),
-						   &dev->prp_dma);
+						   &req->prp_dma);
 	}
 
-	prp_list = dev->prp_pool;
-	prp_dma  = dev->prp_dma;
+	prp_list = req->prp_list;
+	prp_dma  = req->prp_dma;
 
 	i = 0;
 	for (;;) {
@@ -171,6 +171,8 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (!nvmeq->sq_cmds)
 		goto free_cqdma;
 
+	nvmeq->reqs = xzalloc(depth * sizeof(*nvmeq->reqs));
+
 	nvmeq->dev = dev;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -315,28 +317,41 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
-	struct nvme_request *req = nvmeq->req;
+	struct nvme_dev *dev = nvmeq->dev;
+	struct blk_request *blk_req;
+	struct nvme_request *req;
 
 	if (unlikely(cqe->command_id >= nvmeq->q_depth)) {
-		dev_warn(nvmeq->dev->ctrl.dev,
+		dev_warn(dev->ctrl.dev,
 			"invalid id %d completed on queue %d\n",
 			cqe->command_id, le16_to_cpu(cqe->sq_id));
 		return;
 	}
 
-	if (WARN_ON(cqe->command_id != req->cmd->common.command_id))
+	req = &nvmeq->reqs[cqe->command_id];
+	if (WARN_ON(!req->busy))
 		return;
 
 	nvme_end_request(req, cqe->status, cqe->result);
-}
+	nvme_unmap_data(dev, req);
 
-static void nvme_complete_cqes(struct nvme_queue *nvmeq, u16 start, u16 end)
-{
-	while (start != end) {
-		nvme_handle_cqe(nvmeq, start);
-		if (++start == nvmeq->q_depth)
-			start = 0;
-	}
+	req->busy = false;
+	nvmeq->inflight--;
+
+	/* Synchronous submitters pick up the result themselves */
+	blk_req = req->blk_req;
+	if (!blk_req)
+		return;
+
+	req->blk_req = NULL;
+
+	if (req->status)
+		dev_err(dev->ctrl.dev,
+			"I/O failed: block: %llu, num blocks: %llu, status code type: %xh, status code %02xh\n",
+			blk_req->block, blk_req->num_blocks,
+			(req->status >> 8) & 0xf, req->status & 0xff);
+
+	blk_request_complete(blk_req, req->status ? -EIO : 0);
 }
 
 static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
@@ -347,38 +362,89 @@ static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
 	}
 }
 
-static inline bool nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
-		u16 *end, int tag)
+/* Handle all pending completions, returns how many there were */
+static int nvme_poll(struct nvme_queue *nvmeq)
 {
-	bool found = false;
+	int done = 0;
+
+	while (nvme_cqe_pending(nvmeq)) {
+		u16 idx = nvmeq->cq_head;
 
-	*start = nvmeq->cq_head;
-	while (!found && nvme_cqe_pending(nvmeq)) {
-		if (nvmeq->cqes[nvmeq->cq_head].command_id == tag)
-			found = true;
 		nvme_update_cq_head(nvmeq);
+		nvme_handle_cqe(nvmeq, idx);
+		done++;
 	}
-	*end = nvmeq->cq_head;
 
-	if (*start != *end)
+	if (done)
 		nvme_ring_cq_doorbell(nvmeq);
-	return found;
+
+	return done;
+}
+
+/*
+ * Allocate a free command id. One submission queue entry has to stay
+ * empty, so at most q_depth - 1 commands can be in flight.
+ */
+static struct nvme_request *nvme_alloc_request(struct nvme_queue *nvmeq)
+{
+	unsigned int i;
+
+	if (nvmeq->inflight >= nvmeq->q_depth - 1)
+		return NULL;
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		struct nvme_request *req;
+
+		req = &nvmeq->reqs[nvmeq->counter++ % nvmeq->q_depth];
+		if (req->busy)
+			continue;
+
+		req->busy = true;
+		nvmeq->inflight++;
+
+		return req;
+	}
+
+	return NULL;
 }
 
-static bool nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
+static int nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_request *req,
+			  struct nvme_command *cmd, void *buffer,
+			  unsigned int buffer_len,
+			  enum dma_data_direction dma_dir,
+			  struct blk_request *blk_req)
 {
-	u16 start, end;
-	bool found;
+	struct nvme_dev *dev = nvmeq->dev;
+	int ret;
 
-	if (!nvme_cqe_pending(nvmeq))
-		return false;
+	cmd->common.command_id = req - nvmeq->reqs;
 
-	found = nvme_process_cq(nvmeq, &start, &end, tag);
+	req->cmd        = cmd;
+	req->buffer     = buffer;
+	req->buffer_len = buffer_len;
+	req->dma_dir    = dma_dir;
+	req->status     = 0;
+	req->blk_req    = blk_req;
 
-	nvme_complete_cqes(nvmeq, start, end);
-	return found;
+	ret = nvme_map_data(dev, req);
+	if (ret) {
+		dev_err(dev->dev, "Failed to map request data\n");
+		req->blk_req = NULL;
+		req->busy = false;
+		nvmeq->inflight--;
+		return ret;
+	}
+
+	nvme_submit_cmd(nvmeq, cmd);
+
+	/* the command has been copied to the submission queue */
+	req->cmd = NULL;
+
+	return 0;
 }
 
+static int nvme_pci_reset(struct nvme_dev *dev);
+
 static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 				    struct nvme_command *cmd,
 				    union nvme_result *result,
@@ -388,9 +454,9 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 {
 	struct nvme_dev *dev = to_nvme_dev(ctrl);
 	struct nvme_queue *nvmeq = &dev->queues[qid];
-	struct nvme_request req = { };
-	const u16 tag = nvmeq->counter++ & (nvmeq->q_depth - 1);
+	struct nvme_request *req;
 	enum dma_data_direction dma_dir;
+	u64 start;
 	int ret;
 
 	switch (qid) {
@@ -415,6 +481,7 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	case NVME_QID_IO:
 		switch (cmd->rw.opcode) {
 		case nvme_cmd_write:
+		case nvme_cmd_flush:
 			dma_dir = DMA_TO_DEVICE;
 			break;
 		case nvme_cmd_read:
@@ -428,33 +495,84 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		return -EINVAL;
 	}
 
-	cmd->common.command_id = tag;
+	/* the controller could not be brought back after a reset */
+	if (dev->online_queues <= qid)
+		return -ENODEV;
 
 	timeout = timeout ?: ADMIN_TIMEOUT;
+	start = get_time_ns();
 
-	req.cmd        = cmd;
-	req.buffer     = buffer;
-	req.buffer_len = buffer_len;
-	req.dma_dir    = dma_dir;
+	/* asynchronous requests may occupy all command ids */
+	while (!(req = nvme_alloc_request(nvmeq))) {
+		if (is_timeout(start, timeout))
+			return -ETIMEDOUT;
+		nvme_poll(nvmeq);
+	}
 
-	ret = nvme_map_data(dev, &req);
+	ret = nvme_queue_cmd(nvmeq, req, cmd, buffer, buffer_len, dma_dir, NULL);
+	if (ret)
+		return ret;
+
+	ret = wait_on_timeout(timeout, (nvme_poll(nvmeq), !req->busy));
 	if (ret) {
-		dev_err(dev->dev, "Failed to map request data\n");
+		dev_err(ctrl->dev, "command %02xh timed out\n",
+			cmd->common.opcode);
+		nvme_pci_reset(dev);
 		return ret;
 	}
 
-	nvme_submit_cmd(nvmeq, cmd);
+	if (result)
+		*result = req->result;
 
-	nvmeq->req = &req;
-	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, tag));
-	nvmeq->req = NULL;
+	return req->status;
+}
 
-	nvme_unmap_data(dev, &req);
+static int nvme_pci_submit_async_cmd(struct nvme_ctrl *ctrl,
+				     struct nvme_command *cmd,
+				     void *buffer, unsigned int buffer_len,
+				     struct blk_request *blk_req)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[NVME_QID_IO];
+	struct nvme_request *req;
 
-	if (result)
-		*result = req.result;
+	if (dev->online_queues <= NVME_QID_IO)
+		return -ENODEV;
+
+	req = nvme_alloc_request(nvmeq);
+	if (!req)
+		return -EBUSY;
+
+	return nvme_queue_cmd(nvmeq, req, cmd, buffer, buffer_len,
+			      blk_req->write ? DMA_TO_DEVICE : DMA_FROM_DEVICE,
+			      blk_req);
+}
+
+static int nvme_pci_poll(struct nvme_ctrl *ctrl)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[NVME_QID_IO];
+	int i, done;
+
+	if (dev->online_queues <= NVME_QID_IO)
+		return 0;
+
+	done = nvme_poll(nvmeq);
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		struct nvme_request *req = &nvmeq->reqs[i];
+		struct blk_request *blk_req = req->blk_req;
+
+		if (!blk_req || !blk_request_timed_out(blk_req, NVME_IO_TIMEOUT))
+			continue;
+
+		dev_err(ctrl->dev, "I/O timeout: block: %llu, num blocks: %llu\n",
+			blk_req->block, blk_req->num_blocks);
 
-	return ret ?: req.status;
+		return done + nvme_pci_reset(dev);
+	}
+
+	return done;
 }
 
 static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
@@ -514,6 +632,9 @@ static int nvme_create_io_queues(struct nvme_dev *dev)
 			break;
 	}
 
+	if (dev->online_queues > NVME_QID_IO)
+		dev->ctrl.io_queue_depth = dev->q_depth - 1;
+
 	/*
 	 * Ignore failing Create SQ/CQ commands, we can continue with less
 	 * than the desired amount of queues, and even a controller without
@@ -559,6 +680,90 @@ static int nvme_pci_enable(struct nvme_dev *dev)
 	return 0;
 }
 
+/*
+ * Give all command ids of a stopped queue back, completing their block layer
+ * requests with an error. Returns the number of block layer requests.
+ */
+static int nvme_cancel_queue(struct nvme_queue *nvmeq)
+{
+	struct blk_request *blk_req;
+	int i, done = 0;
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		struct nvme_request *req = &nvmeq->reqs[i];
+
+		if (!req->busy)
+			continue;
+
+		nvme_unmap_data(nvmeq->dev, req);
+		req->busy = false;
+
+		blk_req = req->blk_req;
+		if (!blk_req)
+			continue;
+
+		req->blk_req = NULL;
+		blk_request_complete(blk_req, -ETIMEDOUT);
+		done++;
+	}
+
+	nvmeq->inflight = 0;
+	nvmeq->sq_tail = 0;
+	nvmeq->cq_head = 0;
+	nvmeq->cq_phase = 1;
+	memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq->q_depth));
+
+	return done;
+}
+
+/*
+ * The controller owns the data buffers of all outstanding commands. Only
+ * once it is disabled they can be given back, so a command which times out
+ * takes the whole controller down and up again.
+ */
+static int nvme_pci_reset(struct nvme_dev *dev)
+{
+	struct pci_dev *pdev = to_pci_dev(dev->dev);
+	bool nested = dev->resetting;
+	int i, ret, done = 0;
+
+	dev_err(dev->ctrl.dev, "resetting controller\n");
+
+	dev->resetting = true;
+
+	ret = nvme_disable_ctrl(&dev->ctrl, dev->ctrl.cap);
+	if (ret) {
+		/* make sure it does not access memory anymore */
+		dev_err(dev->ctrl.dev, "cannot disable controller: %pe\n",
+			ERR_PTR(ret));
+		pci_clear_master(pdev);
+	}
+
+	dev->online_queues = 0;
+
+	for (i = 0; i < dev->ctrl.queue_count; i++)
+		done += nvme_cancel_queue(&dev->queues[i]);
+
+	/* on a timeout during the reinitialization below, just stop */
+	if (nested)
+		return done;
+
+	/* a controller which cannot be disabled stays offline */
+	if (!ret) {
+		ret = nvme_pci_configure_admin_queue(dev);
+		if (!ret)
+			ret = nvme_create_io_queues(dev);
+		if (ret)
+			dev_err(dev->ctrl.dev,
+				"cannot reinitialize controller: %pe\n",
+				ERR_PTR(ret));
+	}
+
+	dev->resetting = false;
+
+	return done;
+}
+
 static void nvme_reset_work(struct nvme_dev *dev)
 {
 	int result = -ENODEV;
@@ -615,6 +820,8 @@ static const struct nvme_ctrl_ops nvme_pci_ctrl_ops = {
 	.reg_write32		= nvme_pci_reg_write32,
 	.reg_read64		= nvme_pci_reg_read64,
 	.submit_sync_cmd	= nvme_pci_submit_sync_cmd,
+	.submit_async_cmd	= nvme_pci_submit_async_cmd,
+	.poll			= nvme_pci_poll,
 };
 
 static void nvme_dev_map(struct nvme_dev *dev)
@@ -650,11 +857,9 @@ static void nvme_disable_io_queues(struct nvme_dev *dev)
 static void nvme_disable_admin_queue(struct nvme_dev *dev)
 {
 	struct nvme_queue *nvmeq = &dev->queues[0];
-	u16 start, end;
 
 	nvme_shutdown_ctrl(&dev->ctrl);
-	nvme_process_cq(nvmeq, &start, &end, -1);
-	nvme_complete_cqes(nvmeq, start, end);
+	nvme_poll(nvmeq);
 }
 
 static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
@@ -16,6 +16,7 @@
 #include <memory.h>
 #include <bootsource.h>
 #include <linux/sizes.h>
+#include <linux/hash.h>
 #include <of_graph.h>
 #include <string.h>
 #include <libfile.h>
@@ -428,6 +429,48 @@ struct device_node *of_find_node_by_alias(struct device_node *root, const char *
 }
 EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 
+/*
+ * Resolving phandles is done thousands of times during probe, each time
+ * walking the whole tree. Remember the nodes found in a small direct mapped
+ * cache. An entry is only used when the node still has the phandle and is
+ * still part of the tree searched in. Deleted nodes are removed from the
+ * cache, code changing the phandle of a node in a tree must call
+ * of_phandle_cache_invalidate().
+ */
+#define OF_PHANDLE_CACHE_BITS	8
+
+static struct device_node *of_phandle_cache[1 << OF_PHANDLE_CACHE_BITS];
+
+static inline struct device_node **of_phandle_cache_slot(phandle phandle)
+{
+	return &of_phandle_cache[hash_32(phandle, OF_PHANDLE_CACHE_BITS)];
+}
+
+/**
+ * of_phandle_cache_invalidate - drop all cached phandle lookups
+ */
+void of_phandle_cache_invalidate(void)
+{
+	memset(of_phandle_cache, 0, sizeof(of_phandle_cache));
+}
+EXPORT_SYMBOL(of_phandle_cache_invalidate);
+
+static void of_phandle_cache_remove(struct device_node *node)
+{
+	struct device_node **slot = of_phandle_cache_slot(node->phandle);
+
+	if (*slot == node)
+		*slot = NULL;
+}
+
+static struct device_node *of_node_get_root(struct device_node *node)
+{
+	while (node->parent)
+		node = node->parent;
+
+	return node;
+}
+
 /*
  * of_find_node_by_phandle_from - Find a node given a phandle from given
  * root node.
@@ -438,11 +481,27 @@ EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 struct device_node *of_find_node_by_phandle_from(phandle phandle,
 		struct device_node *root)
 {
-	struct device_node *node;
+	struct device_node *node, **slot = NULL;
+
+	/*
+	 * Only whole trees are cached, a walk starting at another node
+	 * doesn't cover all of it.
+	 */
+	if (phandle && (!root || !root->parent)) {
+		slot = of_phandle_cache_slot(phandle);
+		node = *slot;
+		if (node && node->phandle == phandle && node != root &&
+		    of_node_get_root(node) == (root ?: root_node))
+			return node;
+	}
 
-	of_tree_for_each_node_from(node, root)
-		if (node->phandle == phandle)
+	of_tree_for_each_node_from(node, root) {
+		if (node->phandle == phandle) {
+			if (slot)
+				*slot = node;
 			return node;
+		}
+	}
 
 	return NULL;
 }
@@ -2082,6 +2141,8 @@ int of_set_root_node(struct device_node *node)
 
 	root_node = node;
 
+	of_phandle_cache_invalidate();
+
 	of_chosen = of_find_node_by_path("/chosen");
 	of_property_read_string(root_node, "model", &of_model);
 
@@ -3087,6 +3148,8 @@ void of_delete_node(struct device_node *node)
 	list_for_each_entry_safe(n, nt, &node->children, parent_list)
 		of_delete_node(n);
 
+	of_phandle_cache_remove(node);
+
 	if (node->parent) {
 		list_del(&node->parent_list);
 		list_del(&node->list);
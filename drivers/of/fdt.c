@@ -380,12 +380,23 @@ static int fuzz_dtb(const u8 *data, size_t size)
 }
 fuzz_test("dtb", fuzz_dtb);
 
+/*
+ * Property names repeat a lot ("compatible", "reg", "status", ...), they are
+ * stored only once in the strings block. dt_add_string() looks them up in a
+ * hash table with open addressing, which also records their offset.
+ */
+struct fdt_string {
+	const char *str;
+	uint32_t ofs;
+};
+
 struct fdt {
 	void *dt;
 	uint32_t dt_nextofs;
 	uint32_t dt_size;
-	char *strings;
-	uint32_t str_nextofs;
+	struct fdt_string *strtab;
+	unsigned int strtab_bits;
+	unsigned int num_strings;
 	uint32_t str_size;
 };
 
@@ -394,126 +405,123 @@ static inline uint32_t dt_next_ofs(uint32_t curofs, uint32_t len)
 	return ALIGN(curofs + len, 4);
 }
 
-static int lstrcpy(char *dest, const char *src)
+static uint32_t dt_string_hash(const char *str)
 {
-	int len = 0;
-	int maxlen = 1023;
-
-	do {
-		*dest++ = *src;
-		len++;
-		if (!maxlen)
-			return -ENOSPC;
-		maxlen--;
-	} while (*src++);
-
-	return len - 1;
+	uint32_t hash = 2166136261;	/* FNV-1a */
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619;
+	}
+
+	return hash;
 }
 
-static void *memalign_realloc(void *orig, size_t oldsize, size_t newsize)
+static struct fdt_string *dt_string_slot(struct fdt *fdt, const char *str)
 {
-	int align;
-	void *newbuf;
+	uint32_t mask = (1 << fdt->strtab_bits) - 1;
+	uint32_t i = dt_string_hash(str) & mask;
 
-	if (newsize > MALLOC_MAX_SIZE)
-		return NULL;
+	while (fdt->strtab[i].str && strcmp(fdt->strtab[i].str, str))
+		i = (i + 1) & mask;
 
-	/*
-	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
-	 * for mapping the devicetree, so we are not allowed to cross
-	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
-	 */
-	align = 1 << fls(newsize - 1);
+	return &fdt->strtab[i];
+}
 
-	if (!orig)
-		return memalign(align, newsize);
+static int dt_strtab_grow(struct fdt *fdt)
+{
+	struct fdt_string *old = fdt->strtab;
+	unsigned int i, oldsize = old ? 1 << fdt->strtab_bits : 0;
 
-	newbuf = memalign(align, newsize);
-	if (!newbuf)
-		return NULL;
+	fdt->strtab_bits = old ? fdt->strtab_bits + 1 : 8;
+	fdt->strtab = calloc(1 << fdt->strtab_bits, sizeof(*fdt->strtab));
+	if (!fdt->strtab) {
+		fdt->strtab = old;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < oldsize; i++)
+		if (old[i].str)
+			*dt_string_slot(fdt, old[i].str) = old[i];
 
-	memcpy(newbuf, orig, oldsize);
-	free(orig);
-	memset(newbuf + oldsize, 0, newsize - oldsize);
+	free(old);
 
-	return newbuf;
+	return 0;
 }
 
-static int fdt_ensure_space(struct fdt *fdt, int dtsize)
+static int dt_add_string(struct fdt *fdt, const char *str)
 {
-	size_t new_size;
-	void *previous;
-
-	/*
-	 * We assume strings and names have a maximum length of 1024
-	 * whereas properties can be longer. We allocate new memory
-	 * if we have less than 1024 bytes (+ the property size left.
-	 */
-	if (fdt->str_size - fdt->str_nextofs < 1024) {
-		previous = fdt->strings;
-		new_size = fdt->str_size * 2;
-
-		fdt->strings = realloc(previous, new_size);
-		if (!fdt->strings) {
-			free(previous);
-			return -ENOMEM;
-		}
+	struct fdt_string *s;
+	int ret;
 
-		fdt->str_size = new_size;
+	/* keep the table at most half full */
+	if (!fdt->strtab || 2 * (fdt->num_strings + 1) > 1 << fdt->strtab_bits) {
+		ret = dt_strtab_grow(fdt);
+		if (ret)
+			return ret;
 	}
 
-	if (fdt->dt_size - fdt->dt_nextofs < 1024 + dtsize) {
-		previous = fdt->dt;
-		new_size = fdt->dt_size * 2;
-
-		if (new_size <= dtsize)
-			new_size = roundup_pow_of_two(fdt->dt_size + dtsize);
-
-		fdt->dt = memalign_realloc(previous, fdt->dt_size, new_size);
-		if (!fdt->dt) {
-			free(previous);
-			return -ENOMEM;
-		}
-
-		fdt->dt_size = new_size;
+	s = dt_string_slot(fdt, str);
+	if (!s->str) {
+		s->str = str;
+		s->ofs = fdt->str_size;
+		fdt->str_size += strlen(str) + 1;
+		fdt->num_strings++;
 	}
 
 	return 0;
 }
 
-static inline int dt_add_string(struct fdt *fdt, const char *str)
+/*
+ * First pass: calculate the size of the structure block and collect the
+ * strings, so that the dtb can be allocated at once.
+ */
+static int of_flatten_dtb_size(struct fdt *fdt, struct device_node *node)
 {
-	uint32_t ret;
-	int len;
+	struct property *p;
+	struct device_node *n;
+	int ret;
 
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
+	fdt->dt_size = dt_next_ofs(fdt->dt_size, 4 + strlen(node->name) + 1);
 
-	len = lstrcpy(fdt->strings + fdt->str_nextofs, str);
-	if (len < 0)
-		return -ENOSPC;
+	list_for_each_entry(p, &node->properties, list) {
+		if (is_reserved_name(p->name))
+			continue;
 
-	ret = fdt->str_nextofs;
+		ret = dt_add_string(fdt, p->name);
+		if (ret)
+			return ret;
+
+		fdt->dt_size = dt_next_ofs(fdt->dt_size,
+				sizeof(struct fdt_property) + p->length);
+	}
+
+	list_for_each_entry(n, &node->children, parent_list) {
+		if (is_reserved_name(n->name))
+			continue;
+
+		ret = of_flatten_dtb_size(fdt, n);
+		if (ret)
+			return ret;
+	}
 
-	fdt->str_nextofs += len + 1;
+	fdt->dt_size = dt_next_ofs(fdt->dt_size,
+			sizeof(struct fdt_node_header));
 
-	return ret;
+	return 0;
 }
 
-static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
+static void __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 {
 	struct property *p;
 	struct device_node *n;
-	int ret;
 	unsigned int len;
 	struct fdt_node_header *nh;
 
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
-
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_BEGIN_NODE);
-	len = lstrcpy(nh->name, node->name);
+	len = strlen(node->name);
+	memcpy(nh->name, node->name, len + 1);
 	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs, 4 + len + 1);
 
 	list_for_each_entry(p, &node->properties, list) {
@@ -522,14 +530,11 @@ static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 		if (is_reserved_name(p->name))
 			continue;
 
-		if (fdt_ensure_space(fdt, p->length) < 0)
-			return -ENOMEM;
-
 		fp = fdt->dt + fdt->dt_nextofs;
 
 		fp->tag = cpu_to_fdt32(FDT_PROP);
 		fp->len = cpu_to_fdt32(p->length);
-		fp->nameoff = cpu_to_fdt32(dt_add_string(fdt, p->name));
+		fp->nameoff = cpu_to_fdt32(dt_string_slot(fdt, p->name)->ofs);
 		memcpy(fp->data, p->value, p->length);
 		fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
 				sizeof(struct fdt_property) + p->length);
@@ -539,20 +544,13 @@ static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 		if (is_reserved_name(n->name))
 			continue;
 
-		ret = __of_flatten_dtb(fdt, n);
-		if (ret)
-			return ret;
+		__of_flatten_dtb(fdt, n);
 	}
 
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_END_NODE);
 	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
 			sizeof(struct fdt_node_header));
-
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
-
-	return 0;
 }
 
 /**
@@ -564,35 +562,50 @@ void *of_flatten_dtb(struct device_node *node)
 	int ret;
 	struct fdt_header header = {};
 	struct fdt fdt = {};
-	uint32_t ofs, off_mem_rsvmap;
+	uint32_t ofs, off_mem_rsvmap, totalsize;
 	struct fdt_node_header *nh;
 	struct device_node *memreserve;
+	unsigned int i;
 	int len;
 
 	header.magic = cpu_to_fdt32(FDT_MAGIC);
 	header.version = cpu_to_fdt32(0x11);
 	header.last_comp_version = cpu_to_fdt32(0x10);
 
-	fdt.dt = xmemalign(SZ_64K, SZ_64K);
-	fdt.dt_size = SZ_64K;
-
-	fdt.strings = xzalloc(SZ_64K);
-	fdt.str_size = SZ_64K;
-
-	memset(fdt.dt, 0, SZ_64K);
-
 	ofs = sizeof(struct fdt_header);
 
 	off_mem_rsvmap = ofs;
 	header.off_mem_rsvmap = cpu_to_fdt32(off_mem_rsvmap);
 	ofs += sizeof(struct fdt_reserve_entry) * OF_MAX_RESERVE_MAP;
 
-	fdt.dt_nextofs = ofs;
+	fdt.dt_size = ofs;
 
-	ret = __of_flatten_dtb(&fdt, node);
+	ret = of_flatten_dtb_size(&fdt, node);
 	if (ret)
 		goto out_free;
 
+	/* FDT_END */
+	fdt.dt_size += sizeof(struct fdt_node_header);
+
+	totalsize = fdt.dt_size + fdt.str_size;
+	if (totalsize > MALLOC_MAX_SIZE)
+		goto out_free;
+
+	/*
+	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
+	 * for mapping the devicetree, so we are not allowed to cross
+	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
+	 */
+	fdt.dt = memalign(1 << fls(totalsize - 1), totalsize);
+	if (!fdt.dt)
+		goto out_free;
+
+	memset(fdt.dt, 0, totalsize);
+
+	fdt.dt_nextofs = ofs;
+
+	__of_flatten_dtb(&fdt, node);
+
 	memreserve = of_find_node_by_name_address(node, "$memreserve");
 	if (memreserve) {
 		const void *entries = of_get_property(memreserve, "reg", &len);
@@ -609,31 +622,25 @@ void *of_flatten_dtb(struct device_node *node)
 	header.size_dt_struct = cpu_to_fdt32(fdt.dt_nextofs - ofs);
 
 	header.off_dt_strings = cpu_to_fdt32(fdt.dt_nextofs);
-	header.size_dt_strings = cpu_to_fdt32(fdt.str_nextofs);
+	header.size_dt_strings = cpu_to_fdt32(fdt.str_size);
 
-	if (fdt.dt_size - fdt.dt_nextofs < fdt.str_nextofs) {
-		void *newmem;
+	for (i = 0; fdt.strtab && i < 1 << fdt.strtab_bits; i++) {
+		struct fdt_string *s = &fdt.strtab[i];
 
-		newmem = memalign_realloc(fdt.dt, fdt.dt_size,
-				fdt.dt_nextofs + fdt.str_nextofs);
-		if (!newmem)
-			goto out_free;
-		fdt.dt = newmem;
+		if (s->str)
+			strcpy(fdt.dt + fdt.dt_nextofs + s->ofs, s->str);
 	}
 
-	memcpy(fdt.dt + fdt.dt_nextofs, fdt.strings, fdt.str_nextofs);
-
-	header.totalsize = cpu_to_fdt32(fdt.dt_nextofs + fdt.str_nextofs);
+	header.totalsize = cpu_to_fdt32(totalsize);
 
 	memcpy(fdt.dt, &header, sizeof(header));
 
-	free(fdt.strings);
+	free(fdt.strtab);
 
 	return fdt.dt;
 
 out_free:
-	free(fdt.strings);
-	free(fdt.dt);
+	free(fdt.strtab);
 
 	return NULL;
 }
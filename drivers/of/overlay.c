@@ -210,6 +210,9 @@ int of_overlay_apply_tree(struct device_node *root,
 			pr_warn("failed to apply %s\n", fragment->name);
 	}
 
+	/* Fragments may have changed phandles of existing nodes */
+	of_phandle_cache_invalidate();
+
 	/* We are patching the live tree, reload aliases */
 	if (root == of_get_root_node())
 		of_alias_scan();
@@ -141,6 +141,8 @@ static int ext4fs_get_indir_block(struct ext2fs_node *node,
 	if (indir->blkno == blkno)
 		return 0;
 
+	indir->blkno = 0;
+
 	ret = ext4fs_devread(fs, blkno, 0, blksz, (void *)indir->data);
 	if (ret) {
 		dev_err(fs->dev, "** SI ext2fs read block (indir 1)"
@@ -148,10 +150,12 @@ static int ext4fs_get_indir_block(struct ext2fs_node *node,
 		return ret;
 	}
 
+	indir->blkno = blkno;
+
 	return 0;
 }
 
-long int read_allocated_block(struct ext2fs_node *node, int fileblock)
+static long int ext4fs_map_indirect(struct ext2fs_node *node, uint32_t fileblock)
 {
 	long int blknr;
 	int blksz;
@@ -159,7 +163,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
 	int ret;
@@ -168,50 +171,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	blksz = EXT2_BLOCK_SIZE(node->data);
 	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (!buf)
-			return -ENOMEM;
-
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
-			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-			}
-
-			if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		free(buf);
-		return 0;
-	}
-
 	if (fileblock < INDIRECT_BLOCKS) {
 		/* Direct blocks. */
 		blknr = le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
@@ -267,6 +226,109 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	return blknr;
 }
 
+static int ext4fs_map_extent(struct ext2fs_node *node, uint32_t fileblock)
+{
+	struct ext2_data *data = node->data;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	uint32_t startblock, len;
+	uint64_t start;
+	int i;
+
+	ext_block = ext4fs_get_extent_block(data, data->extent_buf,
+			(struct ext4_extent_header *)node->inode.b.blocks.dir_blocks,
+			fileblock, LOG2_EXT2_BLOCK_SIZE(data));
+	if (!ext_block) {
+		pr_err("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		len = le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file, the hole extends up to this extent */
+			node->ext_lblk = fileblock;
+			node->ext_len = startblock - fileblock;
+			node->ext_pblk = 0;
+			return 0;
+		}
+
+		if (len > EXT_INIT_MAX_LEN) {
+			len -= EXT_INIT_MAX_LEN;
+			start = 0;
+		} else {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) + le32_to_cpu(extent[i].ee_start_lo);
+		}
+
+		if (fileblock - startblock < len) {
+			node->ext_lblk = startblock;
+			node->ext_len = len;
+			node->ext_pblk = start;
+			return 0;
+		}
+	}
+
+	/* Hole behind the last extent of this leaf */
+	node->ext_lblk = fileblock;
+	node->ext_len = 1;
+	node->ext_pblk = 0;
+
+	return 0;
+}
+
+/*
+ * Map @fileblock of @node to a filesystem block in @pblk, 0 meaning a hole.
+ * On entry @count holds the number of blocks the caller is interested in, on
+ * return the number of blocks following @fileblock which are either
+ * physically contiguous or part of the same hole.
+ */
+int ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		      uint32_t *count, sector_t *pblk)
+{
+	uint32_t max = *count, n;
+	long int blknr, next;
+	int ret;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		if (!node->ext_len || fileblock < node->ext_lblk ||
+		    fileblock - node->ext_lblk >= node->ext_len) {
+			ret = ext4fs_map_extent(node, fileblock);
+			if (ret)
+				return ret;
+		}
+
+		n = fileblock - node->ext_lblk;
+		*pblk = node->ext_pblk ? node->ext_pblk + n : 0;
+		*count = min(max, node->ext_len - n);
+
+		return 0;
+	}
+
+	blknr = ext4fs_map_indirect(node, fileblock);
+	if (blknr < 0)
+		return blknr;
+
+	/*
+	 * The indirect blocks are cached, so looking up the following blocks
+	 * one by one is cheap compared to issuing a device read for each.
+	 */
+	for (n = 1; n < max; n++) {
+		next = ext4fs_map_indirect(node, fileblock + n);
+		if (next < 0 || next != (blknr ? blknr + n : 0))
+			break;
+	}
+
+	*pblk = blknr;
+	*count = n;
+
+	return 0;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -545,9 +607,10 @@ int ext4fs_mount(struct ext_filesystem *fs)
 	fs->data->indir1.data = malloc(blksz);
 	fs->data->indir2.data = malloc(blksz);
 	fs->data->indir3.data = malloc(blksz);
+	fs->data->extent_buf = malloc(blksz);
 
 	if (!fs->data->indir1.data || !fs->data->indir2.data ||
-			!fs->data->indir3.data) {
+			!fs->data->indir3.data || !fs->data->extent_buf) {
 		ret = -ENOMEM;
 		goto fail;
 	}
@@ -568,5 +631,6 @@ void ext4fs_umount(struct ext_filesystem *fs)
 	free(fs->data->indir1.data);
 	free(fs->data->indir2.data);
 	free(fs->data->indir3.data);
+	free(fs->data->extent_buf);
 	free(fs->data);
 }
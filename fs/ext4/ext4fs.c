@@ -43,67 +43,54 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Read file data one contiguous run of blocks at a time, as returned by
+ * ext4fs_map_blocks(), directly into the caller's buffer. Holes are filled
+ * with zeroes.
  */
 loff_t ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		unsigned int len, char *buf)
 {
-	loff_t i;
-	blkcnt_t blockcnt;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE(node->data);
 	const int blockshift = log2blocksize + DISK_SECTOR_BITS;
 	const int blocksize = 1 << blockshift;
 	loff_t filesize = ext4_isize(node);
-	ssize_t ret;
 	struct ext_filesystem *fs = node->data->fs;
+	unsigned int remaining;
+	ssize_t ret;
+
+	if (filesize <= pos)
+		return -EINVAL;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = filesize - pos;
 
-	if (filesize <= pos)
-		return -EINVAL;
+	remaining = len;
 
-	blockcnt = ((len + pos) + blocksize - 1) >> blockshift;
-
-	for (i = pos >> blockshift; i < blockcnt; i++) {
+	while (remaining) {
+		unsigned int skip = pos & (blocksize - 1);
+		uint32_t count = DIV_ROUND_UP((u64)skip + remaining, blocksize);
 		sector_t blknr;
-		loff_t blockoff = pos - (blocksize * i);
-		loff_t blockend = blocksize;
-		loff_t skipfirst = 0;
+		size_t now;
 
-		ret = read_allocated_block(node, i);
-		if (ret < 0)
+		ret = ext4fs_map_blocks(node, pos >> blockshift, &count, &blknr);
+		if (ret)
 			return ret;
 
-		blknr = ret << log2blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == pos >> blockshift) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		now = min_t(u64, ((u64)count << blockshift) - skip, remaining);
 
 		if (blknr) {
-			ret = ext4fs_devread(fs, blknr, skipfirst, blockend, buf);
+			ret = ext4fs_devread(fs, blknr << log2blocksize, skip,
+					     now, buf);
 			if (ret)
 				return ret;
 		} else {
-			memset(buf, 0, blockend);
+			memset(buf, 0, now);
 		}
 
-		buf += blocksize - skipfirst;
+		buf += now;
+		pos += now;
+		remaining -= now;
 	}
 
 	return len;
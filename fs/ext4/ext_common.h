@@ -215,11 +215,15 @@ struct ext2fs_node {
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	/* last extent (or hole) found by ext4fs_map_blocks() */
+	uint32_t ext_lblk;
+	uint32_t ext_len;
+	sector_t ext_pblk;
 };
 
 struct ext4fs_indir_block {
 	int size;
-	int blkno;
+	sector_t blkno;
 	uint32_t *data;
 };
 
@@ -230,6 +234,7 @@ struct ext2_data {
 	struct ext2fs_node diropen;
 	struct ext_filesystem *fs;
 	struct ext4fs_indir_block indir1, indir2, indir3;
+	char *extent_buf;
 };
 
 static inline loff_t ext4_isize(struct ext2fs_node *node)
@@ -367,6 +367,108 @@ static DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster
 	return 0xFFFFFFFF;	/* An error occurred at the disk I/O layer */
 }
 
+#if _USE_FASTSEEK
+/*
+ * Get the cluster link map table of a file, building it on first use
+ *
+ * The table holds its size in DWORDs, followed by a (number of clusters,
+ * start cluster) pair for each fragment of the file and a terminating 0.
+ * Files open for writing don't get a table as their chain may change.
+ */
+static DWORD *get_cltbl (
+	FIL *fp		/* File object */
+)
+{
+	DWORD *tbl, ulen, n, clst, pcl, scl, ncl, left, bcs;
+
+	if (fp->cltbl || fp->cltbl_err || (fp->flag & FA_WRITE))
+		return fp->cltbl;
+
+	if (!fp->sclust || !fp->fsize)
+		return NULL;
+
+	bcs = (DWORD)fp->fs->csize * SS(fp->fs);
+	left = (fp->fsize - 1) / bcs + 1;	/* Number of clusters of the file */
+	ulen = 16;
+	tbl = ff_memalloc(ulen * sizeof(*tbl));
+	n = 1;
+	clst = fp->sclust;
+
+	while (left) {
+		scl = clst;
+		ncl = 0;
+		do {
+			ncl++;
+			if (!--left)
+				break;
+			pcl = clst;
+			clst = get_fat(fp->fs, clst);
+			if (clst < 2 || clst >= fp->fs->n_fatent)
+				goto err;
+		} while (clst == pcl + 1);
+
+		if (n + 3 > ulen) {
+			ulen *= 2;
+			tbl = xrealloc(tbl, ulen * sizeof(*tbl));
+		}
+		tbl[n++] = ncl;
+		tbl[n++] = scl;
+	}
+
+	tbl[n++] = 0;
+	tbl[0] = n;
+	fp->cltbl = tbl;
+
+	return tbl;
+err:
+	ff_memfree(tbl);
+	fp->cltbl_err = 1;
+
+	return NULL;
+}
+
+/*
+ * Get the cluster holding file offset @ofs from the cluster link map table
+ */
+static DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
+	FIL *fp,	/* File object */
+	DWORD ofs	/* File offset to be converted to cluster# */
+)
+{
+	DWORD cl, ncl, *tbl;
+
+	tbl = fp->cltbl + 1;
+	cl = ofs / SS(fp->fs) / fp->fs->csize;	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;
+		if (!ncl)
+			return 0;	/* End of table? (error) */
+		if (cl < ncl)
+			break;		/* In this fragment? */
+		cl -= ncl;
+		tbl++;			/* Next fragment */
+	}
+
+	return cl + *tbl;
+}
+#endif
+
+/*
+ * Get the cluster following @clst, which holds file offset @ofs
+ */
+static DWORD next_clust (	/* 0xFFFFFFFF:Disk error, <2:Error, Else:Cluster number */
+	FIL *fp,	/* File object */
+	DWORD clst,	/* Current cluster */
+	DWORD ofs	/* File offset of the following cluster */
+)
+{
+#if _USE_FASTSEEK
+	if (get_cltbl(fp))
+		return clmt_clust(fp, ofs);
+#endif
+	return get_fat(fp->fs, clst);
+}
+
 
 
 
@@ -1812,6 +1914,10 @@ int f_open (
 		fp->fsize = LD_DWORD(dir+DIR_FileSize);	/* File size */
 		fp->fptr = 0;			/* File pointer */
 		fp->dsect = 0;
+#if _USE_FASTSEEK
+		fp->cltbl = NULL;
+		fp->cltbl_err = 0;
+#endif
 		fp->fs = dj.fs;
 	}
 
@@ -1853,7 +1959,7 @@ int f_read (
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->sclust;	/* Follow from the origin */
 				} else {			/* Middle or end of the file */
-						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
+					clst = next_clust(fp, fp->clust, fp->fptr);	/* Follow cluster chain */
 				}
 				if (clst < 2)
 					ABORT(fp->fs, -ERESTARTSYS);
@@ -1867,9 +1973,19 @@ int f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);		/* When remaining bytes >= sector size, */
 			if (cc) {			/* Read maximum contiguous sectors directly */
+				UINT want = cc;
+
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs, rbuff, sect, (BYTE)cc) != RES_OK)
+				/* Extend the read over physically contiguous clusters */
+				while (cc < want) {
+					clst = next_clust(fp, fp->clust, fp->fptr + cc * SS(fp->fs));
+					if (clst != fp->clust + 1)
+						break;
+					fp->clust = clst;
+					cc += min_t(UINT, want - cc, fp->fs->csize);
+				}
+				if (disk_read(fp->fs, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
 #if defined FS_FAT_WRITE
 				/* Replace one of the read sectors with cached data if it contains a dirty sector */
@@ -1971,7 +2087,7 @@ int f_write (
 				/* Write maximum contiguous sectors directly */
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_write(fp->fs, wbuff, sect, (BYTE)cc) != RES_OK)
+				if (disk_write(fp->fs, wbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
 				if (fp->dsect - sect < cc) {
 					/* Refill sector cache if it gets invalidated by the direct write */
@@ -2054,12 +2170,19 @@ int f_close (
 	FIL *fp		/* Pointer to the file object to be closed */
 )
 {
+#ifdef FS_FAT_WRITE
+	int res;
+#endif
+
+#if _USE_FASTSEEK
+	ff_memfree(fp->cltbl);
+	fp->cltbl = NULL;
+#endif
+
 #ifndef FS_FAT_WRITE
 	fp->fs = 0;	/* Discard file object */
 	return 0;
 #else
-	int res;
-
 	/* Flush cached data */
 	res = f_sync(fp);
 	if (res == 0)
@@ -2088,6 +2211,24 @@ int f_lseek (
 #endif
 		) ofs = fp->fsize;
 
+#if _USE_FASTSEEK
+	if (ofs && get_cltbl(fp)) {	/* Fast seek using the cluster link map table */
+		fp->fptr = ofs;
+		clst = clmt_clust(fp, ofs - 1);
+		nsect = clust2sect(fp->fs, clst);
+		if (!nsect)
+			ABORT(fp->fs, -ERESTARTSYS);
+		fp->clust = clst;
+		nsect += (ofs - 1) / SS(fp->fs) & (fp->fs->csize - 1);
+		if (fp->fptr % SS(fp->fs) && nsect != fp->dsect) {	/* Fill sector cache if needed */
+			if (disk_read(fp->fs, fp->buf, nsect, 1) != RES_OK)
+				ABORT(fp->fs, -EIO);
+			fp->dsect = nsect;
+		}
+		return 0;
+	}
+#endif
+
 	ifptr = fp->fptr;
 	fp->fptr = nsect = 0;
 	if (ofs) {
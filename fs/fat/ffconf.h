@@ -33,8 +33,13 @@
 /* To enable f_forward function, set _USE_FORWARD to 1 and set _FS_TINY to 1. */
 
 
+#ifdef __PBL__
 #define	_USE_FASTSEEK	0	/* 0:Disable or 1:Enable */
-/* To enable fast seek feature, set _USE_FASTSEEK to 1. */
+#else
+#define	_USE_FASTSEEK	1
+#endif
+/* To enable fast seek feature, set _USE_FASTSEEK to 1. The cluster link map
+/  table is built on first use for files which are not opened for writing. */
 
 
 
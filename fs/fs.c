@@ -23,6 +23,8 @@
 #include <malloc.h>
 #include <linux/stat.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/ctype.h>
 #include <fcntl.h>
 #include <xfuncs.h>
 #include <init.h>
@@ -794,15 +796,81 @@ static int fs_probe(struct device *dev)
 	return 0;
 }
 
+/*
+ * Directories with more than D_HASH_MIN_CHILDREN cached entries get a hash
+ * table indexing their children by name. It is grown whenever the number
+ * of children exceeds the number of buckets.
+ */
+#define D_HASH_MIN_CHILDREN	8
+
+static u32 d_name_hash(const struct super_block *sb, const struct qstr *name)
+{
+	u32 hash = 0;
+	int i;
+
+	for (i = 0; i < name->len; i++) {
+		unsigned char c = name->name[i];
+
+		if (sb->s_casefold)
+			c = tolower(c);
+
+		hash = (hash + (c << 4) + (c >> 4)) * 11;
+	}
+
+	return hash;
+}
+
+static struct hlist_head *d_hash_bucket(struct dentry *parent, u32 hash)
+{
+	return &parent->d_children_hash[hash_32(hash, parent->d_children_hash_bits)];
+}
+
+static void d_rehash_children(struct dentry *parent, unsigned int bits)
+{
+	struct dentry *dentry;
+
+	free(parent->d_children_hash);
+	parent->d_children_hash = xzalloc(sizeof(struct hlist_head) << bits);
+	parent->d_children_hash_bits = bits;
+
+	list_for_each_entry(dentry, &parent->d_subdirs, d_child)
+		hlist_add_head(&dentry->d_hash,
+			       d_hash_bucket(parent, dentry->d_name.hash));
+}
+
+static void d_hash_child(struct dentry *parent, struct dentry *dentry)
+{
+	parent->d_nr_children++;
+
+	if (parent->d_children_hash &&
+	    parent->d_nr_children <= (1U << parent->d_children_hash_bits)) {
+		hlist_add_head(&dentry->d_hash,
+			       d_hash_bucket(parent, dentry->d_name.hash));
+		return;
+	}
+
+	if (parent->d_nr_children > D_HASH_MIN_CHILDREN)
+		d_rehash_children(parent, fls(parent->d_nr_children));
+}
+
+static void d_unhash_child(struct dentry *dentry)
+{
+	dentry->d_parent->d_nr_children--;
+	hlist_del_init(&dentry->d_hash);
+}
+
 static void dentry_kill(struct dentry *dentry)
 {
 	if (dentry->d_inode)
 		iput(dentry->d_inode);
 
-	if (!IS_ROOT(dentry))
+	if (!IS_ROOT(dentry)) {
 		dput(dentry->d_parent);
+		d_unhash_child(dentry);
+	}
 
 	list_del(&dentry->d_child);
+	free(dentry->d_children_hash);
 	free(dentry);
 }
 
@@ -1480,6 +1548,7 @@ static struct dentry *__d_alloc(struct super_block *sb, const struct qstr *name)
 
 	dentry->d_name.len = name->len;
 	dentry->d_name.name = dentry->name;
+	dentry->d_name.hash = d_name_hash(sb, name);
 
 	dentry->d_count = 1;
 	dentry->d_parent = dentry;
@@ -1510,6 +1579,7 @@ static struct dentry *d_alloc(struct dentry *parent, const struct qstr *name)
 
 	dentry->d_parent = parent;
 	list_add(&dentry->d_child, &parent->d_subdirs);
+	d_hash_child(parent, dentry);
 
 	return dentry;
 }
@@ -1578,9 +1648,21 @@ static bool d_same_name(const struct dentry *dentry,
 static struct dentry *d_lookup(struct dentry *parent, const struct qstr *name)
 {
 	struct dentry *dentry;
+	u32 hash;
+
+	if (!parent->d_children_hash) {
+		list_for_each_entry(dentry, &parent->d_subdirs, d_child) {
+			if (d_same_name(dentry, name))
+				return dget(dentry);
+		}
+
+		return NULL;
+	}
+
+	hash = d_name_hash(parent->d_sb, name);
 
-	list_for_each_entry(dentry, &parent->d_subdirs, d_child) {
-		if (d_same_name(dentry, name))
+	hlist_for_each_entry(dentry, d_hash_bucket(parent, hash), d_hash) {
+		if (dentry->d_name.hash == hash && d_same_name(dentry, name))
 			return dget(dentry);
 	}
 
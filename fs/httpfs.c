@@ -0,0 +1,932 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * httpfs.c - read-only filesystem on top of HTTP/1.1
+ *
+ * Files are read in chunks of rsize bytes with range requests. Once a file
+ * is read sequentially, the chunks ahead of the reader are requested in
+ * parallel on several keep-alive connections, so that the transfer neither
+ * waits for a round trip per chunk nor stalls completely while a single
+ * connection recovers from a lost segment.
+ *
+ * Directories cannot be listed. A path which the server redirects to the
+ * same path with a trailing slash is taken as a directory.
+ */
+
+#define pr_fmt(fmt) "httpfs: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <driver.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <init.h>
+#include <malloc.h>
+#include <net.h>
+#include <parseopt.h>
+#include <linux/ctype.h>
+#include <linux/err.h>
+#include <linux/math64.h>
+#include <linux/netfs.h>
+#include <linux/sizes.h>
+#include <linux/stat.h>
+
+#define HTTP_PORT		80
+
+#define HTTP_CONNECTIONS	4
+#define HTTP_MAX_CONNECTIONS	8
+
+#define HTTP_RSIZE		SZ_256K
+#define HTTP_RSIZE_MIN		SZ_4K
+#define HTTP_RSIZE_MAX		SZ_4M
+
+/* maximum size of a response header */
+#define HTTP_HDR_MAX		SZ_4K
+
+/* give up on a request after this time without data from the server */
+#define HTTP_TIMEOUT		(10 * SECOND)
+
+struct http_chunk {
+	long index;		/* chunk number in the file, -1 if unused */
+	loff_t offset;
+	unsigned int len;	/* bytes requested */
+	unsigned int filled;	/* bytes received */
+	bool done;
+	int err;
+	struct http_conn *conn;	/* connection receiving the chunk */
+	void *buf;
+};
+
+enum http_conn_state {
+	HTTP_IDLE,
+	HTTP_HEADER,
+	HTTP_BODY,
+};
+
+struct http_conn {
+	struct http_priv *priv;
+	struct net_connection *con;	/* NULL while not connected */
+	enum http_conn_state state;
+	struct http_chunk *chunk;	/* NULL for HEAD requests */
+	char *request;
+	unsigned int requests;		/* requests completed on @con */
+	uint64_t progress;
+	int err;
+
+	/* the response */
+	int status;
+	bool keep_alive;
+	loff_t content_length;
+	loff_t range_start;
+
+	unsigned int hdr_len;
+	char hdr[HTTP_HDR_MAX];
+};
+
+struct http_priv {
+	IPaddr_t server;
+	unsigned short port;
+	char *host;		/* for the Host header */
+	char *prefix;		/* path on the server the mount starts at */
+	unsigned int rsize;
+	unsigned short nconns;
+	struct http_conn conns[HTTP_MAX_CONNECTIONS];
+};
+
+struct file_priv {
+	struct http_priv *priv;
+	char *path;
+	loff_t size;
+	long current;		/* chunk the reader is in */
+	bool sequential;
+	unsigned int nchunks;
+	struct http_chunk *chunks;
+};
+
+struct http_inode {
+	struct netfs_inode netfs_node;
+};
+
+static struct http_inode *to_http_inode(struct inode *inode)
+{
+	return container_of(inode, struct http_inode, netfs_node.inode);
+}
+
+static int http_status_to_errno(int status)
+{
+	switch (status) {
+	case 401:
+	case 403:
+		return -EACCES;
+	case 404:
+	case 410:
+		return -ENOENT;
+	case 416:
+		return -EINVAL;
+	default:
+		return -EIO;
+	}
+}
+
+/*
+ * Returns the URL path of @path below the mount, with everything but the
+ * unreserved characters and the path delimiters percent-encoded.
+ */
+static char *http_url_path(struct http_priv *priv, const char *path)
+{
+	char *full = basprintf("%s%s", priv->prefix, path);
+	char *url = xmalloc(strlen(full) * 3 + 1), *p = url;
+	const unsigned char *s;
+
+	for (s = full; *s; s++) {
+		if (isalnum(*s) || strchr("/-._~!$&'()*+,;=:@", *s))
+			*p++ = *s;
+		else
+			p += sprintf(p, "%%%02X", *s);
+	}
+	*p = 0;
+
+	free(full);
+
+	return url;
+}
+
+static void http_conn_disconnect(struct http_conn *conn, bool abort)
+{
+	if (!conn->con)
+		return;
+
+	if (abort)
+		net_tcp_abort(conn->con);
+	else
+		net_tcp_close(conn->con);
+
+	conn->con = NULL;
+	conn->requests = 0;
+}
+
+static void http_conn_finish(struct http_conn *conn, int err)
+{
+	if (conn->chunk) {
+		conn->chunk->err = err;
+		conn->chunk->done = !err;
+		conn->chunk->conn = NULL;
+		conn->chunk = NULL;
+	}
+
+	free(conn->request);
+	conn->request = NULL;
+	conn->err = err;
+	conn->state = HTTP_IDLE;
+}
+
+/*
+ * Connect if necessary. Idle keep-alive connections may have been closed by
+ * the server in the meantime, these are connected again.
+ */
+static int http_conn_connect(struct http_conn *conn)
+{
+	struct http_priv *priv = conn->priv;
+	char c;
+
+	if (conn->con) {
+		if (net_tcp_read(conn->con, &c, 1) == -EAGAIN)
+			return 0;
+
+		http_conn_disconnect(conn, true);
+	}
+
+	conn->con = net_tcp_connect(priv->server, priv->port);
+	if (IS_ERR(conn->con)) {
+		int ret = PTR_ERR(conn->con);
+
+		conn->con = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+static int http_conn_send(struct http_conn *conn)
+{
+	int ret;
+
+	ret = http_conn_connect(conn);
+	if (ret)
+		return ret;
+
+	ret = net_tcp_write(conn->con, conn->request, strlen(conn->request));
+	if (ret < 0)
+		return ret;
+
+	conn->state = HTTP_HEADER;
+	conn->hdr_len = 0;
+	conn->progress = get_time_ns();
+
+	return 0;
+}
+
+/*
+ * Start a request for @chunk on an idle connection, a HEAD request if @chunk
+ * is NULL
+ */
+static int http_conn_request(struct http_conn *conn, const char *path,
+			     struct http_chunk *chunk)
+{
+	struct http_priv *priv = conn->priv;
+	char *url = http_url_path(priv, path);
+	int ret;
+
+	if (chunk)
+		conn->request = basprintf("GET %s HTTP/1.1\r\n"
+					  "Host: %s\r\n"
+					  "Range: bytes=%lld-%lld\r\n"
+					  "\r\n", url, priv->host, chunk->offset,
+					  chunk->offset + chunk->len - 1);
+	else
+		conn->request = basprintf("HEAD %s HTTP/1.1\r\n"
+					  "Host: %s\r\n"
+					  "\r\n", url, priv->host);
+
+	free(url);
+
+	conn->chunk = chunk;
+	if (chunk)
+		chunk->conn = conn;
+
+	ret = http_conn_send(conn);
+	if (ret) {
+		http_conn_disconnect(conn, true);
+		http_conn_finish(conn, ret);
+	}
+
+	return ret;
+}
+
+static void http_conn_fail(struct http_conn *conn, int err)
+{
+	/*
+	 * The server may close an idle keep-alive connection just when we
+	 * send the next request. Try again once on a new connection then.
+	 */
+	bool retry = conn->requests && !conn->hdr_len;
+
+	pr_debug("request failed: %pe\n", ERR_PTR(err));
+
+	http_conn_disconnect(conn, true);
+
+	if (retry) {
+		err = http_conn_send(conn);
+		if (!err)
+			return;
+		http_conn_disconnect(conn, true);
+	}
+
+	http_conn_finish(conn, err);
+}
+
+static int http_parse_header(struct http_conn *conn)
+{
+	char *line = conn->hdr, *next, *val;
+
+	if (strncmp(line, "HTTP/1.", 7) || !isdigit(line[7]) || line[8] != ' ')
+		return -EPROTO;
+
+	conn->status = simple_strtoul(line + 9, NULL, 10);
+	conn->keep_alive = line[7] != '0';
+	conn->content_length = -1;
+	conn->range_start = -1;
+
+	for (line = strstr(line, "\r\n"); line; line = next) {
+		line += 2;
+		next = strstr(line, "\r\n");
+		if (next)
+			*next = 0;
+
+		val = strchr(line, ':');
+		if (!val)
+			continue;
+
+		*val++ = 0;
+		val = skip_spaces(val);
+
+		if (!strcasecmp(line, "Content-Length")) {
+			conn->content_length = simple_strtoull(val, NULL, 10);
+		} else if (!strcasecmp(line, "Content-Range")) {
+			if (!strncasecmp(val, "bytes ", 6))
+				conn->range_start = simple_strtoull(val + 6,
+								    NULL, 10);
+		} else if (!strcasecmp(line, "Connection")) {
+			if (!strcasecmp(val, "close"))
+				conn->keep_alive = false;
+			else if (!strcasecmp(val, "keep-alive"))
+				conn->keep_alive = true;
+		} else if (!strcasecmp(line, "Transfer-Encoding")) {
+			/* we only ask for data whose length is known */
+			if (strcasecmp(val, "identity"))
+				return -EPROTO;
+		}
+	}
+
+	return 0;
+}
+
+static void http_conn_complete(struct http_conn *conn)
+{
+	conn->requests++;
+
+	if (!conn->keep_alive)
+		http_conn_disconnect(conn, false);
+
+	http_conn_finish(conn, 0);
+}
+
+/*
+ * Check the response header of a finished header and start receiving the
+ * body. Returns 0 when the body follows, 1 when the request is complete.
+ */
+static int http_start_body(struct http_conn *conn)
+{
+	struct http_chunk *chunk = conn->chunk;
+	int ret;
+
+	ret = http_parse_header(conn);
+	if (ret)
+		return ret;
+
+	/* HEAD responses have no body, the caller looks at the status */
+	if (!chunk)
+		return 1;
+
+	switch (conn->status) {
+	case 206:
+		if (conn->range_start != chunk->offset)
+			return -EPROTO;
+		break;
+	case 200:
+		/* the whole file, fine if that is what we asked for */
+		if (!chunk->offset && conn->content_length >= 0 &&
+		    conn->content_length <= chunk->len)
+			break;
+		pr_err("server does not support range requests\n");
+		return -EOPNOTSUPP;
+	default:
+		return http_status_to_errno(conn->status);
+	}
+
+	if (conn->content_length < 0 || conn->content_length > chunk->len)
+		return -EPROTO;
+
+	/* the file shrank since we looked it up */
+	chunk->len = conn->content_length;
+	chunk->filled = 0;
+	conn->state = HTTP_BODY;
+
+	return 0;
+}
+
+static int http_recv_header(struct http_conn *conn)
+{
+	struct http_chunk *chunk;
+	unsigned int extra;
+	char *end;
+	int ret;
+
+	ret = net_tcp_read(conn->con, conn->hdr + conn->hdr_len,
+			   HTTP_HDR_MAX - 1 - conn->hdr_len);
+	if (ret <= 0)
+		return ret ?: -ECONNRESET;
+
+	conn->hdr_len += ret;
+	conn->hdr[conn->hdr_len] = 0;
+
+	end = strstr(conn->hdr, "\r\n\r\n");
+	if (!end)
+		return conn->hdr_len < HTTP_HDR_MAX - 1 ? ret : -EPROTO;
+
+	/* the data after the header belongs to the body */
+	end += 4;
+	extra = conn->hdr + conn->hdr_len - end;
+	end[-2] = 0;
+
+	ret = http_start_body(conn);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		if (extra)
+			return -EPROTO;
+		http_conn_complete(conn);
+		return 1;
+	}
+
+	chunk = conn->chunk;
+	if (extra > chunk->len)
+		return -EPROTO;
+
+	memcpy(chunk->buf, end, extra);
+	chunk->filled = extra;
+
+	if (chunk->filled == chunk->len)
+		http_conn_complete(conn);
+
+	return 1;
+}
+
+static int http_recv_body(struct http_conn *conn)
+{
+	struct http_chunk *chunk = conn->chunk;
+	int ret;
+
+	ret = net_tcp_read(conn->con, chunk->buf + chunk->filled,
+			   chunk->len - chunk->filled);
+	if (ret <= 0)
+		return ret ?: -ECONNRESET;
+
+	chunk->filled += ret;
+
+	if (chunk->filled == chunk->len)
+		http_conn_complete(conn);
+
+	return ret;
+}
+
+/*
+ * Move the received data of a connection into its chunk
+ */
+static void http_conn_process(struct http_conn *conn)
+{
+	int ret;
+
+	while (conn->state != HTTP_IDLE) {
+		if (conn->state == HTTP_HEADER)
+			ret = http_recv_header(conn);
+		else
+			ret = http_recv_body(conn);
+
+		if (ret == -EAGAIN) {
+			if (!is_timeout(conn->progress, HTTP_TIMEOUT))
+				return;
+			ret = -ETIMEDOUT;
+		}
+
+		if (ret < 0) {
+			http_conn_fail(conn, ret);
+			return;
+		}
+
+		conn->progress = get_time_ns();
+	}
+}
+
+static int http_poll(struct http_priv *priv)
+{
+	int i;
+
+	if (ctrlc())
+		return -EINTR;
+
+	net_poll();
+
+	for (i = 0; i < priv->nconns; i++)
+		http_conn_process(&priv->conns[i]);
+
+	return 0;
+}
+
+static struct http_conn *http_idle_conn(struct http_priv *priv)
+{
+	int i;
+
+	for (i = 0; i < priv->nconns; i++)
+		if (priv->conns[i].state == HTTP_IDLE)
+			return &priv->conns[i];
+
+	return NULL;
+}
+
+/*
+ * Sends a HEAD request for @path and waits for the response. Returns the
+ * connection with the response status, or an error pointer.
+ */
+static struct http_conn *http_head(struct http_priv *priv, const char *path)
+{
+	struct http_conn *conn;
+	int ret;
+
+	while (!(conn = http_idle_conn(priv))) {
+		ret = http_poll(priv);
+		if (ret)
+			return ERR_PTR(ret);
+	}
+
+	ret = http_conn_request(conn, path, NULL);
+	if (ret)
+		return ERR_PTR(ret);
+
+	while (conn->state != HTTP_IDLE) {
+		ret = http_poll(priv);
+		if (ret) {
+			http_conn_disconnect(conn, true);
+			http_conn_finish(conn, ret);
+			return ERR_PTR(ret);
+		}
+	}
+
+	if (conn->err)
+		return ERR_PTR(conn->err);
+
+	return conn;
+}
+
+static void http_chunk_cancel(struct http_chunk *chunk)
+{
+	struct http_conn *conn = chunk->conn;
+
+	/* the only way to stop a response is to drop the connection */
+	if (conn) {
+		http_conn_disconnect(conn, true);
+		http_conn_finish(conn, -ECANCELED);
+	}
+
+	chunk->index = -1;
+	chunk->done = false;
+	chunk->err = 0;
+}
+
+/*
+ * Assign the chunks from @index on to the slots and request them on the
+ * idle connections.
+ */
+static void http_queue(struct file_priv *fpriv, long index, unsigned int ahead)
+{
+	struct http_priv *priv = fpriv->priv;
+	struct http_chunk *chunk;
+	struct http_conn *conn;
+	loff_t offset;
+	long i;
+
+	for (i = index; i <= index + ahead; i++) {
+		offset = (loff_t)i * priv->rsize;
+		if (offset >= fpriv->size)
+			break;
+
+		chunk = &fpriv->chunks[i % fpriv->nchunks];
+
+		if (chunk->index != i) {
+			http_chunk_cancel(chunk);
+			chunk->index = i;
+			chunk->offset = offset;
+			chunk->len = min_t(loff_t, priv->rsize,
+					   fpriv->size - offset);
+			chunk->filled = 0;
+		}
+
+		if (chunk->done || chunk->err || chunk->conn)
+			continue;
+
+		conn = http_idle_conn(priv);
+		if (!conn)
+			break;
+
+		http_conn_request(conn, fpriv->path, chunk);
+	}
+}
+
+static struct http_chunk *http_get_chunk(struct file_priv *fpriv, long index)
+{
+	struct http_chunk *chunk = &fpriv->chunks[index % fpriv->nchunks];
+	unsigned int ahead;
+	int ret;
+
+	if (index != fpriv->current) {
+		fpriv->sequential = fpriv->current >= 0 &&
+				    index == fpriv->current + 1;
+		fpriv->current = index;
+	}
+
+	/* read ahead only once the file is read sequentially */
+	ahead = fpriv->sequential ? fpriv->nchunks - 1 : 0;
+
+	while (1) {
+		http_queue(fpriv, index, ahead);
+
+		if (chunk->done)
+			return chunk;
+
+		if (chunk->err) {
+			ret = chunk->err;
+			/* start over on the next read */
+			chunk->index = -1;
+			chunk->err = 0;
+			return ERR_PTR(ret);
+		}
+
+		ret = http_poll(fpriv->priv);
+		if (ret)
+			return ERR_PTR(ret);
+	}
+}
+
+static int http_read(struct file *f, void *buf, size_t insize)
+{
+	struct file_priv *fpriv = f->private_data;
+	struct http_chunk *chunk;
+	loff_t pos = f->f_pos;
+	size_t outsize = 0;
+	unsigned int ofs, now;
+
+	while (insize) {
+		chunk = http_get_chunk(fpriv, div_u64(pos, fpriv->priv->rsize));
+		if (IS_ERR(chunk))
+			return PTR_ERR(chunk);
+
+		ofs = pos - chunk->offset;
+		if (ofs >= chunk->filled)
+			break;
+
+		now = min_t(size_t, insize, chunk->filled - ofs);
+		memcpy(buf, chunk->buf + ofs, now);
+
+		buf += now;
+		pos += now;
+		insize -= now;
+		outsize += now;
+	}
+
+	return outsize;
+}
+
+static int http_open(struct inode *inode, struct file *file)
+{
+	struct fs_device *fsdev = file->fsdev;
+	struct http_priv *priv = fsdev->dev.priv;
+	struct file_priv *fpriv;
+	int i;
+
+	if ((file->f_flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+
+	fpriv = xzalloc(sizeof(*fpriv));
+	fpriv->priv = priv;
+	fpriv->path = dpath(file->f_path.dentry, fsdev->vfsmount.mnt_root);
+	fpriv->size = inode->i_size;
+	fpriv->current = -1;
+
+	/* one chunk per connection and one for the reader */
+	fpriv->nchunks = priv->nconns + 1;
+	fpriv->chunks = xzalloc(fpriv->nchunks * sizeof(*fpriv->chunks));
+
+	for (i = 0; i < fpriv->nchunks; i++) {
+		fpriv->chunks[i].index = -1;
+		fpriv->chunks[i].buf = malloc(priv->rsize);
+		if (!fpriv->chunks[i].buf)
+			goto err;
+	}
+
+	file->private_data = fpriv;
+
+	return 0;
+err:
+	while (i--)
+		free(fpriv->chunks[i].buf);
+	free(fpriv->chunks);
+	free(fpriv->path);
+	free(fpriv);
+
+	return -ENOMEM;
+}
+
+static int http_close(struct inode *inode, struct file *file)
+{
+	struct file_priv *fpriv = file->private_data;
+	int i;
+
+	for (i = 0; i < fpriv->nchunks; i++) {
+		http_chunk_cancel(&fpriv->chunks[i]);
+		free(fpriv->chunks[i].buf);
+	}
+
+	free(fpriv->chunks);
+	free(fpriv->path);
+	free(fpriv);
+
+	return 0;
+}
+
+static const struct inode_operations http_file_inode_operations;
+static const struct inode_operations http_dir_inode_operations;
+static const struct file_operations http_file_operations = {
+	.open = http_open,
+	.release = http_close,
+	.read = http_read,
+};
+
+static struct inode *http_get_inode(struct super_block *sb, umode_t mode)
+{
+	struct inode *inode = new_inode(sb);
+	struct http_inode *node;
+
+	if (!inode)
+		return NULL;
+
+	inode->i_ino = get_next_ino();
+	inode->i_mode = mode;
+
+	node = to_http_inode(inode);
+	netfs_inode_init(&node->netfs_node);
+
+	switch (mode & S_IFMT) {
+	default:
+		return NULL;
+	case S_IFREG:
+		inode->i_op = &http_file_inode_operations;
+		inode->i_fop = &http_file_operations;
+		break;
+	case S_IFDIR:
+		inode->i_op = &http_dir_inode_operations;
+		inode->i_fop = &simple_dir_operations;
+		inc_nlink(inode);
+		break;
+	}
+
+	return inode;
+}
+
+static struct dentry *http_lookup(struct inode *dir, struct dentry *dentry,
+				  unsigned int flags)
+{
+	struct super_block *sb = dir->i_sb;
+	struct fs_device *fsdev = container_of(sb, struct fs_device, sb);
+	struct http_priv *priv = fsdev->dev.priv;
+	struct http_conn *conn;
+	struct inode *inode;
+	umode_t mode = S_IFREG | S_IRUGO;
+	loff_t size = 0;
+	char *path, *dirpath;
+
+	path = dpath(dentry, fsdev->vfsmount.mnt_root);
+
+	conn = http_head(priv, path);
+	if (IS_ERR(conn))
+		goto out;
+
+	switch (conn->status) {
+	case 200:
+		if (conn->content_length < 0) {
+			pr_warn("%s: no size given, cannot read it\n", path);
+			goto out;
+		}
+		size = conn->content_length;
+		break;
+	case 301:
+	case 302:
+	case 307:
+	case 308:
+		dirpath = basprintf("%s/", path);
+		conn = http_head(priv, dirpath);
+		free(dirpath);
+		if (IS_ERR(conn) ||
+		    (conn->status != 200 && conn->status != 403))
+			goto out;
+		mode = S_IFDIR | S_IRUGO | S_IXUGO;
+		break;
+	default:
+		goto out;
+	}
+
+	inode = http_get_inode(sb, mode);
+	if (!inode) {
+		free(path);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	inode->i_size = size;
+
+	d_add(dentry, inode);
+out:
+	free(path);
+
+	return NULL;
+}
+
+static const struct inode_operations http_dir_inode_operations = {
+	.lookup = http_lookup,
+};
+
+static struct inode *http_alloc_inode(struct super_block *sb)
+{
+	struct http_inode *node;
+
+	node = xzalloc(sizeof(*node));
+	if (!node)
+		return NULL;
+
+	return &node->netfs_node.inode;
+}
+
+static void http_destroy_inode(struct inode *inode)
+{
+	struct http_inode *node = to_http_inode(inode);
+
+	free(node);
+}
+
+static const struct super_operations http_ops = {
+	.alloc_inode = http_alloc_inode,
+	.destroy_inode = http_destroy_inode,
+};
+
+static int http_probe(struct device *dev)
+{
+	struct fs_device *fsdev = dev_to_fs_device(dev);
+	struct http_priv *priv = xzalloc(sizeof(*priv));
+	struct super_block *sb = &fsdev->sb;
+	unsigned long long rsize = HTTP_RSIZE;
+	char *host, *prefix;
+	int i, ret;
+
+	dev->priv = priv;
+
+	/* <server>[/<path>] */
+	host = xstrdup(fsdev->backingstore);
+	prefix = strchr(host, '/');
+	if (prefix) {
+		priv->prefix = xstrdup(prefix);
+		*prefix = 0;
+		/* dpath() of the files starts with a slash */
+		if (priv->prefix[strlen(priv->prefix) - 1] == '/')
+			priv->prefix[strlen(priv->prefix) - 1] = 0;
+	} else {
+		priv->prefix = xstrdup("");
+	}
+
+	ret = resolv(host, &priv->server);
+	if (ret) {
+		pr_err("Cannot resolve \"%s\": %pe\n", host, ERR_PTR(ret));
+		goto err;
+	}
+
+	priv->port = HTTP_PORT;
+	parseopt_hu(fsdev->options, "port", &priv->port);
+
+	if (priv->port == HTTP_PORT)
+		priv->host = host;
+	else
+		priv->host = basprintf("%s:%hu", host, priv->port);
+
+	priv->nconns = HTTP_CONNECTIONS;
+	parseopt_hu(fsdev->options, "connections", &priv->nconns);
+	priv->nconns = clamp_t(unsigned short, priv->nconns, 1,
+			       HTTP_MAX_CONNECTIONS);
+
+	parseopt_llu_suffix(fsdev->options, "rsize", &rsize);
+	priv->rsize = clamp_t(unsigned long long, rsize, HTTP_RSIZE_MIN,
+			      HTTP_RSIZE_MAX);
+
+	for (i = 0; i < priv->nconns; i++)
+		priv->conns[i].priv = priv;
+
+	if (priv->host != host)
+		free(host);
+
+	sb->s_op = &http_ops;
+	sb->s_d_op = &netfs_dentry_operations_timed;
+	sb->s_root = d_make_root(http_get_inode(sb, S_IFDIR));
+
+	return 0;
+err:
+	free(priv->prefix);
+	free(host);
+	free(priv);
+
+	return ret;
+}
+
+static void http_remove(struct device *dev)
+{
+	struct http_priv *priv = dev->priv;
+	int i;
+
+	for (i = 0; i < priv->nconns; i++)
+		http_conn_disconnect(&priv->conns[i], false);
+
+	free(priv->host);
+	free(priv->prefix);
+	free(priv);
+}
+
+static struct fs_driver http_driver = {
+	.drv = {
+		.probe  = http_probe,
+		.remove = http_remove,
+		.name = "http",
+	}
+};
+
+static int http_init(void)
+{
+	return register_fs_driver(&http_driver);
+}
+coredevice_initcall(http_init);
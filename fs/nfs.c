@@ -29,7 +29,6 @@
 #include <init.h>
 #include <linux/stat.h>
 #include <linux/err.h>
-#include <kfifo.h>
 #include <linux/sizes.h>
 #include <byteorder.h>
 #include <globalvar.h>
@@ -123,6 +122,20 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(100 * MSECOND)
 #define NFS_MAX_RESEND	100
 
+/*
+ * By default READ replies are not fragmented, so the data has to fit into one
+ * ethernet frame together with the IP, UDP and RPC headers and the READ3resok
+ * fields in front of it: status, post_op_attr, count, eof and the data length.
+ * Larger reads with the rsize mount option need IP fragment reassembly.
+ */
+#define NFS_READ_HDR_SIZE	(20 + 8 + sizeof(struct rpc_reply) + \
+				 26 * sizeof(uint32_t))
+#define NFS_READ_MAX		ALIGN_DOWN(1500 - NFS_READ_HDR_SIZE, 64)
+#define NFS_RSIZE_MAX		32768
+
+/* default number of READ requests kept in flight */
+#define NFS_READ_WINDOW		4
+
 struct nfs_fh {
 	unsigned short size;
 	unsigned char data[NFS3_FHSIZE];
@@ -132,7 +145,9 @@ struct packet {
 	struct list_head list;
 	unsigned int len;
 	unsigned int pos;
-	char data[];
+	char *data;
+	char *held;	/* received packet @data points into, if not copied */
+	char buf[];
 };
 
 struct nfs_priv {
@@ -147,13 +162,39 @@ struct nfs_priv {
 	uint32_t rpc_id;
 	struct nfs_fh rootfh;
 	struct list_head packets;
+	unsigned short read_window;
+	unsigned int rsize;
+};
+
+/*
+ * A READ request of the read-ahead window. It asks for @count bytes of the
+ * file from @offset on. Once the reply is in, @avail bytes of them are
+ * available at @data inside @packet.
+ */
+struct nfs_read_slot {
+	uint32_t xid;
+	uint64_t offset;
+	uint32_t count;
+	uint64_t sent;
+	int tries;
+	struct packet *packet;
+	void *data;
+	uint32_t avail;
 };
 
+/*
+ * The window is a ring of @used slots from @head on, covering the file
+ * contiguously from the current position up to @next.
+ */
 struct file_priv {
-	struct kfifo *fifo;
-	void *buf;
 	struct nfs_priv *npriv;
 	struct nfs_fh fh;
+	struct nfs_read_slot *slots;
+	int nslots;
+	int head;
+	int used;
+	uint64_t next;
+	uint64_t size;
 };
 
 struct nfs_inode {
@@ -496,26 +537,23 @@ static int rpc_check_reply(struct packet *pkt, uint32_t rpc_id)
 static void nfs_free_packet(struct packet *packet)
 {
 	list_del(&packet->list);
+	if (packet->held)
+		net_free_packet(packet->held);
 	free(packet);
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * rpc_send - send a RPC request without waiting for the reply
  */
-static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
-			      int rpc_proc, uint32_t *data, int datalen)
+static int rpc_send(struct nfs_priv *npriv, uint32_t xid, int rpc_prog,
+		    int rpc_proc, uint32_t *data, int datalen)
 {
 	struct device *dev = npriv->dev;
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int tries = 0;
-	struct packet *packet;
-
-	npriv->rpc_id++;
 
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(xid);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -539,11 +577,26 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
+	return net_udp_send(npriv->con,
+			sizeof(pkt) + datalen * sizeof(uint32_t));
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
+			      int rpc_proc, uint32_t *data, int datalen)
+{
+	int ret;
+	int tries = 0;
+	struct packet *packet;
+
+	npriv->rpc_id++;
+
 	nfs_timer_start = get_time_ns();
 
 again:
-	ret = net_udp_send(npriv->con,
-			sizeof(pkt) + datalen * sizeof(uint32_t));
+	ret = rpc_send(npriv, npriv->rpc_id, rpc_prog, rpc_proc, data, datalen);
 	if (ret) {
 		if (is_timeout(nfs_timer_start, NFS_TIMEOUT)) {
 			tries++;
@@ -1083,18 +1136,13 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - (re)send the READ request of a read-ahead slot
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static void nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
 	struct nfs_priv *npriv = priv->npriv;
-	struct device *dev = npriv->dev;
-	uint32_t data[1024];
-	uint32_t *p, status;
-	int len, ret;
-	struct packet *nfs_packet;
-	uint32_t rlen, eof;
+	uint32_t data[64];
+	uint32_t *p;
 
 	/*
 	 * struct READ3args {
@@ -1102,7 +1150,36 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, &priv->fh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, slot->count);
+
+	/* a reply to an earlier send may still arrive, but is ignored */
+	slot->xid = ++npriv->rpc_id;
+	slot->sent = get_time_ns();
+
+	/* failed sends are repeated when the request times out */
+	rpc_send(npriv, slot->xid, PROG_NFS, NFSPROC3_READ, data,
+		 p - &(data[0]));
+}
+
+/*
+ * nfs_read_reply - take the reply to the READ request of @slot
+ */
+static int nfs_read_reply(struct file_priv *priv, struct nfs_read_slot *slot,
+			  struct packet *nfs_packet)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct device *dev = npriv->dev;
+	uint32_t *p, status;
+	uint32_t rlen, eof;
+	int ret;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -1121,18 +1198,9 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, &priv->fh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
-
-	len = p - &(data[0]);
-
-	nfs_packet = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (IS_ERR(nfs_packet))
-		return PTR_ERR(nfs_packet);
+	ret = rpc_check_reply(nfs_packet, slot->xid);
+	if (ret)
+		goto err_free_packet;
 
 	p = nfs_packet_read(nfs_packet, sizeof(uint32_t));
 	if (!p) {
@@ -1174,16 +1242,30 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	nfs_packet_read(nfs_packet, sizeof(uint32_t));
 
-	if (readlen && !rlen && !eof) {
+	if (!rlen && !eof) {
 		ret = -EIO;
 		goto err_free_packet;
 	}
 
+	rlen = min(rlen, slot->count);
+
 	p = nfs_packet_read(nfs_packet, rlen);
+	if (!p) {
+		ret = -EINVAL;
+		goto err_free_packet;
+	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	/* the file ends earlier than its size told us */
+	if (eof && rlen < slot->count) {
+		priv->size = slot->offset + rlen;
+		slot->count = rlen;
+	}
 
-	ret = 0;
+	slot->packet = nfs_packet;
+	slot->data = p;
+	slot->avail = rlen;
+
+	return 0;
 
 err_free_packet:
 	nfs_free_packet(nfs_packet);
@@ -1191,14 +1273,126 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	return ret;
 }
 
+static void nfs_read_cancel(struct file_priv *priv)
+{
+	struct nfs_read_slot *slot;
+
+	for (; priv->used; priv->used--) {
+		slot = &priv->slots[priv->head];
+		if (slot->packet)
+			nfs_free_packet(slot->packet);
+		slot->packet = NULL;
+		slot->avail = 0;
+		priv->head = (priv->head + 1) % priv->nslots;
+	}
+}
+
+/*
+ * Send READ requests for the data following the window until it is full
+ */
+static void nfs_read_fill(struct file_priv *priv)
+{
+	struct nfs_read_slot *slot;
+
+	while (priv->used < priv->nslots && priv->next < priv->size) {
+		slot = &priv->slots[(priv->head + priv->used) % priv->nslots];
+		slot->offset = priv->next;
+		slot->count = min_t(uint64_t, priv->npriv->rsize,
+				    priv->size - priv->next);
+		slot->tries = 0;
+		priv->next += slot->count;
+		priv->used++;
+
+		nfs_read_send(priv, slot);
+	}
+}
+
+/*
+ * Returns the slot waiting for the reply with @xid, NULL for duplicates and
+ * replies to resent or cancelled requests
+ */
+static struct nfs_read_slot *nfs_read_find_slot(struct file_priv *priv,
+						uint32_t xid)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < priv->used; i++) {
+		slot = &priv->slots[(priv->head + i) % priv->nslots];
+		if (slot->xid == xid && !slot->packet)
+			return slot;
+	}
+
+	return NULL;
+}
+
+/*
+ * Pass received packets to the slots they answer, resend requests which
+ * timed out. Replies can arrive in any order.
+ */
+static int nfs_read_poll(struct file_priv *priv)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read_slot *slot;
+	struct packet *packet, *tmp;
+	uint32_t xid;
+	int i, ret;
+
+	net_poll();
+
+	list_for_each_entry_safe(packet, tmp, &npriv->packets, list) {
+		if (packet->len < sizeof(struct rpc_reply)) {
+			nfs_free_packet(packet);
+			continue;
+		}
+
+		xid = ntoh32(((struct rpc_reply *)packet->data)->id);
+
+		slot = nfs_read_find_slot(priv, xid);
+		if (!slot) {
+			nfs_free_packet(packet);
+			continue;
+		}
+
+		list_del_init(&packet->list);
+		ret = nfs_read_reply(priv, slot, packet);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < priv->used; i++) {
+		slot = &priv->slots[(priv->head + i) % priv->nslots];
+		if (slot->packet || !is_timeout(slot->sent, NFS_TIMEOUT))
+			continue;
+
+		if (++slot->tries == NFS_MAX_RESEND)
+			return -ETIMEDOUT;
+
+		nfs_read_send(priv, slot);
+	}
+
+	return 0;
+}
+
 static void nfs_handler(void *ctx, char *p, unsigned len)
 {
 	char *pkt = net_eth_to_udp_payload(p);
 	struct nfs_priv *npriv = ctx;
 	struct packet *packet;
 
-	packet = xmalloc(sizeof(*packet) + len);
-	memcpy(packet->data, pkt, len);
+	len = net_eth_to_udplen(p);
+
+	/* keep the received packet if possible instead of copying it */
+	if (net_packet_get(pkt)) {
+		packet = xmalloc(sizeof(*packet));
+		packet->data = packet->held = pkt;
+	} else {
+		packet = xmalloc(sizeof(*packet) + len);
+		memcpy(packet->buf, pkt, len);
+		packet->data = packet->buf;
+		packet->held = NULL;
+	}
+
 	packet->len = len;
 	packet->pos = 0;
 
@@ -1212,9 +1406,8 @@ static int nfs_truncate(struct file *f, loff_t size)
 
 static void nfs_do_close(struct file_priv *priv)
 {
-	if (priv->fifo)
-		kfifo_free(priv->fifo);
-
+	nfs_read_cancel(priv);
+	free(priv->slots);
 	free(priv);
 }
 
@@ -1321,14 +1514,11 @@ static int nfs_open(struct inode *inode, struct file *file)
 	priv = xzalloc(sizeof(*priv));
 	priv->fh = ninode->fh;
 	priv->npriv = npriv;
+	priv->size = inode->i_size;
+	priv->nslots = npriv->read_window;
+	priv->slots = xzalloc(priv->nslots * sizeof(*priv->slots));
 	file->private_data = priv;
 
-	priv->fifo = kfifo_alloc(1024);
-	if (!priv->fifo) {
-		free(priv);
-		return -ENOMEM;
-	}
-
 	return 0;
 }
 
@@ -1349,24 +1539,71 @@ static int nfs_write(struct file *file, const void *inbuf, size_t insize)
 static int nfs_read(struct file *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->private_data;
+	struct nfs_read_slot *slot;
+	size_t done = 0, now;
+	int ret = 0;
 
-	if (insize > 1024)
-		insize = 1024;
+	/* the window has to start at the current position */
+	if (priv->used && priv->slots[priv->head].offset != file->f_pos)
+		nfs_read_cancel(priv);
+	if (!priv->used)
+		priv->next = file->f_pos;
 
-	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->f_pos, insize);
-		if (ret)
+	while (done < insize) {
+		nfs_read_fill(priv);
+
+		/* nothing left to ask for: end of file */
+		if (!priv->used)
+			break;
+
+		slot = &priv->slots[priv->head];
+
+		if (!slot->packet) {
+			ret = nfs_read_poll(priv);
+			if (ret)
+				break;
+			continue;
+		}
+
+		now = min_t(size_t, slot->avail, insize - done);
+		memcpy(buf + done, slot->data, now);
+		done += now;
+		slot->data += now;
+		slot->avail -= now;
+		slot->offset += now;
+		slot->count -= now;
+
+		if (slot->avail)
+			continue;
+
+		nfs_free_packet(slot->packet);
+		slot->packet = NULL;
+
+		if (slot->count) {
+			/* the server sent less than asked for, get the rest */
+			slot->tries = 0;
+			nfs_read_send(priv, slot);
+		} else {
+			priv->head = (priv->head + 1) % priv->nslots;
+			priv->used--;
+		}
+	}
+
+	if (ret) {
+		nfs_read_cancel(priv);
+		if (!done)
 			return ret;
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+	return done;
 }
 
 static int nfs_lseek(struct file *file, loff_t pos)
 {
 	struct file_priv *priv = file->private_data;
 
-	kfifo_reset(priv->fifo);
+	if (priv->used && priv->slots[priv->head].offset != pos)
+		nfs_read_cancel(priv);
 
 	return 0;
 }
@@ -1597,6 +1834,7 @@ static int nfs_probe(struct device *dev)
 	char *tmp = xstrdup(fsdev->backingstore);
 	char *path;
 	struct inode *inode;
+	unsigned long long rsize;
 	int ret;
 
 	dev->priv = npriv;
@@ -1604,6 +1842,10 @@ static int nfs_probe(struct device *dev)
 
 	INIT_LIST_HEAD(&npriv->packets);
 
+	npriv->read_window = NFS_READ_WINDOW;
+	parseopt_hu(fsdev->options, "readahead", &npriv->read_window);
+	npriv->read_window = max_t(unsigned short, npriv->read_window, 1);
+
 	dev_dbg(dev, "mount: %s\n", fsdev->backingstore);
 
 	path = strchr(tmp, ':');
@@ -1633,6 +1875,20 @@ static int nfs_probe(struct device *dev)
 	/* Need a priviliged source port */
 	net_udp_bind(npriv->con, 1000);
 
+	rsize = NFS_READ_MAX;
+	parseopt_llu_suffix(fsdev->options, "rsize", &rsize);
+	rsize = ALIGN_DOWN(clamp_t(unsigned long long, rsize, 512, NFS_RSIZE_MAX), 64);
+	npriv->rsize = min_t(unsigned int, rsize, NFS_READ_MAX);
+	if (rsize > NFS_READ_MAX) {
+		ret = net_udp_set_rx_size(npriv->con,
+					  rsize + NFS_READ_HDR_SIZE - 20 - 8);
+		if (ret)
+			dev_warn(dev, "rsize %llu not supported: %pe\n", rsize,
+				 ERR_PTR(ret));
+		else
+			npriv->rsize = rsize;
+	}
+
 	if (nfsport_default == 0) {
 		parseopt_hu(fsdev->options, "mountport", &npriv->mount_port);
 		if (!npriv->mount_port) {
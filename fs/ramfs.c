@@ -99,6 +99,9 @@ static struct inode *ramfs_get_inode(struct super_block *sb, const struct inode
 
 #define MIN_SIZE SZ_8K
 
+/* upper limit for growing a single chunk file in one step */
+#define RAMFS_GROW_MAX SZ_8M
+
 static struct ramfs_chunk *ramfs_get_chunk(unsigned long size)
 {
 	struct ramfs_chunk *data;
@@ -317,6 +320,80 @@ static void ramfs_truncate_down(struct ramfs_inode *node, unsigned long size)
 	node->current_chunk = NULL;
 }
 
+/*
+ * Grow a file that consists of a single chunk by reallocating that chunk,
+ * so that files written piece by piece stay contiguous and can be
+ * memmapped. The chunk grows geometrically to keep the number of copies
+ * low for small appending writes, but by no more than RAMFS_GROW_MAX at a
+ * time, so big files do not waste up to the same amount again. The slack
+ * is given back by ramfs_shrink_chunk().
+ */
+static int ramfs_grow_chunk(struct ramfs_inode *node, unsigned long size)
+{
+	struct ramfs_chunk *data, *new;
+	unsigned long newsize;
+
+	if (!list_is_singular(&node->data))
+		return -EINVAL;
+
+	data = list_first_entry(&node->data, struct ramfs_chunk, list);
+
+	newsize = max(size, node->alloc_size +
+			    min(node->alloc_size, (unsigned long)RAMFS_GROW_MAX));
+	if (newsize > INT_MAX)
+		return -EINVAL;
+
+	list_del(&data->list);
+
+	new = realloc(data, struct_size(data, data, newsize));
+	if (!new && newsize > size) {
+		newsize = size;
+		new = realloc(data, struct_size(data, data, newsize));
+	}
+	if (!new) {
+		list_add(&data->list, &node->data);
+		return -ENOMEM;
+	}
+
+	memset(new->data + new->size, 0, newsize - new->size);
+	new->size = newsize;
+	list_add(&new->list, &node->data);
+
+	node->alloc_size = newsize;
+	node->current_chunk = NULL;
+
+	return 0;
+}
+
+/*
+ * Shrink a file that consists of a single chunk to its size, i.e. drop
+ * the slack left by ramfs_grow_chunk() or a truncate.
+ */
+static void ramfs_shrink_chunk(struct ramfs_inode *node)
+{
+	struct ramfs_chunk *data, *new;
+
+	if (!list_is_singular(&node->data))
+		return;
+
+	data = list_first_entry(&node->data, struct ramfs_chunk, list);
+
+	if (node->size < MIN_SIZE || data->size <= node->size)
+		return;
+
+	list_del(&data->list);
+
+	new = realloc(data, struct_size(data, data, node->size));
+	if (new) {
+		new->size = node->size;
+		node->alloc_size = node->size;
+		data = new;
+	}
+
+	list_add(&data->list, &node->data);
+	node->current_chunk = NULL;
+}
+
 static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 {
 	struct ramfs_chunk *data, *tmp;
@@ -328,6 +405,9 @@ static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 	if (node->alloc_size >= size)
 		return 0;
 
+	if (!ramfs_grow_chunk(node, size))
+		return 0;
+
 	/*
 	 * We first try to allocate all space we need in a single chunk.
 	 * This may fail because of fragmented memory, so in case we cannot
@@ -397,17 +477,29 @@ static int ramfs_truncate(struct file *f, loff_t size)
 
 	if (size < node->size) {
 		ramfs_truncate_down(node, size);
-	} else {
-		ret = ramfs_truncate_up(node, size);
-		if (ret)
-			return ret;
+		node->size = size;
+		ramfs_shrink_chunk(node);
+
+		return 0;
 	}
 
+	ret = ramfs_truncate_up(node, size);
+	if (ret)
+		return ret;
+
 	node->size = size;
 
 	return 0;
 }
 
+static int ramfs_release(struct inode *inode, struct file *f)
+{
+	if (f->f_flags & O_ACCMODE)
+		ramfs_shrink_chunk(to_ramfs_inode(inode));
+
+	return 0;
+}
+
 static int ramfs_memmap(struct file *f, void **map, int flags)
 {
 	struct inode *inode = f->f_inode;
@@ -432,6 +524,7 @@ static const struct file_operations ramfs_file_operations = {
 	.write     = ramfs_write,
 	.memmap    = ramfs_memmap,
 	.truncate  = ramfs_truncate,
+	.release   = ramfs_release,
 };
 
 static struct inode *ramfs_alloc_inode(struct super_block *sb)
@@ -32,51 +32,42 @@
 #include "page_actor.h"
 
 /*
- * Read the metadata block length, this is stored in the first two
- * bytes of the metadata block.
+ * Return a pointer to @len bytes of the image at @index inside the read-ahead
+ * buffer, refilling it from @index on if they are not there yet. The
+ * datablocks of a file follow each other on the device, so one refill usually
+ * serves the next few blocks. Returns NULL if read-ahead is disabled, the
+ * request does not fit into the buffer or reading failed.
  */
-static char *get_block_length(struct super_block *sb,
-			u64 *cur_index, int *offset, int *length)
+static const char *squashfs_read_ahead(struct squashfs_sb_info *msblk,
+			u64 index, int length)
 {
-	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	char *buf;
+	u64 start;
+	int ret, size;
 
-	buf = squashfs_devread(msblk,
-			 *cur_index * msblk->devblksize,
-			 msblk->devblksize);
-	if (buf == NULL)
+	if (!msblk->ra_buf || length > msblk->ra_size - msblk->devblksize)
 		return NULL;
 
-	if (msblk->devblksize - *offset == 1) {
-		*length = (unsigned char) buf[*offset];
-		free(buf);
-		buf = squashfs_devread(msblk,
-				 ++(*cur_index) * msblk->devblksize,
-				 msblk->devblksize);
-		if (buf == NULL)
+	if (index < msblk->ra_start ||
+	    index + length > msblk->ra_start + msblk->ra_len) {
+		/*
+		 * Start on a device block boundary, the decompressors address
+		 * the data in device block sized pieces from there.
+		 */
+		start = index & ~((u64)msblk->devblksize - 1);
+		size = min_t(u64, msblk->ra_size, msblk->bytes_used - start);
+
+		msblk->ra_len = 0;
+		ret = squashfs_devread(msblk, msblk->ra_buf, start, size);
+		if (ret)
 			return NULL;
-		*length |= (unsigned char) buf[0] << 8;
-		*offset = 1;
-	} else {
-		*length = (unsigned char) buf[*offset] |
-			(unsigned char) buf[*offset + 1] << 8;
-		*offset += 2;
-
-		if (*offset == msblk->devblksize) {
-			free(buf);
-			buf = squashfs_devread(msblk,
-					 ++(*cur_index) * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf == NULL)
-				return NULL;
-			*offset = 0;
-		}
+
+		msblk->ra_start = start;
+		msblk->ra_len = size;
 	}
 
-	return buf;
+	return msblk->ra_buf + (index - msblk->ra_start);
 }
 
-
 /*
  * Read and decompress a metadata block or datablock.  Length is non-zero
  * if a datablock is being read (the size is stored elsewhere in the
@@ -85,26 +76,23 @@ static char *get_block_length(struct super_block *sb,
  * is stored uncompressed in the filesystem (usually because compression
  * generated a larger block - this does occasionally happen with compression
  * algorithms).
+ *
+ * The whole block is fetched with a single device read, datablocks through
+ * the read-ahead buffer.
  */
 int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		u64 *next_index, struct squashfs_page_actor *output)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	char **buf;
-	int offset = index & ((1 << msblk->devblksize_log2) - 1);
-	u64 cur_index = index >> msblk->devblksize_log2;
-	int bytes, compressed, b = 0, k = 0, avail;
-
-	buf = calloc(((output->length + msblk->devblksize - 1)
-			>> msblk->devblksize_log2) + 1, sizeof(*buf));
-	if (buf == NULL)
-		return -ENOMEM;
+	const char *data = NULL;
+	char **buf, *block = NULL;
+	int offset, bytes, compressed, b, k;
+	__le16 len;
 
 	if (length) {
 		/*
 		 * Datablock.
 		 */
-		bytes = -offset;
 		compressed = SQUASHFS_COMPRESSED_BLOCK(length);
 		length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
 		if (next_index)
@@ -114,20 +102,10 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 			index, compressed ? "" : "un", length, output->length);
 
 		if (length < 0 || length > output->length ||
-				(index + length) > msblk->bytes_used) {
+				(index + length) > msblk->bytes_used)
 			goto read_failure;
-		}
-
-		for (b = 0; bytes < length; b++, cur_index++) {
-			buf[b] = squashfs_devread(msblk,
-					 cur_index * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf[b] == NULL)
-				goto block_release;
-
-			bytes += msblk->devblksize;
-		}
 
+		data = squashfs_read_ahead(msblk, index, length);
 	} else {
 		/*
 		 * Metadata block.
@@ -135,80 +113,84 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		if ((index + 2) > msblk->bytes_used)
 			goto read_failure;
 
-		buf[0] = get_block_length(sb, &cur_index, &offset, &length);
-		if (buf[0] == NULL)
+		if (squashfs_devread(msblk, &len, index, sizeof(len)))
 			goto read_failure;
-		b = 1;
 
-		bytes = msblk->devblksize - offset;
+		length = le16_to_cpu(len);
 		compressed = SQUASHFS_COMPRESSED(length);
 		length = SQUASHFS_COMPRESSED_SIZE(length);
+		index += 2;
 		if (next_index)
-			*next_index = index + length + 2;
+			*next_index = index + length;
 
 		TRACE("Block Meta @ 0x%llx, %scompressed size %d\n", index,
 				compressed ? "" : "un", length);
 
 		if (length < 0 || length > output->length ||
 					(index + length) > msblk->bytes_used)
+			goto read_failure;
+	}
+
+	offset = index & (msblk->devblksize - 1);
+	b = (offset + length + msblk->devblksize - 1) >> msblk->devblksize_log2;
+
+	if (!data) {
+		block = malloc(offset + length);
+		if (block == NULL)
+			return -ENOMEM;
+
+		if (squashfs_devread(msblk, block + offset, index, length))
 			goto block_release;
 
-		for (; bytes < length; b++) {
-			buf[b] = squashfs_devread(msblk,
-					 ++cur_index * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf[b] == NULL)
-				goto block_release;
-			bytes += msblk->devblksize;
-		}
+		data = block + offset;
+	}
+
+	buf = calloc(b, sizeof(*buf));
+	if (buf == NULL) {
+		free(block);
+		return -ENOMEM;
 	}
 
+	/* the decompressors take the data in device block sized pieces */
+	for (k = 0; k < b; k++)
+		buf[k] = (char *)data - offset + k * msblk->devblksize;
+
 	if (compressed) {
-		if (!msblk->stream)
-			goto read_failure;
-		length = squashfs_decompress(msblk, buf, b, offset, length,
-			output);
-		if (length < 0)
-			goto read_failure;
+		if (!msblk->stream) {
+			length = -EIO;
+		} else {
+			length = squashfs_decompress(msblk, buf, b, offset,
+						     length, output);
+			if (length < 0)
+				length = -EIO;
+		}
 	} else {
 		/*
 		 * Block is uncompressed.
 		 */
-		int pg_offset = 0;
-		void *data = squashfs_first_page(output);
-
-		for (bytes = length; k < b; k++) {
-			int in = min(bytes, msblk->devblksize - offset);
-			bytes -= in;
-			while (in) {
-				if (pg_offset == PAGE_CACHE_SIZE) {
-					data = squashfs_next_page(output);
-					pg_offset = 0;
-				}
-				avail = min_t(int, in, PAGE_CACHE_SIZE -
-						pg_offset);
-				memcpy(data + pg_offset, buf[k] + offset,
-						avail);
-				in -= avail;
-				pg_offset += avail;
-				offset += avail;
-			}
-			offset = 0;
-			kfree(buf[k]);
+		void *page = squashfs_first_page(output);
+
+		for (bytes = length; bytes > 0 && page; bytes -= PAGE_CACHE_SIZE) {
+			memcpy(page, data, min_t(int, bytes, PAGE_CACHE_SIZE));
+			data += PAGE_CACHE_SIZE;
+			page = squashfs_next_page(output);
 		}
 		squashfs_finish_page(output);
 	}
 
-	kfree(buf);
+	free(buf);
+	free(block);
+
+	if (length < 0)
+		goto read_failure;
+
 	return length;
 
 block_release:
-	for (; k < b; k++)
-		kfree(buf[k]);
+	free(block);
 
 read_failure:
 	ERROR("squashfs_read_data failed to read block 0x%llx\n",
 					(unsigned long long) index);
-	kfree(buf);
 	return -EIO;
 }
@@ -46,6 +46,7 @@
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * Locate cache slot in range [offset, index] for specified inode.  If
@@ -387,6 +388,100 @@ int squashfs_copy_cache(struct page *page, struct squashfs_cache_entry *buffer,
 	return 0;
 }
 
+/*
+ * Find out whether the data of a file is stored as uncompressed blocks
+ * directly following each other, so it can be used in place when the
+ * filesystem image is memory mapped. Returns the position of the data.
+ */
+int squashfs_file_contiguous(struct inode *inode, u64 *start)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	loff_t size = i_size_read(inode);
+	int nblocks = (size + msblk->block_size - 1) >> msblk->block_log;
+	u64 next = 0;
+	int i;
+
+	/* the tail end is packed into a fragment together with other files */
+	if (!size || squashfs_i(inode)->fragment_block != SQUASHFS_INVALID_BLK)
+		return -EINVAL;
+
+	for (i = 0; i < nblocks; i++) {
+		int expected = i < nblocks - 1 ? msblk->block_size :
+			size - ((loff_t)i << msblk->block_log);
+		u64 block = 0;
+		int bsize;
+
+		bsize = read_blocklist(inode, i, &block);
+		if (bsize < 0)
+			return bsize;
+
+		/* sparse blocks and compressed blocks can't be mapped */
+		if (!bsize || SQUASHFS_COMPRESSED_BLOCK(bsize) ||
+		    SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize) != expected)
+			return -EINVAL;
+
+		if (!i)
+			*start = block;
+		else if (block != next)
+			return -EINVAL;
+
+		next = block + expected;
+	}
+
+	return 0;
+}
+
+/*
+ * Read full datablock @index of a file straight into @dest, bypassing the data
+ * cache and the per-file page buffers. Returns -EINVAL for the tail end of
+ * a file, which has to go through squashfs_readpage().
+ */
+int squashfs_read_block_direct(struct inode *inode, int index, void *dest)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int i, pages = msblk->block_size >> PAGE_CACHE_SHIFT;
+	struct squashfs_page_actor *actor;
+	void **page;
+	u64 block = 0;
+	int bsize, res;
+
+	if (index >= file_end)
+		return -EINVAL;
+
+	bsize = read_blocklist(inode, index, &block);
+	if (bsize < 0)
+		return bsize;
+
+	if (bsize == 0) {
+		memset(dest, 0, msblk->block_size);
+		return 0;
+	}
+
+	page = kmalloc_array(pages, sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < pages; i++)
+		page[i] = dest + i * PAGE_CACHE_SIZE;
+
+	actor = squashfs_page_actor_init(page, pages, 0);
+	if (actor == NULL) {
+		kfree(page);
+		return -ENOMEM;
+	}
+
+	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+
+	kfree(actor);
+	kfree(page);
+
+	if (res < 0)
+		return res;
+
+	return res == msblk->block_size ? 0 : -EILSEQ;
+}
+
 /* Read datablock stored packed inside a fragment (tail-end packed block) */
 static int squashfs_readpage_fragment(struct page *page, int expected)
 {
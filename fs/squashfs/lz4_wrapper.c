@@ -103,7 +103,6 @@ static int lz4_uncompress(struct squashfs_sb_info *msblk, void *strm,
 		buff += avail;
 		bytes -= avail;
 		offset = 0;
-		kfree(bh[i]);
 	}
 
 	res = lz4_decompress_unknownoutputsize(stream->input, length,
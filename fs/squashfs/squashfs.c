@@ -21,23 +21,23 @@
 
 struct ubi_volume_desc;
 
-char *squashfs_devread(struct squashfs_sb_info *fs, int byte_offset,
-		int byte_len)
+int squashfs_devread(struct squashfs_sb_info *fs, void *buf, u64 offset,
+		int len)
 {
 	ssize_t size;
-	char *buf;
 
-	buf = malloc(byte_len);
-	if (buf == NULL)
-		return NULL;
-
-	size = cdev_read(fs->cdev, buf, byte_len, byte_offset, 0);
+	size = cdev_read(fs->cdev, buf, len, offset, 0);
 	if (size < 0) {
 		dev_err(fs->dev, "read error: %pe\n", ERR_PTR(size));
-		return NULL;
+		return size;
+	}
+
+	if (size < len) {
+		dev_err(fs->dev, "short read at 0x%llx\n", offset);
+		return -EIO;
 	}
 
-	return buf;
+	return 0;
 }
 
 static void squashfs_set_rootarg(struct fs_device *fsdev)
@@ -205,6 +205,7 @@ static int squashfs_read(struct file *f, void *buf, size_t insize)
 	unsigned int now;
 	void *pagebuf;
 	struct squashfs_page *page = f->private_data;
+	struct squashfs_sb_info *msblk = f->f_inode->i_sb->s_fs_info;
 
 	/* Read till end of current buffer page */
 	ofs = pos % PAGE_CACHE_SIZE;
@@ -221,6 +222,17 @@ static int squashfs_read(struct file *f, void *buf, size_t insize)
 
 	/* Do full buffer pages */
 	while (size >= PAGE_CACHE_SIZE) {
+		/* whole blocks are decompressed into the caller's buffer */
+		if (!(pos & (msblk->block_size - 1)) &&
+		    size >= msblk->block_size &&
+		    !squashfs_read_block_direct(f->f_inode,
+						pos >> msblk->block_log, buf)) {
+			size -= msblk->block_size;
+			pos += msblk->block_size;
+			buf += msblk->block_size;
+			continue;
+		}
+
 		squashfs_read_buf(page, pos, &pagebuf);
 
 		memcpy(buf, pagebuf, PAGE_CACHE_SIZE);
@@ -239,10 +251,36 @@ static int squashfs_read(struct file *f, void *buf, size_t insize)
 	return insize;
 }
 
+static int squashfs_memmap(struct file *f, void **map, int flags)
+{
+	struct inode *inode = f->f_inode;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	void *base;
+	u64 start;
+	int ret;
+
+	if (flags & PROT_WRITE)
+		return -EACCES;
+
+	ret = squashfs_file_contiguous(inode, &start);
+	if (ret)
+		return ret;
+
+	/* only works when the filesystem image itself is in memory */
+	ret = cdev_memmap(msblk->cdev, &base, flags);
+	if (ret)
+		return ret;
+
+	*map = base + start;
+
+	return 0;
+}
+
 const struct file_operations squashfs_file_operations = {
 	.open = squashfs_open,
 	.release = squashfs_close,
 	.read = squashfs_read,
+	.memmap = squashfs_memmap,
 };
 
 static struct fs_driver squashfs_driver = {
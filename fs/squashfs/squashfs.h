@@ -52,8 +52,8 @@ static inline struct squashfs_page *squashfs_page(struct page *page)
 
 #define WARNING(s, args...)	pr_warn("SQUASHFS: "s, ## args)
 
-char *squashfs_devread(struct squashfs_sb_info *fs, int byte_offset,
-		int byte_len);
+int squashfs_devread(struct squashfs_sb_info *fs, void *buf, u64 offset,
+		int len);
 extern int squashfs_mount(struct fs_device *fsdev,
 			  int silent);
 extern void squashfs_put_super(struct super_block *sb);
@@ -99,6 +99,8 @@ extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 int squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 				int);
 extern int squashfs_readpage(struct file *file, struct page *page);
+int squashfs_file_contiguous(struct inode *inode, u64 *start);
+int squashfs_read_block_direct(struct inode *inode, int index, void *dest);
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int, int);
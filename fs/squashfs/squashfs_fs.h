@@ -25,6 +25,7 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	3
+#define SQUASHFS_READAHEAD_SIZE		(256 * 1024)
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_START			0
@@ -79,5 +79,9 @@ struct squashfs_sb_info {
 	int					xattr_ids;
 	struct cdev				*cdev;
 	struct device				*dev;
+	char					*ra_buf;
+	int					ra_size;
+	int					ra_len;
+	u64					ra_start;
 };
 #endif
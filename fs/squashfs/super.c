@@ -26,6 +26,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <errno.h>
+#include <parseopt.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/pagemap.h>
@@ -74,6 +75,7 @@ void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
 		squashfs_decompressor_destroy(sbi);
+		kfree(sbi->ra_buf);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -99,6 +101,9 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	unsigned short flags;
 	unsigned int fragments;
 	u64 lookup_table_start, next_table;
+	unsigned short data_cache = squashfs_max_decompressors();
+	unsigned short fragment_cache = SQUASHFS_CACHED_FRAGMENTS;
+	unsigned long long readahead = SQUASHFS_READAHEAD_SIZE;
 	int err;
 
 	TRACE("Entered squashfs_fill_superblock\n");
@@ -219,8 +224,20 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	sb->s_maxbytes = MAX_LFS_FILESIZE;
 	sb->s_flags |= MS_RDONLY;
 
+	parseopt_hu(fsdev->options, "data_cache", &data_cache);
+	parseopt_hu(fsdev->options, "fragment_cache", &fragment_cache);
+	parseopt_llu_suffix(fsdev->options, "readahead", &readahead);
+
 	err = -ENOMEM;
 
+	/* smaller windows than a block would not get any hits */
+	if (readahead >= msblk->block_size + msblk->devblksize) {
+		msblk->ra_size = min_t(unsigned long long, readahead, SZ_16M);
+		msblk->ra_buf = kmalloc(msblk->ra_size, GFP_KERNEL);
+		if (msblk->ra_buf == NULL)
+			goto failed_mount;
+	}
+
 	msblk->block_cache = squashfs_cache_init("metadata",
 			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
@@ -228,7 +245,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		max_t(int, data_cache, 1), msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -265,7 +282,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (fragments == 0)
 		goto check_directory_table;
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		max_t(int, fragment_cache, 1), msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -318,6 +335,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
 	squashfs_decompressor_destroy(msblk);
+	kfree(msblk->ra_buf);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -114,7 +114,7 @@ static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
 		total_out += out_buf.pos; /* add the additional data produced */
 
 		if (in_buf.pos == in_buf.size && k < b)
-			kfree(bh[k++]);
+			k++;
 	} while (zstd_err != 0 && !ZSTD_isError(zstd_err));
 
 	squashfs_finish_page(output);
@@ -131,9 +131,6 @@ static int zstd_uncompress(struct squashfs_sb_info *msblk, void *strm,
 	return (int)total_out;
 
 out:
-	for (; k < b; k++)
-		kfree(bh[k]);
-
 	return -EIO;
 }
 
@@ -27,12 +27,15 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <globalvar.h>
+#include <magicvar.h>
 #include <init.h>
 #include <linux/bitmap.h>
 #include <linux/stat.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
 #include <kfifo.h>
+#include <poller.h>
+#include <slice.h>
 #include <parseopt.h>
 #include <linux/sizes.h>
 #include <linux/netfs.h>
@@ -74,6 +77,7 @@
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
 #define TFTP_MTU_SIZE		1432	/* MTU based block size */
+#define TFTP_MAX_BLOCK_SIZE	65464	/* RFC 2348 upper limit */
 #define TFTP_MAX_WINDOW_SIZE	CONFIG_FS_TFTP_MAX_WINDOW_SIZE
 
 /* allocate this number of blocks more than needed in the fifo */
@@ -84,6 +88,9 @@
 
 #define TFTP_ERR_RESEND	1
 
+/* upper limit for global.tftp.pipeline */
+#define TFTP_MAX_PIPELINE	16
+
 #if defined(DEBUG) || IS_ENABLED(CONFIG_SELFTEST_TFTP)
 #  define debug_assert(_cond)	BUG_ON(!(_cond))
 #else
@@ -95,6 +102,12 @@
 
 static int g_tftp_window_size = DIV_ROUND_UP(TFTP_MAX_WINDOW_SIZE, 2);
 
+/* block size requested for downloads; larger than TFTP_MTU_SIZE is fragmented */
+static int g_tftp_block_size = TFTP_MTU_SIZE;
+
+/* number of windows received ahead of the reader by the receive poller */
+static int g_tftp_pipeline;
+
 struct tftp_block {
 	uint16_t id;
 	uint16_t len;
@@ -122,9 +135,12 @@ struct file_priv {
 	struct kfifo *fifo;
 	void *buf;
 	int blocksize;
+	int max_blocksize;
 	unsigned int windowsize;
 	bool is_getattr;
 	struct tftp_cache cache;
+	struct poller_struct rx_poller;
+	bool rx_busy;
 };
 
 struct tftp_priv {
@@ -247,9 +263,7 @@ static int tftp_send(struct file_priv *priv)
 				'\0',	/* "timeout" */
 				TIMEOUT, '\0',
 				'\0',	/* "blksize" */
-				/* use only a minimal blksize for getattr
-				   operations, */
-				priv->is_getattr ? TFTP_BLOCK_SIZE : TFTP_MTU_SIZE);
+				priv->max_blocksize);
 		pkt++;
 
 		if (!priv->push)
@@ -307,14 +321,8 @@ static int tftp_send_write(struct file_priv *priv, void *buf, int len)
 	return ret;
 }
 
-static int tftp_poll(struct file_priv *priv)
+static int __tftp_poll(struct file_priv *priv)
 {
-	if (ctrlc()) {
-		priv->state = STATE_DONE;
-		priv->err = -EINTR;
-		return -EINTR;
-	}
-
 	if (is_timeout(priv->resend_timeout, TFTP_RESEND_TIMEOUT)) {
 		printf("T ");
 		priv->resend_timeout = get_time_ns();
@@ -332,6 +340,17 @@ static int tftp_poll(struct file_priv *priv)
 	return 0;
 }
 
+static int tftp_poll(struct file_priv *priv)
+{
+	if (ctrlc()) {
+		priv->state = STATE_DONE;
+		priv->err = -EINTR;
+		return -EINTR;
+	}
+
+	return __tftp_poll(priv);
+}
+
 static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 {
 	unsigned char *opt, *val, *s;
@@ -360,7 +379,7 @@ static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 		s = val + strlen(val) + 1;
 	}
 
-	if (priv->blocksize > TFTP_MTU_SIZE ||
+	if (priv->blocksize > priv->max_blocksize ||
 	    priv->windowsize > TFTP_MAX_WINDOW_SIZE ||
 	    priv->windowsize == 0) {
 		pr_warn("tftp: invalid oack response\n");
@@ -375,15 +394,26 @@ static void tftp_timer_reset(struct file_priv *priv)
 	priv->progress_timeout = priv->resend_timeout = get_time_ns();
 }
 
+static bool tftp_use_pipeline(struct file_priv *priv)
+{
+	return g_tftp_pipeline > 0 &&
+		!priv->push && !priv->is_getattr;
+}
+
 static int tftp_allocate_transfer(struct file_priv *priv)
 {
+	unsigned int windows = 1;
+
 	debug_assert(!priv->fifo);
 	debug_assert(!priv->buf);
 
-	/* multiplication is safe; both operands were checked in tftp_parse_oack()
-	   and are small integers */
+	if (tftp_use_pipeline(priv))
+		windows = min(g_tftp_pipeline, TFTP_MAX_PIPELINE);
+
+	/* multiplication is safe; all operands were checked in tftp_parse_oack()
+	   or above and are small integers */
 	priv->fifo = kfifo_alloc(priv->blocksize *
-				 (priv->windowsize + TFTP_EXTRA_BLOCKS));
+				 (priv->windowsize * windows + TFTP_EXTRA_BLOCKS));
 	if (!priv->fifo)
 		goto err;
 
@@ -635,6 +665,51 @@ static void tftp_handler(void *ctx, char *packet, unsigned len)
 	tftp_recv(priv, pkt, net_eth_to_udplen(packet), udp->uh_sport);
 }
 
+/*
+ * Receive step of pipelined reads: acknowledge the next window as soon as
+ * the fifo has room for it and handle incoming packets and timeouts. It
+ * only touches the fifo and the network, so besides the reader it is also
+ * called from the rx poller while the reader is busy, e.g. writing the
+ * previously received data to storage.
+ */
+static void tftp_rx_work(struct file_priv *priv)
+{
+	unsigned int window = priv->windowsize * priv->blocksize;
+	int ret;
+
+	if (priv->rx_busy || priv->state != STATE_RDATA)
+		return;
+
+	priv->rx_busy = true;
+
+	if (priv->fifo->size - kfifo_len(priv->fifo) < window) {
+		/* the reader lags behind; that's no lack of progress */
+		tftp_timer_reset(priv);
+		goto out;
+	}
+
+	if (priv->last_block == priv->ack_block)
+		tftp_send(priv);
+
+	ret = __tftp_poll(priv);
+	if (ret == TFTP_ERR_RESEND)
+		tftp_send(priv);
+out:
+	priv->rx_busy = false;
+}
+
+static void tftp_rx_poll(struct poller_struct *poller)
+{
+	struct file_priv *priv = container_of(poller, struct file_priv,
+					      rx_poller);
+
+	/* the interface is in use by whoever we interrupted */
+	if (slice_acquired(eth_device_slice(priv->tftp_con->edev)))
+		return;
+
+	tftp_rx_work(priv);
+}
+
 static int tftp_start_transfer(struct file_priv *priv)
 {
 	int rc;
@@ -654,11 +729,42 @@ static int tftp_start_transfer(struct file_priv *priv)
 		priv->state = STATE_RDATA;
 		priv->last_block = 0;
 		tftp_send(priv);
+
+		if (tftp_use_pipeline(priv)) {
+			priv->rx_poller.func = tftp_rx_poll;
+			rc = poller_register(&priv->rx_poller, "tftp-rx");
+			if (rc)
+				pr_warn("cannot register receive poller, reading unpipelined\n");
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * Blocks larger than TFTP_MTU_SIZE arrive as fragmented datagrams. They can
+ * only be received, we do not fragment the blocks we send.
+ */
+static int tftp_max_blocksize(struct file_priv *priv)
+{
+	int blocksize = clamp(g_tftp_block_size, TFTP_BLOCK_SIZE,
+			      TFTP_MAX_BLOCK_SIZE);
+	int ret;
+
+	if (priv->push || blocksize <= TFTP_MTU_SIZE)
+		return min(blocksize, TFTP_MTU_SIZE);
+
+	/* DATA packets carry a 4 byte header in front of the block */
+	ret = net_udp_set_rx_size(priv->tftp_con, blocksize + 4);
+	if (ret) {
+		pr_warn_once("blocksize %d not supported: %pe\n", blocksize,
+			     ERR_PTR(ret));
+		return TFTP_MTU_SIZE;
+	}
+
+	return blocksize;
+}
+
 static struct file_priv *tftp_do_open(struct device *dev,
 				      int accmode, struct dentry *dentry,
 				      bool is_getattr)
@@ -700,6 +806,12 @@ static struct file_priv *tftp_do_open(struct device *dev,
 		goto out;
 	}
 
+	/* use only a minimal blksize for getattr operations */
+	if (is_getattr)
+		priv->max_blocksize = TFTP_BLOCK_SIZE;
+	else
+		priv->max_blocksize = tftp_max_blocksize(priv);
+
 	ret = tftp_send(priv);
 	if (ret)
 		goto out1;
@@ -782,6 +894,9 @@ static int tftp_do_close(struct file_priv *priv)
 {
 	int ret;
 
+	if (priv->rx_poller.registered)
+		poller_unregister(&priv->rx_poller);
+
 	if (priv->push && priv->state != STATE_DONE) {
 		int len;
 
@@ -860,6 +975,38 @@ static int tftp_write(struct file *f, const void *inbuf, size_t insize)
 	return insize;
 }
 
+static int tftp_read_pipelined(struct file_priv *priv, void *buf, size_t insize)
+{
+	size_t outsize = 0, now;
+
+	while (insize) {
+		now = kfifo_get(priv->fifo, buf, insize);
+		outsize += now;
+		buf += now;
+		insize -= now;
+
+		if (now)
+			continue;
+
+		if (priv->state == STATE_DONE) {
+			if (priv->err < 0)
+				return priv->err;
+			break;
+		}
+
+		if (ctrlc()) {
+			priv->state = STATE_DONE;
+			priv->err = -EINTR;
+			return -EINTR;
+		}
+
+		/* fifo is drained, receive in the foreground */
+		tftp_rx_work(priv);
+	}
+
+	return outsize;
+}
+
 static int tftp_read(struct file *f, void *buf, size_t insize)
 {
 	struct file_priv *priv = f->private_data;
@@ -868,6 +1015,9 @@ static int tftp_read(struct file *f, void *buf, size_t insize)
 
 	pr_vdebug("%s %zu\n", __func__, insize);
 
+	if (priv->rx_poller.registered)
+		return tftp_read_pipelined(priv, buf, insize);
+
 	while (insize) {
 		now = kfifo_get(priv->fifo, buf, insize);
 		outsize += now;
@@ -1105,7 +1255,15 @@ static struct fs_driver tftp_driver = {
 static int tftp_init(void)
 {
 	globalvar_add_simple_int("tftp.windowsize", &g_tftp_window_size, "%u");
+	globalvar_add_simple_int("tftp.blocksize", &g_tftp_block_size, "%u");
+	globalvar_add_simple_int("tftp.pipeline", &g_tftp_pipeline, "%u");
 
 	return register_fs_driver(&tftp_driver);
 }
 coredevice_initcall(tftp_init);
+
+BAREBOX_MAGICVAR(global.tftp.windowsize, "TFTP windowsize (RFC 7440) requested from the server");
+BAREBOX_MAGICVAR(global.tftp.blocksize,
+		 "TFTP blksize (RFC 2348) requested for downloads, above 1432 needs IP fragment reassembly");
+BAREBOX_MAGICVAR(global.tftp.pipeline,
+		 "Number of TFTP windows received ahead of the reader by a poller (0: disabled)");
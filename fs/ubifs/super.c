@@ -30,6 +30,7 @@
 #include <init.h>
 #include <fs.h>
 #include <malloc.h>
+#include <parseopt.h>
 #include <linux/bug.h>
 #include <linux/log2.h>
 #include <linux/stat.h>
@@ -691,10 +692,26 @@ static void destroy_journal(struct ubifs_info *c)
 	free_buds(c);
 }
 
-/*
- * removed in barebox
-static void bu_init(struct ubifs_info *c)
+/**
+ * bu_init - initialize bulk-read information.
+ * @c: UBIFS file-system description object
  */
+static void bu_init(struct ubifs_info *c)
+{
+	ubifs_assert(c, c->bulk_read == 1);
+
+	if (c->bu.buf)
+		return; /* Already initialized */
+
+	c->bu.buf = kmalloc(c->max_bu_buf_len, GFP_KERNEL | __GFP_NOWARN);
+	if (!c->bu.buf) {
+		/* Just disable bulk-read */
+		ubifs_warn(c, "cannot allocate %d bytes of memory for bulk-read, disabling it",
+			   c->max_bu_buf_len);
+		c->bulk_read = 0;
+		return;
+	}
+}
 
 /*
  * removed in barebox
@@ -850,6 +867,9 @@ static int mount_ubifs(struct ubifs_info *c)
 		/* c->lst.taken_empty_lebs is always 0 in ro implementation */
 	}
 
+	if (c->bulk_read == 1)
+		bu_init(c);
+
 	c->mounting = 0;
 
 	ubifs_msg(c, "UBIFS: mounted UBI device %d, volume %d, name \"%s\"%s",
@@ -1217,12 +1237,17 @@ int ubifs_get_super(struct device *dev, struct ubi_volume_desc *ubi,
 	struct fs_device *fsdev = dev_to_fs_device(dev);
 	struct super_block *sb;
 	struct ubifs_info *c;
+	bool no_bulk_read;
 	int err;
 
 	sb = &fsdev->sb;
 	c = alloc_ubifs_info(ubi);
 
 	c->dev = dev;
+
+	/* Unlike Linux, default to bulk-read, there is no page cache to fill */
+	parseopt_b(fsdev->options, "no_bulk_read", &no_bulk_read);
+	c->bulk_read = !no_bulk_read;
 	sb->s_fs_info = c;
 	strncpy(sb->s_id, dev->name, sizeof(sb->s_id));
 
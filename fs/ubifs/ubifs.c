@@ -286,23 +286,13 @@ int __init ubifs_compressors_init(void)
 
 /* file.c */
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+static int decompress_block(struct inode *inode, void *addr,
+			    unsigned int block, struct ubifs_data_node *dn)
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(c, le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -333,6 +323,92 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return decompress_block(inode, addr, block, dn);
+}
+
+/*
+ * Read up to @nblocks full blocks starting at @block directly into @addr.
+ * Data nodes stored back to back in one LEB are read with a single UBI read
+ * and decompressed in place. Returns the number of blocks read or a negative
+ * error code.
+ */
+static int bulk_read_blocks(struct inode *inode, void *addr, unsigned int block,
+			    unsigned int nblocks)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	struct bu_info *bu = &c->bu;
+	unsigned int i, b, done = 0, cnt;
+	void *dn;
+	int err;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+
+	/* Don't read nodes beyond the requested range */
+	cnt = bu->cnt;
+	while (bu->cnt &&
+	       key_block(c, &bu->zbranch[bu->cnt - 1].key) >= block + nblocks)
+		bu->cnt--;
+
+	if (bu->cnt) {
+		err = ubifs_tnc_bulk_read(c, bu);
+		if (err)
+			return err;
+	}
+
+	dn = bu->buf;
+	for (i = 0; i < bu->cnt; i++) {
+		b = key_block(c, &bu->zbranch[i].key) - block;
+
+		/* Blocks between two data nodes are holes */
+		memset(addr + done * UBIFS_BLOCK_SIZE, 0,
+		       (b - done) * UBIFS_BLOCK_SIZE);
+
+		err = decompress_block(inode, addr + b * UBIFS_BLOCK_SIZE,
+				       block + b, dn);
+		if (err)
+			return err;
+
+		dn += ALIGN(bu->zbranch[i].len, 8);
+		done = b + 1;
+	}
+
+	/*
+	 * Without further data nodes in the requested range, the rest of it
+	 * is a hole. If the first block has no data node, it's a hole, too.
+	 */
+	if (bu->eof || bu->cnt < cnt) {
+		memset(addr + done * UBIFS_BLOCK_SIZE, 0,
+		       (nblocks - done) * UBIFS_BLOCK_SIZE);
+		done = nblocks;
+	} else if (!done) {
+		memset(addr, 0, UBIFS_BLOCK_SIZE);
+		done = 1;
+	}
+
+	return done;
+}
+
 struct ubifs_file {
 	struct inode *inode;
 	void *buf;
@@ -385,6 +461,7 @@ static int ubifs_get_block(struct ubifs_file *uf, unsigned int pos)
 int ubifs_read(struct file *f, void *buf, size_t insize)
 {
 	struct ubifs_file *uf = f->private_data;
+	struct ubifs_info *c = uf->inode->i_sb->s_fs_info;
 	unsigned int pos = f->f_pos;
 	unsigned int ofs;
 	unsigned int now;
@@ -408,14 +485,31 @@ int ubifs_read(struct file *f, void *buf, size_t insize)
 
 	/* Do full blocks */
 	while (size >= UBIFS_BLOCK_SIZE) {
-		ret = ubifs_get_block(uf, pos);
-		if (ret)
-			return ret;
+		now = 0;
+
+		if (c->bulk_read) {
+			ret = bulk_read_blocks(uf->inode, buf,
+					       pos / UBIFS_BLOCK_SIZE,
+					       size / UBIFS_BLOCK_SIZE);
+			if (ret < 0)
+				ubifs_warn(c, "ignoring error %d and skipping bulk-read",
+					   ret);
+			else
+				now = ret * UBIFS_BLOCK_SIZE;
+		}
+
+		if (!now) {
+			ret = ubifs_get_block(uf, pos);
+			if (ret)
+				return ret;
+
+			memcpy(buf, uf->buf, UBIFS_BLOCK_SIZE);
+			now = UBIFS_BLOCK_SIZE;
+		}
 
-		memcpy(buf, uf->buf, UBIFS_BLOCK_SIZE);
-		size -= UBIFS_BLOCK_SIZE;
-		pos += UBIFS_BLOCK_SIZE;
-		buf += UBIFS_BLOCK_SIZE;
+		size -= now;
+		pos += now;
+		buf += now;
 	}
 
 	/* And the rest */
@@ -29,6 +29,11 @@
 #define ATA_CMD_WRITE		0x30
 #define ATA_CMD_PIO_WRITE_EXT	0x34
 #define ATA_CMD_WRITE_EXT	0x35
+#define ATA_CMD_READ_LOG_EXT	0x2F
+#define ATA_CMD_FPDMA_READ	0x60
+#define ATA_CMD_FPDMA_WRITE	0x61
+
+#define ATA_LOG_SATA_NCQ	0x10
 
 /* drive's status flags */
 #define ATA_STATUS_BUSY		(1 << 7)
@@ -93,6 +98,19 @@ static inline int ata_id_has_lba48(const uint16_t *id)
 	return id[ATA_ID_COMMAND_SET_2] & (1 << 10);
 }
 
+static inline int ata_id_has_ncq(const uint16_t *id)
+{
+	return id[ATA_ID_SATA_CAPAB_1] & (1 << 8);
+}
+
+static inline unsigned int ata_id_queue_depth(const uint16_t *id)
+{
+	return (id[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1;
+}
+
+/* size limit for queued requests, the FPDMA sector count has 16 bits */
+#define ATA_NCQ_MAX_BLOCKS	2048	/* 1 MiB */
+
 /** addresses of each individual IDE drive register */
 struct ata_ioports {
 	void __iomem *cmd_addr;
@@ -124,6 +142,9 @@ struct ata_port_operations {
 	int (*write)(struct ata_port *port, const void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*read_id)(struct ata_port *port, void *buf);
 	int (*reset)(struct ata_port *port);
+	/* native command queueing, see block_device_ops */
+	int (*submit)(struct ata_port *port, struct blk_request *req);
+	int (*poll)(struct ata_port *port);
 };
 
 struct ata_port {
@@ -138,6 +159,7 @@ struct ata_port {
 	bool initialized;
 	bool ahci;
 	int probe;
+	unsigned int queue_depth;	/* commands the controller can queue */
 };
 
 struct ide_port {
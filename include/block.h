@@ -2,6 +2,7 @@
 #ifndef __BLOCK_H
 #define __BLOCK_H
 
+#include <clock.h>
 #include <driver.h>
 #include <linux/list.h>
 #include <linux/types.h>
@@ -9,12 +10,40 @@
 struct block_device;
 struct file_list;
 
+/*
+ * An asynchronous block request. The submitter fills in everything up to
+ * @priv, the request then belongs to the driver until it is passed to
+ * blk_request_complete(). @status is -EINPROGRESS while the request is in
+ * flight and the final result afterwards.
+ */
+struct blk_request {
+	struct block_device *blk;
+	bool write;
+	sector_t block;
+	blkcnt_t num_blocks;
+	void *buf;
+	void (*complete)(struct blk_request *req);	/* optional */
+	void *priv;
+
+	int status;
+	u64 start;		/* submission time, for driver timeouts */
+	unsigned int tag;	/* driver private */
+};
+
 struct block_device_ops {
 	int (*read)(struct block_device *, void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*write)(struct block_device *, const void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*erase)(struct block_device *blk, sector_t block, blkcnt_t num_blocks);
 	int (*flush)(struct block_device *);
 	char *(*get_root)(struct block_device *blk, const struct cdev *partcdev);
+	/*
+	 * Drivers that can have several requests in flight implement
+	 * submit and poll instead of read and write. submit returns -EBUSY
+	 * when the queue is full, poll reaps finished requests and returns
+	 * how many it completed.
+	 */
+	int (*submit)(struct block_device *blk, struct blk_request *req);
+	int (*poll)(struct block_device *blk);
 };
 
 struct chunk;
@@ -35,6 +64,10 @@ const char *blk_type_str(enum blk_type);
 
 struct block_device_stats {
 	blkcnt_t read_sectors;
+	blkcnt_t direct_read_sectors;	/* subset of read_sectors bypassing the cache */
+	blkcnt_t readahead_sectors;	/* subset of read_sectors read ahead */
+	u64 cache_hits;
+	u64 cache_misses;
 	blkcnt_t write_sectors;
 	blkcnt_t erase_sectors;
 };
@@ -48,12 +81,22 @@ struct block_device {
 	u8 rootwait:1;
 	u8 removable:1;
 	blkcnt_t num_blocks;
-	int rdbufsize;
+	int rdbufsize;	/* cache chunk size in blocks, may be set by the driver */
 	int blkmask;
+	unsigned int cache_chunks;	/* number of cached chunks, may be set by the driver */
+	unsigned int queue_depth;	/* max. requests in flight, set by queueing drivers */
+	blkcnt_t max_request_blocks;	/* max. blocks per request, 0 for no limit */
 
 	sector_t discard_start;
 	blkcnt_t discard_size;
 
+	struct chunk *chunks;
+	void *cache_data;
+	struct hlist_head *chunk_hash;
+	unsigned int chunk_hash_bits;
+	sector_t ra_next;	/* next chunk expected by a sequential reader */
+	unsigned int ra_chunks;	/* current read-ahead window in chunks */
+
 	struct list_head buffered_blocks;
 	struct list_head idle_blocks;
 
@@ -78,6 +121,36 @@ int blockdevice_unregister(struct block_device *blk);
 int block_read(struct block_device *blk, void *buf, sector_t block, blkcnt_t num_blocks);
 int block_write(struct block_device *blk, void *buf, sector_t block, blkcnt_t num_blocks);
 
+static inline void blk_request_init(struct blk_request *req, struct block_device *blk,
+				    bool write, void *buf, sector_t block,
+				    blkcnt_t num_blocks)
+{
+	*req = (struct blk_request) {
+		.blk = blk,
+		.write = write,
+		.block = block,
+		.num_blocks = num_blocks,
+		.buf = buf,
+	};
+}
+
+static inline bool blk_request_pending(const struct blk_request *req)
+{
+	return req->status == -EINPROGRESS;
+}
+
+static inline bool blk_request_timed_out(const struct blk_request *req, u64 timeout_ns)
+{
+	return is_timeout_non_interruptible(req->start, timeout_ns);
+}
+
+int blk_submit(struct block_device *blk, struct blk_request *req);
+int blk_poll(struct block_device *blk);
+int blk_wait(struct blk_request *req);
+int blk_rw_sync(struct block_device *blk, bool write, void *buf,
+		sector_t block, blkcnt_t num_blocks);
+void blk_request_complete(struct blk_request *req, int status);
+
 static inline int block_flush(struct block_device *blk)
 {
 	return cdev_flush(&blk->cdev);
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __BOOTTRACE_H
+#define __BOOTTRACE_H
+
+#include <clock.h>
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+enum boottrace_cat {
+	BOOTTRACE_INITCALL,
+	BOOTTRACE_PROBE,
+	BOOTTRACE_POLLER,
+	BOOTTRACE_BTHREAD,
+	BOOTTRACE_BLOCK,
+	BOOTTRACE_BOOTM,
+	BOOTTRACE_NR_CATS,
+};
+
+#ifdef CONFIG_BOOTTRACE
+/*
+ * Events are recorded as complete spans: take a timestamp with
+ * boottrace_start() before the traced operation and pass it to
+ * boottrace_add() afterwards.
+ */
+static inline u64 boottrace_start(void)
+{
+	return get_time_ns();
+}
+
+void boottrace_add(enum boottrace_cat cat, u64 start, const char *name);
+__printf(3, 4)
+void boottrace_addf(enum boottrace_cat cat, u64 start, const char *fmt, ...);
+
+ssize_t boottrace_format(char *buf, size_t size);
+void boottrace_clear(void);
+#else
+static inline u64 boottrace_start(void)
+{
+	return 0;
+}
+
+static inline void boottrace_add(enum boottrace_cat cat, u64 start,
+				 const char *name)
+{
+}
+
+static inline __printf(3, 4)
+void boottrace_addf(enum boottrace_cat cat, u64 start, const char *fmt, ...)
+{
+}
+#endif
+
+#endif /* __BOOTTRACE_H */
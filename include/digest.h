@@ -39,6 +39,14 @@ enum hash_algo {
 	HASH_ALGO__LAST
 };
 
+/* Sizes for which digest drivers are compared by digest_benchmark() */
+enum digest_size_class {
+	DIGEST_SIZE_SMALL,	/* below 4 KiB, e.g. hash tree nodes */
+	DIGEST_SIZE_MEDIUM,	/* below 256 KiB */
+	DIGEST_SIZE_LARGE,	/* whole images, or size unknown */
+	DIGEST_SIZE_CLASSES
+};
+
 struct crypto_alg {
 	const char *name;
 	const char *driver_name;
@@ -64,9 +72,24 @@ struct digest_algo {
 	unsigned int length;
 	unsigned int ctx_length;
 
+	/* throughput measured by digest_benchmark() in KiB/s, 0 if unknown */
+	unsigned int bench_kbps[DIGEST_SIZE_CLASSES];
+
 	struct list_head list;
 };
 
+/**
+ * struct digest_stream - an independent buffer to be hashed by digest_multi()
+ * @data: data to hash
+ * @len: length of @data, must not be 0
+ * @md: returns the digest of @data
+ */
+struct digest_stream {
+	const void *data;
+	size_t len;
+	u8 *md;
+};
+
 struct digest {
 	struct digest_algo *algo;
 	void *ctx;
@@ -82,6 +105,7 @@ void digest_algo_unregister(struct digest_algo *d);
 void digest_algo_prints(const char *prefix);
 
 struct digest *digest_alloc(const char *name);
+struct digest *digest_alloc_size(const char *name, size_t size);
 struct digest *digest_alloc_by_algo(enum hash_algo);
 void digest_free(struct digest *d);
 
@@ -95,6 +119,11 @@ int digest_file(struct digest *d, const char *filename,
 int digest_file_by_name(const char *algo, const char *filename,
 			unsigned char *hash,
 			const unsigned char *sig);
+int digest_blocks(const char *algo, const void *buf, size_t len,
+		  size_t blocksize, u8 *hashes);
+int digest_multi(const char *algo, const struct digest_stream *streams,
+		 unsigned int nstreams);
+int digest_benchmark(const char *name);
 #else
 static inline struct digest *digest_alloc(const char *name)
 {
@@ -6,6 +6,7 @@
 #include <common.h>
 #include <file-list.h>
 #include <net.h>
+#include <work.h>
 
 #define FASTBOOT_MAX_CMD_LEN  64
 
@@ -19,6 +20,8 @@
  */
 #define FASTBOOT_CMD_FALLTHROUGH	1
 
+struct fastboot_stream;
+
 struct fastboot {
 	int (*write)(struct fastboot *fb, const char *buf, unsigned int n);
 	void (*start_download)(struct fastboot *fb);
@@ -29,6 +32,8 @@ struct fastboot {
 			 const char *filename, size_t len);
 	int download_fd;
 	char *tempname;
+	struct fastboot_stream *stream;	/* sparse download written on the fly */
+	struct work_queue stream_wq;
 
 	bool active;
 
@@ -13,6 +13,8 @@
 struct fit_handle {
 	const void *fit;
 	void *fit_alloc;
+	/* kept open while @fit points into the memmapped file */
+	int fit_fd;
 	size_t size;
 	char *filename;
 
@@ -64,4 +64,26 @@ int sparse_image_read(struct sparse_image_ctx *si, void *buf,
 void sparse_image_close(struct sparse_image_ctx *si);
 loff_t sparse_image_size(struct sparse_image_ctx *si);
 
+/**
+ * struct sparse_stream_ops - consumer of an incrementally parsed sparse image
+ * @write:	write @len bytes of output data at @pos. Raw chunk data is
+ *		passed through in the pieces it was fed in.
+ * @dont_care:	optional, called for "don't care" chunks between other chunks.
+ *		Leading and trailing ones are not reported, in images split by
+ *		the host they stand for data written by the other parts.
+ */
+struct sparse_stream_ops {
+	int (*write)(void *priv, const void *buf, size_t len, loff_t pos);
+	int (*dont_care)(void *priv, loff_t len, loff_t pos);
+};
+
+struct sparse_stream_ctx;
+
+struct sparse_stream_ctx *sparse_stream_new(const struct sparse_stream_ops *ops,
+					    void *priv);
+int sparse_stream_feed(struct sparse_stream_ctx *ss, const void *buf, size_t len);
+int sparse_stream_finish(struct sparse_stream_ctx *ss);
+loff_t sparse_stream_size(struct sparse_stream_ctx *ss);
+void sparse_stream_free(struct sparse_stream_ctx *ss);
+
 #endif /* _IMAGE_SPARSE_H */
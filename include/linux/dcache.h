@@ -73,6 +73,9 @@ struct dentry {
 	 */
 	struct list_head d_child;       /* child of parent list */
 	struct list_head d_subdirs;	/* our children */
+	struct hlist_head *d_children_hash; /* name index of d_subdirs */
+	unsigned int d_children_hash_bits;
+	unsigned int d_nr_children;
 	unsigned long d_time;		/* used by d_revalidate */
 	struct super_block *d_sb;	/* The root of the dentry tree */
 	void *d_fsdata;			/* fs-specific data */
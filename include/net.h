@@ -77,6 +77,12 @@ struct eth_device {
 	unsigned int global_mode;
 
 	uint64_t last_link_check;
+
+	/* statistics, drivers count the received frames they have to drop */
+	uint32_t rx_packets;
+	uint32_t rx_dropped;
+	uint32_t tx_packets;
+	uint32_t tx_errors;
 };
 
 #define dev_to_edev(d) container_of(d, struct eth_device, dev)
@@ -157,6 +163,7 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
@@ -185,6 +192,23 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+struct tcphdr {
+	uint16_t	th_sport;	/* source port */
+	uint16_t	th_dport;	/* destination port */
+	uint32_t	th_seq;		/* sequence number */
+	uint32_t	th_ack;		/* acknowledgment number */
+	uint8_t		th_off;		/* data offset in 32bit words, upper 4 bits */
+	uint8_t		th_flags;
+#define TH_FIN		0x01
+#define TH_SYN		0x02
+#define TH_RST		0x04
+#define TH_PSH		0x08
+#define TH_ACK		0x10
+	uint16_t	th_win;		/* window */
+	uint16_t	th_sum;		/* checksum */
+	uint16_t	th_urp;		/* urgent pointer */
+} __attribute__ ((packed));
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -249,6 +273,10 @@ struct icmphdr {
  */
 #define PKTSIZE			1536
 
+/* largest UDP payload of a single frame, resp. of a reassembled datagram */
+#define NET_UDP_FRAME_PAYLOAD	(PKTSIZE - ETHER_HDR_SIZE - 20 - 8)
+#define NET_UDP_MAX_PAYLOAD	(0xffff - 20 - 8)
+
 /**********************************************************************/
 /*
  *	Globals.
@@ -545,26 +573,25 @@ struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
 	struct udphdr *udp;
+	struct tcphdr *tcp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
 	unsigned char *packet;
 	struct list_head list;
 	rx_handler_f *handler;
 	int proto;
+	unsigned int rx_size;
 	void *priv;
 };
 
-static inline char *net_alloc_packet(void)
-{
-	return dma_alloc(PKTSIZE);
-}
-
-static inline void net_free_packet(char *pkt)
-{
-	return dma_free(pkt);
-}
+char *net_alloc_packet(void);
+char *net_alloc_rx_packet(void);
+void net_free_packet(char *pkt);
+bool net_packet_get(const void *pkt);
+char *net_packet_rx_recycle(char *pkt);
 
 int net_alloc_packets(void **packets, int count);
+int net_alloc_rx_packets(void **packets, int count);
 void net_free_packets(void **packets, unsigned count);
 
 struct net_connection *net_udp_new(IPaddr_t dest, uint16_t dport,
@@ -577,8 +604,27 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 		void *ctx);
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+
 void net_unregister(struct net_connection *con);
 
+int net_udp_set_rx_size(struct net_connection *con, unsigned int size);
+
+#ifdef CONFIG_NET_IP_REASSEMBLY
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len);
+void net_ip_defrag_flush(void);
+#else
+static inline unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	return NULL;
+}
+
+static inline void net_ip_defrag_flush(void)
+{
+}
+#endif
+
 static inline int net_udp_bind(struct net_connection *con, uint16_t sport)
 {
 	con->udp->uh_sport = ntohs(sport);
@@ -591,9 +637,23 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 		sizeof(struct udphdr);
 }
 
+int net_ip_send(struct net_connection *con, int len);
 int net_udp_send(struct net_connection *con, int len);
 int net_icmp_send(struct net_connection *con, int len);
 
+#ifdef CONFIG_NET_TCP
+struct net_connection *net_tcp_connect(IPaddr_t dest, uint16_t dport);
+int net_tcp_write(struct net_connection *con, const void *buf, size_t len);
+int net_tcp_read(struct net_connection *con, void *buf, size_t len);
+void net_tcp_close(struct net_connection *con);
+void net_tcp_abort(struct net_connection *con);
+void net_tcp_poll(void);
+#else
+static inline void net_tcp_poll(void)
+{
+}
+#endif
+
 void led_trigger_network(enum led_trigger trigger);
 
 #define IFUP_FLAG_FORCE		(1 << 0)
@@ -193,6 +193,7 @@ extern struct device_node *of_find_node_by_path(const char *path);
 extern struct device_node *of_find_node_by_phandle(phandle phandle);
 extern struct device_node *of_find_node_by_phandle_from(phandle phandle,
 	struct device_node *root);
+extern void of_phandle_cache_invalidate(void);
 extern struct device_node *of_find_node_by_type(struct device_node *from,
 	const char *type);
 extern struct device_node *of_find_compatible_node(struct device_node *from,
@@ -996,6 +997,10 @@ static inline struct device_node *of_find_node_by_phandle_from(phandle phandle,
 	return NULL;
 }
 
+static inline void of_phandle_cache_invalidate(void)
+{
+}
+
 static inline struct device_node *of_find_compatible_node(
 						struct device_node *from,
 						const char *type,
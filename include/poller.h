@@ -7,18 +7,43 @@
 #define POLLER_H
 
 #include <linux/list.h>
+#include <linux/limits.h>
 #include <linux/types.h>
 
+/* deadline of a poller that has nothing to do until it is woken up again */
+#define POLLER_DEADLINE_NONE	U64_MAX
+
+/**
+ * struct poller_struct - a function called from the scheduler
+ * @func: the poll function
+ * @registered: set while the poller is registered
+ * @overtime: number of calls that exceeded the maximum runtime
+ * @list: entry in the list of pollers, sorted by @deadline
+ * @name: name of the poller
+ * @deadline: time in ns at which the poller is due next, 0 to call it
+ *            on every scheduler invocation
+ * @period: if non-zero, @deadline is advanced by this many ns after
+ *          every call
+ * @calls: number of times the poller has been called
+ * @runtime: accumulated runtime of the poller in ns
+ * @max_runtime: longest single call of the poller in ns
+ */
 struct poller_struct {
 	void (*func)(struct poller_struct *poller);
 	u16 registered:1;
 	u16 overtime;
 	struct list_head list;
 	const char *name;
+	uint64_t deadline;
+	uint64_t period;
+	uint64_t calls;
+	uint64_t runtime;
+	uint64_t max_runtime;
 };
 
 int poller_register(struct poller_struct *poller, const char *name);
 int poller_unregister(struct poller_struct *poller);
+void poller_set_deadline(struct poller_struct *poller, uint64_t deadline);
 
 struct poller_async;
 
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __SMP_H
+#define __SMP_H
+
+#include <linux/types.h>
+
+/*
+ * A job run by smp_run_jobs(). @job is the index of the job, @cpu the index
+ * of the CPU running it, 0 being the boot CPU and smp_num_cpus() - 1 the
+ * highest one. Jobs on secondary CPUs run concurrently with the rest of
+ * barebox, so they may only touch memory they own: no malloc, no console
+ * output, no drivers.
+ */
+typedef int (*smp_job_fn)(void *data, unsigned int job, unsigned int cpu);
+
+#ifdef CONFIG_SMP_WORKERS
+unsigned int smp_num_cpus(void);
+int smp_run_jobs(smp_job_fn fn, void *data, unsigned int njobs);
+void smp_workers_stop(void);
+#else
+static inline unsigned int smp_num_cpus(void)
+{
+	return 1;
+}
+
+static inline int smp_run_jobs(smp_job_fn fn, void *data, unsigned int njobs)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < njobs; i++) {
+		ret = fn(data, i, 0);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static inline void smp_workers_stop(void)
+{
+}
+#endif
+
+#endif /* __SMP_H */
@@ -2,6 +2,10 @@
 #ifndef __UNCOMPRESS_H
 #define __UNCOMPRESS_H
 
+#include <linux/types.h>
+
+struct digest;
+
 int uncompress(unsigned char *inbuf, long len,
 	   long(*fill)(void*, unsigned long),
 	   long(*flush)(void*, unsigned long),
@@ -21,6 +25,10 @@ int uncompress_buf_to_fd(const void *input, size_t input_len,
 ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 			      void **buf, void(*error_fn)(char *x));
 
+ssize_t uncompress_buf_to_buf_digest(const void *input, size_t input_len,
+				     void **buf, struct digest *digest,
+				     void(*error_fn)(char *x));
+
 void uncompress_err_stdout(char *);
 
 #endif /* __UNCOMPRESS_H */
@@ -4,6 +4,8 @@
 #define __WORK_H
 
 #include <linux/list.h>
+#include <linux/limits.h>
+#include <linux/minmax.h>
 #include <clock.h>
 
 struct work_struct {
@@ -18,12 +20,16 @@ struct work_queue {
 
 	struct list_head list;
 	struct list_head work;
+
+	/* earliest time any queued work is due, 0 when some work is ready */
+	uint64_t next_timeout;
 };
 
 static inline void wq_queue_work(struct work_queue *wq, struct work_struct *work)
 {
 	work->delayed = false;
 	list_add_tail(&work->list, &wq->work);
+	wq->next_timeout = 0;
 }
 
 static inline void wq_queue_delayed_work(struct work_queue *wq,
@@ -33,6 +39,7 @@ static inline void wq_queue_delayed_work(struct work_queue *wq,
 	work->timeout = get_time_ns() + delay_ns;
 	work->delayed = true;
 	list_add_tail(&work->list, &wq->work);
+	wq->next_timeout = min(wq->next_timeout, work->timeout);
 }
 
 void wq_register(struct work_queue *wq);
@@ -40,5 +47,6 @@ void wq_unregister(struct work_queue *wq);
 
 void wq_do_all_works(void);
 void wq_cancel_work(struct work_queue *wq);
+void wq_flush(struct work_queue *wq);
 
 #endif /* __WORK_H */
@@ -42,7 +42,7 @@
  *
  * Algorithmic details:
  *
- * Encoding is performed by processing 32 input bits in parallel, using 4
+ * Encoding is performed by processing 64 input bits in parallel, using 8
  * remainder lookup tables.
  *
  * The final stage of decoding involves the following internal steps:
@@ -145,6 +145,22 @@ static void bch_encode_unaligned(struct bch_control *bch,
 	}
 }
 
+/*
+ * read a 32-bit word of input data in big-endian format
+ */
+static inline uint32_t load_data32(struct bch_control *bch, const uint32_t *p)
+{
+	uint32_t w = cpu_to_be32(*p);
+
+	if (bch->swap_bits)
+		w = (u32)bitrev8(w) |
+		    ((u32)bitrev8(w >> 8) << 8) |
+		    ((u32)bitrev8(w >> 16) << 16) |
+		    ((u32)bitrev8(w >> 24) << 24);
+
+	return w;
+}
+
 /*
  * convert ecc bytes to aligned, zero-padded 32-bit ecc words
  */
@@ -209,15 +225,19 @@ void bch_encode(struct bch_control *bch, const uint8_t *data,
 	const unsigned int l = BCH_ECC_WORDS(bch)-1;
 	unsigned int i, mlen;
 	unsigned long m;
-	uint32_t w, r[BCH_ECC_MAX_WORDS];
+	uint32_t w, w1, r[BCH_ECC_MAX_WORDS+2];
 	const size_t r_bytes = BCH_ECC_WORDS(bch) * sizeof(*r);
 	const uint32_t * const tab0 = bch->mod8_tab;
 	const uint32_t * const tab1 = tab0 + 256*(l+1);
 	const uint32_t * const tab2 = tab1 + 256*(l+1);
 	const uint32_t * const tab3 = tab2 + 256*(l+1);
-	const uint32_t *pdata, *p0, *p1, *p2, *p3;
+	const uint32_t * const tab4 = tab3 + 256*(l+1);
+	const uint32_t * const tab5 = tab4 + 256*(l+1);
+	const uint32_t * const tab6 = tab5 + 256*(l+1);
+	const uint32_t * const tab7 = tab6 + 256*(l+1);
+	const uint32_t *pdata, *p0, *p1, *p2, *p3, *p4, *p5, *p6, *p7;
 
-	if (WARN_ON(r_bytes > sizeof(r)))
+	if (WARN_ON(r_bytes + 2*sizeof(*r) > sizeof(r)))
 		return;
 
 	if (ecc) {
@@ -242,6 +262,8 @@ void bch_encode(struct bch_control *bch, const uint8_t *data,
 	data += 4*mlen;
 	len  -= 4*mlen;
 	memcpy(r, bch->ecc_buf, r_bytes);
+	/* the 64-bit loop below shifts these in beyond the last ecc word */
+	r[l+1] = r[l+2] = 0;
 
 	/*
 	 * split each 32-bit word into 4 polynomials of weight 8 as follows:
@@ -253,16 +275,30 @@ void bch_encode(struct bch_control *bch, const uint8_t *data,
 	 *           yyyyyyyy  00000000  00000000  mod g = r2 (precomputed)
 	 * xxxxxxxx  00000000  00000000  00000000  mod g = r3 (precomputed)
 	 * xxxxxxxx  yyyyyyyy  zzzzzzzz  tttttttt  mod g = r0^r1^r2^r3
+	 *
+	 * Two words are processed at once: tables 4 to 7 hold the remainders of
+	 * the bytes of the first word, which are 32 bits further away from the
+	 * end of the input.
 	 */
-	while (mlen--) {
-		/* input data is read in big-endian format */
-		w = cpu_to_be32(*pdata++);
-		if (bch->swap_bits)
-			w = (u32)swap_bits(bch, w) |
-			    ((u32)swap_bits(bch, w >> 8) << 8) |
-			    ((u32)swap_bits(bch, w >> 16) << 16) |
-			    ((u32)swap_bits(bch, w >> 24) << 24);
-		w ^= r[0];
+	for (; mlen >= 2; mlen -= 2) {
+		w = load_data32(bch, pdata++) ^ r[0];
+		w1 = load_data32(bch, pdata++) ^ r[1];
+		p0 = tab0 + (l+1)*((w1 >>  0) & 0xff);
+		p1 = tab1 + (l+1)*((w1 >>  8) & 0xff);
+		p2 = tab2 + (l+1)*((w1 >> 16) & 0xff);
+		p3 = tab3 + (l+1)*((w1 >> 24) & 0xff);
+		p4 = tab4 + (l+1)*((w >>  0) & 0xff);
+		p5 = tab5 + (l+1)*((w >>  8) & 0xff);
+		p6 = tab6 + (l+1)*((w >> 16) & 0xff);
+		p7 = tab7 + (l+1)*((w >> 24) & 0xff);
+
+		for (i = 0; i <= l; i++)
+			r[i] = r[i+2]^p0[i]^p1[i]^p2[i]^p3[i]^
+			       p4[i]^p5[i]^p6[i]^p7[i];
+	}
+
+	if (mlen) {
+		w = load_data32(bch, pdata++) ^ r[0];
 		p0 = tab0 + (l+1)*((w >>  0) & 0xff);
 		p1 = tab1 + (l+1)*((w >>  8) & 0xff);
 		p2 = tab2 + (l+1)*((w >> 16) & 0xff);
@@ -1043,16 +1079,23 @@ int bch_decode(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		for (i = 0, sum = 0; i < (int)ecc_words; i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found */
+			return 0;
+
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
+	} else {
+		for (i = 0, sum = 0; i < 2*GF_T(bch); i++)
+			sum |= syn[i];
+		if (!sum)
+			/* all syndromes are zero, no error found */
+			return 0;
 	}
 
 	err = compute_error_locator_polynomial(bch, syn);
@@ -1118,7 +1161,9 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	const int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
 	const int ecclen = DIV_ROUND_UP(bch->ecc_bits, 32);
 
-	memset(bch->mod8_tab, 0, 4*256*l*sizeof(*bch->mod8_tab));
+	const uint32_t *src, *p0, *p1, *p2, *p3;
+
+	memset(bch->mod8_tab, 0, 8*256*l*sizeof(*bch->mod8_tab));
 
 	for (i = 0; i < 256; i++) {
 		/* p(X)=i is a small polynomial of weight <= 8 */
@@ -1139,6 +1184,25 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 			}
 		}
 	}
+
+	/*
+	 * tables 4-7 are tables 0-3 shifted by another 32 bits, i.e. what
+	 * encoding a zero word after them yields
+	 */
+	for (b = 4; b < 8; b++) {
+		for (i = 0; i < 256; i++) {
+			src = bch->mod8_tab + ((b-4)*256+i)*l;
+			tab = bch->mod8_tab + (b*256+i)*l;
+			p0 = bch->mod8_tab + (0*256+((src[0] >>  0) & 0xff))*l;
+			p1 = bch->mod8_tab + (1*256+((src[0] >>  8) & 0xff))*l;
+			p2 = bch->mod8_tab + (2*256+((src[0] >> 16) & 0xff))*l;
+			p3 = bch->mod8_tab + (3*256+((src[0] >> 24) & 0xff))*l;
+
+			for (j = 0; j < l; j++)
+				tab[j] = ((j+1 < l) ? src[j+1] : 0)^
+					 p0[j]^p1[j]^p2[j]^p3[j];
+		}
+	}
 }
 
 /*
@@ -1340,7 +1404,7 @@ struct bch_control *bch_init(int m, int t, unsigned int prim_poly,
 	bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
-	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+	bch->mod8_tab  = bch_alloc(words*2048*sizeof(*bch->mod8_tab), &err);
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
@@ -243,3 +243,289 @@ void sparse_image_close(struct sparse_image_ctx *si)
 	close(si->fd);
 	free(si);
 }
+
+/*
+ * Streaming parser: unlike the functions above this does not need the image
+ * as a file, it is fed the image in arbitrary pieces as they arrive.
+ */
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_DONE,
+};
+
+#define SPARSE_STREAM_FILL_BUF_SIZE	SZ_64K
+
+struct sparse_stream_ctx {
+	const struct sparse_stream_ops *ops;
+	void *priv;
+	enum sparse_stream_state state;
+	struct sparse_header sparse;
+	struct chunk_header chunk;
+	size_t hdr_len;		/* bytes of the current header collected */
+	size_t skip;		/* input bytes to skip before the next state */
+	unsigned int processed_chunks;
+	loff_t pos;
+	uint64_t remaining;	/* raw output bytes left in the current chunk */
+	uint32_t fill_val;
+	void *fill_buf;
+};
+
+struct sparse_stream_ctx *sparse_stream_new(const struct sparse_stream_ops *ops,
+					    void *priv)
+{
+	struct sparse_stream_ctx *ss;
+
+	ss = xzalloc(sizeof(*ss));
+	ss->ops = ops;
+	ss->priv = priv;
+	ss->state = SPARSE_STREAM_FILE_HDR;
+
+	return ss;
+}
+
+/* Collect @size bytes in @dst, returns true once complete */
+static bool sparse_stream_collect(struct sparse_stream_ctx *ss, void *dst,
+				  size_t size, const void **buf, size_t *len)
+{
+	size_t now = min(size - ss->hdr_len, *len);
+
+	memcpy(dst + ss->hdr_len, *buf, now);
+	ss->hdr_len += now;
+	*buf += now;
+	*len -= now;
+
+	if (ss->hdr_len < size)
+		return false;
+
+	ss->hdr_len = 0;
+
+	return true;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream_ctx *ss)
+{
+	if (ss->processed_chunks == ss->sparse.total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
+	else
+		ss->state = SPARSE_STREAM_CHUNK_HDR;
+}
+
+static int sparse_stream_file_hdr(struct sparse_stream_ctx *ss)
+{
+	struct sparse_header *sh = &ss->sparse;
+
+	if (!is_sparse_image(sh))
+		return -EINVAL;
+
+	if (sh->file_hdr_sz < sizeof(struct sparse_header) ||
+	    sh->chunk_hdr_sz < sizeof(struct chunk_header) ||
+	    !sh->blk_sz || sh->blk_sz & 3)
+		return -EINVAL;
+
+	ss->skip = sh->file_hdr_sz - sizeof(struct sparse_header);
+	sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+static int sparse_stream_chunk_hdr(struct sparse_stream_ctx *ss)
+{
+	uint64_t chunk_data_sz;
+	uint32_t payload;
+	int ret;
+
+	if (ss->chunk.total_sz < ss->sparse.chunk_hdr_sz)
+		return -EINVAL;
+
+	chunk_data_sz = (uint64_t)ss->sparse.blk_sz * ss->chunk.chunk_sz;
+	payload = ss->chunk.total_sz - ss->sparse.chunk_hdr_sz;
+
+	ss->skip = ss->sparse.chunk_hdr_sz - sizeof(struct chunk_header);
+	ss->processed_chunks++;
+
+	switch (ss->chunk.chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (payload != chunk_data_sz)
+			return -EINVAL;
+
+		ss->remaining = chunk_data_sz;
+		ss->state = SPARSE_STREAM_RAW;
+		if (!ss->remaining)
+			sparse_stream_next_chunk(ss);
+
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->remaining = chunk_data_sz;
+		ss->state = SPARSE_STREAM_FILL;
+
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		if (ss->ops->dont_care && ss->processed_chunks > 1 &&
+		    ss->processed_chunks < ss->sparse.total_chunks) {
+			ret = ss->ops->dont_care(ss->priv, chunk_data_sz, ss->pos);
+			if (ret)
+				return ret;
+		}
+
+		ss->pos += chunk_data_sz;
+		ss->skip += payload;
+		sparse_stream_next_chunk(ss);
+
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->skip += payload;
+		sparse_stream_next_chunk(ss);
+
+		break;
+
+	default:
+		pr_err("Unknown chunk type 0x%04x\n", ss->chunk.chunk_type);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int sparse_stream_fill(struct sparse_stream_ctx *ss)
+{
+	uint32_t *buf32;
+	int ret, i;
+
+	if (!ss->fill_buf) {
+		ss->fill_buf = malloc(SPARSE_STREAM_FILL_BUF_SIZE);
+		if (!ss->fill_buf)
+			return -ENOMEM;
+	}
+
+	buf32 = ss->fill_buf;
+	for (i = 0; i < SPARSE_STREAM_FILL_BUF_SIZE / sizeof(uint32_t); i++)
+		buf32[i] = ss->fill_val;
+
+	while (ss->remaining) {
+		size_t now = min_t(uint64_t, ss->remaining,
+				   SPARSE_STREAM_FILL_BUF_SIZE);
+
+		ret = ss->ops->write(ss->priv, ss->fill_buf, now, ss->pos);
+		if (ret)
+			return ret;
+
+		ss->pos += now;
+		ss->remaining -= now;
+	}
+
+	sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+/**
+ * sparse_stream_feed - feed the next piece of a sparse image to the parser
+ * @ss:		the parser context
+ * @buf:	input data
+ * @len:	length of @buf
+ *
+ * Output data is passed to the consumer as soon as it is available. Returns
+ * 0 for success or a negative error code, in which case the parser can't
+ * continue.
+ */
+int sparse_stream_feed(struct sparse_stream_ctx *ss, const void *buf, size_t len)
+{
+	size_t now;
+	int ret = 0;
+
+	while (len) {
+		if (ss->skip) {
+			now = min(ss->skip, len);
+			ss->skip -= now;
+			buf += now;
+			len -= now;
+			continue;
+		}
+
+		switch (ss->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (sparse_stream_collect(ss, &ss->sparse,
+						  sizeof(ss->sparse), &buf, &len))
+				ret = sparse_stream_file_hdr(ss);
+			break;
+
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (sparse_stream_collect(ss, &ss->chunk,
+						  sizeof(ss->chunk), &buf, &len))
+				ret = sparse_stream_chunk_hdr(ss);
+			break;
+
+		case SPARSE_STREAM_RAW:
+			now = min_t(uint64_t, ss->remaining, len);
+
+			ret = ss->ops->write(ss->priv, buf, now, ss->pos);
+			if (ret)
+				break;
+
+			ss->pos += now;
+			ss->remaining -= now;
+			buf += now;
+			len -= now;
+
+			if (!ss->remaining)
+				sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_FILL:
+			if (sparse_stream_collect(ss, &ss->fill_val,
+						  sizeof(ss->fill_val), &buf, &len))
+				ret = sparse_stream_fill(ss);
+			break;
+
+		case SPARSE_STREAM_DONE:
+			pr_err("Trailing data after sparse image\n");
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * sparse_stream_finish - check that a complete sparse image has been fed
+ * @ss:		the parser context
+ *
+ * Return: 0 if the image is complete, -EINVAL if it is truncated
+ */
+int sparse_stream_finish(struct sparse_stream_ctx *ss)
+{
+	if (ss->state != SPARSE_STREAM_DONE || ss->skip)
+		return -EINVAL;
+
+	return 0;
+}
+
+loff_t sparse_stream_size(struct sparse_stream_ctx *ss)
+{
+	return (loff_t)ss->sparse.blk_sz * ss->sparse.total_blks;
+}
+
+void sparse_stream_free(struct sparse_stream_ctx *ss)
+{
+	if (!ss)
+		return;
+
+	free(ss->fill_buf);
+	free(ss);
+}
@@ -12,6 +12,7 @@
  *
  */
 #include <common.h>
+#include <dma.h>
 #include <memory.h>
 #include <zero_page.h>
 #include <fs.h>
@@ -21,6 +22,7 @@
 #include <progress.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/sizes.h>
 #include <linux/stat.h>
 
 /*
@@ -463,6 +465,12 @@ int write_file_flash(const char *filename, const void *buf, size_t size)
 }
 EXPORT_SYMBOL(write_file_flash);
 
+/*
+ * copy_file() reads in big DMA aligned pieces so that block devices can
+ * read directly into the buffer and keep their request queue filled.
+ */
+#define COPY_FILE_BUF_SIZE	SZ_1M
+
 /**
  * copy_file - Copy a file
  * @src:	The source filename
@@ -477,6 +485,7 @@ EXPORT_SYMBOL(write_file_flash);
 int copy_file(const char *src, const char *dst, unsigned flags)
 {
 	char *rw_buf = NULL;
+	size_t bufsize = COPY_FILE_BUF_SIZE;
 	int srcfd = 0, dstfd = 0;
 	int r, s;
 	int ret = 1, err1 = 0;
@@ -484,7 +493,11 @@ int copy_file(const char *src, const char *dst, unsigned flags)
 	loff_t total = 0;
 	struct stat srcstat, dststat;
 
-	rw_buf = xmalloc(RW_BUF_SIZE);
+	rw_buf = memalign(DMA_ALIGNMENT, bufsize);
+	if (!rw_buf) {
+		bufsize = RW_BUF_SIZE;
+		rw_buf = xmalloc(bufsize);
+	}
 
 	srcfd = open(src, O_RDONLY);
 	if (srcfd < 0) {
@@ -535,7 +548,7 @@ int copy_file(const char *src, const char *dst, unsigned flags)
 		init_progression_bar(srcstat.st_size);
 
 	while (1) {
-		r = read(srcfd, rw_buf, RW_BUF_SIZE);
+		r = read(srcfd, rw_buf, bufsize);
 		if (r < 0) {
 			perror("read");
 			ret = r;
@@ -26,6 +26,12 @@
 #include <malloc.h>
 #include <fs.h>
 #include <libfile.h>
+#include <digest.h>
+#include <smp.h>
+#include <linux/lz4.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+#include <asm/unaligned.h>
 
 static void *uncompress_buf;
 static unsigned long uncompress_size;
@@ -191,13 +197,226 @@ int uncompress_buf_to_fd(const void *input, size_t input_len,
 			  NULL, NULL, error_fn);
 }
 
+/* legacy lz4 format as used by the kernel, see decompress_unlz4.c */
+#define UNLZ4_MAGIC		0x184C2102
+#define UNLZ4_CHUNK_SIZE	(8 << 20)
+
+struct uncompress_chunk {
+	const void *in;
+	size_t in_len;
+	void *out;
+	size_t out_len;
+};
+
+struct uncompress_parallel {
+	enum filetype ft;
+	struct uncompress_chunk *chunks;
+	unsigned int nchunks;
+	void **wksp;
+	ZSTD_DCtx **dctx;
+};
+
+static void uncompress_add_chunk(struct uncompress_parallel *up,
+				 const void *in, size_t in_len, size_t out_len)
+{
+	struct uncompress_chunk *c;
+
+	up->chunks = xrealloc(up->chunks, (up->nchunks + 1) * sizeof(*c));
+	c = &up->chunks[up->nchunks++];
+	c->in = in;
+	c->in_len = in_len;
+	c->out_len = out_len;
+}
+
+/* Split into zstd frames, which need to have their content size set */
+static int uncompress_split_zstd(struct uncompress_parallel *up,
+				 const void *in, size_t len)
+{
+	unsigned long long out_len;
+	size_t in_len;
+
+	while (len) {
+		in_len = ZSTD_findFrameCompressedSize(in, len);
+		if (ZSTD_isError(in_len)) {
+			/* tolerate the size appended by the kernel build */
+			if (up->nchunks && len <= 4)
+				break;
+			return -EINVAL;
+		}
+
+		out_len = ZSTD_getFrameContentSize(in, len);
+		if (out_len == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    out_len == ZSTD_CONTENTSIZE_ERROR)
+			return -ENOTSUPP;
+
+		uncompress_add_chunk(up, in, in_len, out_len);
+		in += in_len;
+		len -= in_len;
+	}
+
+	return 0;
+}
+
+/*
+ * Split into lz4 legacy chunks. All but the last one decompress to exactly
+ * UNLZ4_CHUNK_SIZE bytes, which gives the output offsets up front.
+ */
+static int uncompress_split_lz4(struct uncompress_parallel *up,
+				const void *in, size_t len)
+{
+	size_t in_len;
+
+	/* magic and the size appended by the kernel build */
+	if (len < 8 || get_unaligned_le32(in) != UNLZ4_MAGIC)
+		return -EINVAL;
+
+	in += 4;
+	len -= 8;
+
+	while (len) {
+		if (len < 4)
+			return -EINVAL;
+
+		in_len = get_unaligned_le32(in);
+		in += 4;
+		len -= 4;
+
+		/* concatenated streams may have short chunks anywhere */
+		if (in_len == UNLZ4_MAGIC)
+			return -ENOTSUPP;
+		if (in_len > len)
+			return -EINVAL;
+
+		uncompress_add_chunk(up, in, in_len, UNLZ4_CHUNK_SIZE);
+		in += in_len;
+		len -= in_len;
+	}
+
+	return 0;
+}
+
+static int uncompress_chunk(void *data, unsigned int job, unsigned int cpu)
+{
+	struct uncompress_parallel *up = data;
+	struct uncompress_chunk *c = &up->chunks[job];
+	size_t len = c->out_len;
+
+	if (IS_ENABLED(CONFIG_ZSTD_DECOMPRESS) &&
+	    up->ft == filetype_zstd_compressed) {
+		len = ZSTD_decompressDCtx(up->dctx[cpu], c->out, c->out_len,
+					  c->in, c->in_len);
+		if (ZSTD_isError(len) || len != c->out_len)
+			return -EINVAL;
+	} else if (IS_ENABLED(CONFIG_LZ4_DECOMPRESS)) {
+		if (lz4_decompress_unknownoutputsize(c->in, c->in_len,
+						     c->out, &len) < 0)
+			return -EINVAL;
+		if (job != up->nchunks - 1 && len != c->out_len)
+			return -EINVAL;
+		c->out_len = len;
+	}
+
+	return 0;
+}
+
+/*
+ * Decompress the independent frames of multi-frame zstd and chunks of lz4
+ * legacy data on all available CPUs. Returns -ENOTSUPP if the data can't
+ * be split up or decompressing fails, in which case the caller should
+ * fall back to decompress it sequentially.
+ */
+static ssize_t uncompress_buf_to_buf_parallel(const void *input,
+					      size_t input_len, void **buf)
+{
+	struct uncompress_parallel up = {};
+	unsigned int ncpus = 0, i;
+	ssize_t result = -ENOTSUPP;
+	size_t total = 0;
+	void *out = NULL;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_SMP_WORKERS))
+		return -ENOTSUPP;
+
+	up.ft = file_detect_compression_type(input, input_len);
+	if (IS_ENABLED(CONFIG_ZSTD_DECOMPRESS) &&
+	    up.ft == filetype_zstd_compressed)
+		ret = uncompress_split_zstd(&up, input, input_len);
+	else if (IS_ENABLED(CONFIG_LZ4_DECOMPRESS) &&
+		 up.ft == filetype_lz4_compressed)
+		ret = uncompress_split_lz4(&up, input, input_len);
+	else
+		ret = -ENOTSUPP;
+
+	if (ret || up.nchunks < 2)
+		goto out;
+
+	ncpus = smp_num_cpus();
+	if (ncpus < 2)
+		goto out;
+
+	for (i = 0; i < up.nchunks; i++)
+		total += up.chunks[i].out_len;
+
+	out = malloc(total);
+	if (!out)
+		goto out;
+
+	for (i = 0; i < up.nchunks; i++) {
+		up.chunks[i].out = out;
+		out += up.chunks[i].out_len;
+	}
+	out -= total;
+
+	if (IS_ENABLED(CONFIG_ZSTD_DECOMPRESS) &&
+	    up.ft == filetype_zstd_compressed) {
+		size_t wksp_size = ZSTD_DCtxWorkspaceBound();
+
+		up.wksp = xzalloc(ncpus * sizeof(*up.wksp));
+		up.dctx = xzalloc(ncpus * sizeof(*up.dctx));
+
+		for (i = 0; i < ncpus; i++) {
+			up.wksp[i] = malloc(wksp_size);
+			if (!up.wksp[i])
+				goto out;
+			up.dctx[i] = ZSTD_initDCtx(up.wksp[i], wksp_size);
+		}
+	}
+
+	ret = smp_run_jobs(uncompress_chunk, &up, up.nchunks);
+	if (ret)
+		goto out;
+
+	if (up.ft == filetype_lz4_compressed)
+		total -= UNLZ4_CHUNK_SIZE - up.chunks[up.nchunks - 1].out_len;
+
+	*buf = out;
+	out = NULL;
+	result = total;
+out:
+	if (up.wksp)
+		for (i = 0; i < ncpus; i++)
+			free(up.wksp[i]);
+	free(up.wksp);
+	free(up.dctx);
+	free(up.chunks);
+	free(out);
+
+	return result;
+}
+
 ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 			      void **buf, void(*error_fn)(char *x))
 {
 	size_t size;
+	ssize_t len;
 	int fd, ret;
 	void *p;
 
+	len = uncompress_buf_to_buf_parallel(input, input_len, buf);
+	if (len != -ENOTSUPP)
+		return len;
+
 	fd = open("/tmp", O_TMPFILE | O_RDWR);
 	if (fd < 0)
 		return -ENODEV;
@@ -217,3 +436,108 @@ ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 
 	return ret ?: size;
 }
+
+static struct uncompress_digest_state {
+	const void *in;
+	size_t in_len;
+	struct digest *digest;
+	void *out;
+	size_t out_len;
+	size_t out_size;
+} *uncompress_digest_state;
+
+/*
+ * Hand the next piece of compressed data to the decompressor and hash it
+ * from the decompressor's input buffer while it is still in cache.
+ */
+static long fill_digest(void *buf, unsigned long len)
+{
+	struct uncompress_digest_state *st = uncompress_digest_state;
+	size_t now = min_t(size_t, len, st->in_len);
+	int ret;
+
+	memcpy(buf, st->in, now);
+
+	if (st->digest) {
+		ret = digest_update(st->digest, buf, now);
+		if (ret)
+			return ret;
+	}
+
+	st->in += now;
+	st->in_len -= now;
+
+	return now;
+}
+
+static long flush_digest(void *buf, unsigned long len)
+{
+	struct uncompress_digest_state *st = uncompress_digest_state;
+
+	if (st->out_len + len > st->out_size) {
+		size_t size = max_t(size_t, st->out_size * 2, st->out_len + len);
+		void *out = realloc(st->out, size);
+
+		if (!out)
+			return -ENOMEM;
+
+		st->out = out;
+		st->out_size = size;
+	}
+
+	memcpy(st->out + st->out_len, buf, len);
+	st->out_len += len;
+
+	return len;
+}
+
+/**
+ * uncompress_buf_to_buf_digest - decompress a buffer and hash its input
+ * @input: compressed data
+ * @input_len: length of @input
+ * @buf: returns the newly allocated buffer with the decompressed data
+ * @digest: initialized digest updated with all of @input, may be NULL
+ * @error_fn: error reporting function
+ *
+ * Like uncompress_buf_to_buf(), but the compressed data is read only once:
+ * each piece is hashed right after it was fed to the decompressor, and the
+ * decompressed data is collected without a detour through a temporary file.
+ * Note that the decompressor sees the data before the caller could verify
+ * the digest.
+ *
+ * Return: length of the decompressed data or a negative error code
+ */
+ssize_t uncompress_buf_to_buf_digest(const void *input, size_t input_len,
+				     void **buf, struct digest *digest,
+				     void(*error_fn)(char *x))
+{
+	struct uncompress_digest_state st = {
+		.in = input,
+		.in_len = input_len,
+		.digest = digest,
+		.out_size = max_t(size_t, input_len * 4, SZ_64K),
+	};
+	int ret;
+
+	st.out = malloc(st.out_size);
+	if (!st.out)
+		return -ENOMEM;
+
+	uncompress_digest_state = &st;
+	ret = uncompress(NULL, 0, fill_digest, flush_digest, NULL, NULL,
+			 error_fn);
+	uncompress_digest_state = NULL;
+
+	/* hash trailing data the decompressor didn't consume */
+	if (!ret && digest && st.in_len)
+		ret = digest_update(digest, st.in, st.in_len);
+
+	if (ret) {
+		free(st.out);
+		return ret;
+	}
+
+	*buf = st.out;
+
+	return st.out_len;
+}
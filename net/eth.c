@@ -217,15 +217,27 @@ struct eth_q {
 	void *data;
 };
 
+static void eth_count_tx(struct eth_device *edev, int ret)
+{
+	if (ret)
+		edev->tx_errors++;
+	else
+		edev->tx_packets++;
+}
+
 static int eth_queue(struct eth_device *edev, void *packet, int length)
 {
 	struct eth_q *q;
 
+	if (length > PKTSIZE)
+		return -EMSGSIZE;
+
 	q = xzalloc(sizeof(*q));
 	if (!q)
 		return -ENOMEM;
 
-	q->data = dma_alloc(length);
+	/* the sender reuses its packet, so queue a copy of it */
+	q->data = net_alloc_packet();
 	if (!q->data) {
 		free(q);
 		return -ENOMEM;
@@ -259,6 +271,7 @@ int eth_send(struct eth_device *edev, void *packet, int length)
 	led_trigger_network(LED_TRIGGER_NET_TX);
 
 	ret = eth_send_raw(edev, packet, length);
+	eth_count_tx(edev, ret);
 
 	slice_release(eth_device_slice(edev));
 
@@ -285,9 +298,10 @@ static void eth_do_work(struct eth_device *edev)
 
 	list_for_each_entry_safe(q, tmp, &edev->send_queue, list) {
 		led_trigger_network(LED_TRIGGER_NET_TX);
-		eth_send_raw(edev, q->data, q->length);
+		ret = eth_send_raw(edev, q->data, q->length);
+		eth_count_tx(edev, ret);
 		list_del(&q->list);
-		free(q->data);
+		net_free_packet(q->data);
 		free(q);
 	}
 
@@ -472,6 +486,10 @@ int eth_register(struct eth_device *edev)
 	dev_add_param_enum(dev, "mode", NULL, NULL, &edev->global_mode,
 				  eth_mode_names, ARRAY_SIZE(eth_mode_names),
 				  NULL);
+	dev_add_param_uint32_ro(dev, "rx_packets", &edev->rx_packets, "%u");
+	dev_add_param_uint32_ro(dev, "rx_dropped", &edev->rx_dropped, "%u");
+	dev_add_param_uint32_ro(dev, "tx_packets", &edev->tx_packets, "%u");
+	dev_add_param_uint32_ro(dev, "tx_errors", &edev->tx_errors, "%u");
 
 	if (edev->init)
 		edev->init(edev);
@@ -536,7 +554,7 @@ void eth_unregister(struct eth_device *edev)
 			continue;
 
 		list_del(&q->list);
-		free(q->data);
+		net_free_packet(q->data);
 		free(q);
 	}
 
@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * ip_fragment.c - IPv4 fragment reassembly
+ *
+ * Fragments are collected per datagram in a small, fixed number of slots.
+ * Every slot owns a buffer which starts with the ethernet and IP header of
+ * the first fragment, followed by the payload, so that a complete datagram
+ * can be handed to the protocol handlers like a received frame. Which parts
+ * of the payload are present is tracked in 8 byte units, the granularity of
+ * the fragment offset. Data which has already been received is never
+ * overwritten by overlapping fragments.
+ */
+
+#define pr_fmt(fmt) "ipfrag: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <malloc.h>
+#include <net.h>
+#include <linux/bitmap.h>
+#include <linux/sizes.h>
+
+/* number of datagrams reassembled at the same time */
+#define IPFRAG_SLOTS		4
+/* time a datagram may take to arrive completely */
+#define IPFRAG_TIMEOUT		(2 * SECOND)
+/* buffer memory used by all slots together */
+#define IPFRAG_MEM_MAX		SZ_256K
+/* buffers grow in steps of this size */
+#define IPFRAG_ALLOC_STEP	SZ_8K
+
+#define IPFRAG_HDR_SIZE		(ETHER_HDR_SIZE + sizeof(struct iphdr))
+#define IPFRAG_MAX_PAYLOAD	(0xffff - sizeof(struct iphdr))
+#define IPFRAG_UNITS		DIV_ROUND_UP(IPFRAG_MAX_PAYLOAD, 8)
+
+#define IP_MF			0x2000
+#define IP_OFFSET		0x1fff
+
+struct ipfrag_queue {
+	bool active;
+	IPaddr_t saddr;
+	IPaddr_t daddr;
+	uint16_t id;
+	uint8_t protocol;
+	uint64_t start;
+	unsigned int total;	/* payload length, 0 until the last fragment is in */
+	unsigned int end;	/* end of the received payload data */
+	unsigned int units;	/* number of 8 byte units received */
+	unsigned char *buf;
+	unsigned int size;	/* allocated size of @buf */
+	DECLARE_BITMAP(map, IPFRAG_UNITS);
+};
+
+static struct ipfrag_queue ipfrag_queues[IPFRAG_SLOTS];
+static unsigned int ipfrag_mem;
+
+static void ipfrag_free(struct ipfrag_queue *q)
+{
+	ipfrag_mem -= q->size;
+	free(q->buf);
+	q->buf = NULL;
+	q->size = 0;
+	q->active = false;
+}
+
+/*
+ * Make room for @size more bytes of buffer memory. Buffers of idle slots go
+ * first, then the datagram which has been waiting longest for its fragments.
+ */
+static bool ipfrag_reclaim(struct ipfrag_queue *q, unsigned int size)
+{
+	struct ipfrag_queue *oldest;
+	int i;
+
+	for (i = 0; i < IPFRAG_SLOTS && ipfrag_mem + size > IPFRAG_MEM_MAX; i++)
+		if (!ipfrag_queues[i].active)
+			ipfrag_free(&ipfrag_queues[i]);
+
+	while (ipfrag_mem + size > IPFRAG_MEM_MAX) {
+		oldest = NULL;
+
+		for (i = 0; i < IPFRAG_SLOTS; i++) {
+			struct ipfrag_queue *p = &ipfrag_queues[i];
+
+			if (p == q || !p->active)
+				continue;
+			if (!oldest || p->start < oldest->start)
+				oldest = p;
+		}
+
+		if (!oldest)
+			return false;
+
+		pr_debug("dropping datagram %u from %pI4\n", oldest->id,
+			 &oldest->saddr);
+		ipfrag_free(oldest);
+	}
+
+	return true;
+}
+
+static int ipfrag_grow(struct ipfrag_queue *q, unsigned int end)
+{
+	unsigned int size = ALIGN(IPFRAG_HDR_SIZE + end, IPFRAG_ALLOC_STEP);
+	unsigned char *buf;
+
+	if (size <= q->size)
+		return 0;
+
+	if (!ipfrag_reclaim(q, size - q->size))
+		return -ENOMEM;
+
+	buf = realloc(q->buf, size);
+	if (!buf)
+		return -ENOMEM;
+
+	ipfrag_mem += size - q->size;
+	q->buf = buf;
+	q->size = size;
+
+	return 0;
+}
+
+static struct ipfrag_queue *ipfrag_find(struct iphdr *ip)
+{
+	IPaddr_t saddr = net_read_ip(&ip->saddr);
+	IPaddr_t daddr = net_read_ip(&ip->daddr);
+	uint16_t id = ntohs(ip->id);
+	struct ipfrag_queue *q, *unused = NULL;
+	int i;
+
+	for (i = 0; i < IPFRAG_SLOTS; i++) {
+		q = &ipfrag_queues[i];
+
+		if (q->active && is_timeout(q->start, IPFRAG_TIMEOUT)) {
+			pr_debug("datagram %u from %pI4 timed out\n", q->id,
+				 &q->saddr);
+			q->active = false;
+		}
+
+		if (!q->active) {
+			/* prefer slots which already have a buffer */
+			if (!unused || (q->buf && !unused->buf))
+				unused = q;
+			continue;
+		}
+
+		if (q->id == id && q->saddr == saddr && q->daddr == daddr &&
+		    q->protocol == ip->protocol)
+			return q;
+	}
+
+	if (!unused) {
+		/* all slots busy, give up on the oldest datagram */
+		for (i = 0; i < IPFRAG_SLOTS; i++) {
+			q = &ipfrag_queues[i];
+			if (!unused || q->start < unused->start)
+				unused = q;
+		}
+	}
+
+	q = unused;
+	q->active = true;
+	q->saddr = saddr;
+	q->daddr = daddr;
+	q->id = id;
+	q->protocol = ip->protocol;
+	q->start = get_time_ns();
+	q->total = 0;
+	q->end = 0;
+	q->units = 0;
+	bitmap_zero(q->map, IPFRAG_UNITS);
+
+	return q;
+}
+
+/*
+ * Copy the parts of a fragment which have not been received yet
+ */
+static void ipfrag_copy(struct ipfrag_queue *q, const unsigned char *data,
+			unsigned int offset, unsigned int end)
+{
+	unsigned int u = offset / 8, last = DIV_ROUND_UP(end, 8);
+	unsigned int from, to, first;
+
+	while (u < last) {
+		if (test_bit(u, q->map)) {
+			u++;
+			continue;
+		}
+
+		first = u;
+		while (u < last && !test_bit(u, q->map))
+			__set_bit(u++, q->map);
+
+		q->units += u - first;
+		from = first * 8;
+		to = min(u * 8, end);
+		memcpy(q->buf + IPFRAG_HDR_SIZE + from, data + from - offset,
+		       to - from);
+	}
+}
+
+/**
+ * net_ip_defrag - add a fragment to its datagram
+ * @pkt: received frame containing an IPv4 fragment
+ * @len: length of @pkt, updated to the datagram length on completion
+ *
+ * The fragment header must have been verified by the caller.
+ *
+ * Return: the complete datagram including ethernet and IP header once all of
+ * its fragments are in, NULL otherwise. The buffer stays valid until the next
+ * call.
+ */
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	unsigned int ihl = (ip->hl_v & 0x0f) * 4;
+	unsigned int frag_off = ntohs(ip->frag_off);
+	unsigned int offset = (frag_off & IP_OFFSET) * 8;
+	bool more = frag_off & IP_MF;
+	struct ipfrag_queue *q;
+	unsigned int flen, end;
+
+	if (ihl < sizeof(struct iphdr) || *len <= ETHER_HDR_SIZE + ihl)
+		return NULL;
+
+	flen = *len - ETHER_HDR_SIZE - ihl;
+	end = offset + flen;
+
+	/* all but the last fragment carry a multiple of 8 bytes */
+	if (end > IPFRAG_MAX_PAYLOAD || (more && flen % 8))
+		return NULL;
+
+	q = ipfrag_find(ip);
+
+	if (!more) {
+		/* the last fragment must not be followed by data */
+		if ((q->total && q->total != end) || q->end > end)
+			goto drop;
+		q->total = end;
+	} else if (q->total && end > q->total) {
+		goto drop;
+	}
+
+	if (ipfrag_grow(q, end))
+		goto drop;
+
+	if (!offset)
+		memcpy(q->buf, pkt, IPFRAG_HDR_SIZE);
+
+	ipfrag_copy(q, pkt + ETHER_HDR_SIZE + ihl, offset, end);
+	q->end = max(q->end, end);
+
+	if (!q->total || q->units != DIV_ROUND_UP(q->total, 8))
+		return NULL;
+
+	q->active = false;
+
+	ip = (struct iphdr *)(q->buf + ETHER_HDR_SIZE);
+	ip->hl_v = 0x45;
+	ip->tot_len = htons(sizeof(struct iphdr) + q->total);
+	ip->frag_off = 0;
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(struct iphdr));
+
+	*len = IPFRAG_HDR_SIZE + q->total;
+
+	return q->buf;
+drop:
+	pr_debug("dropping inconsistent datagram %u from %pI4\n", q->id,
+		 &q->saddr);
+	q->active = false;
+	return NULL;
+}
+
+/**
+ * net_ip_defrag_flush - drop all partial datagrams and free their buffers
+ */
+void net_ip_defrag_flush(void)
+{
+	int i;
+
+	for (i = 0; i < IPFRAG_SLOTS; i++)
+		ipfrag_free(&ipfrag_queues[i]);
+}
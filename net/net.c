@@ -31,6 +31,9 @@
 
 static unsigned int net_ip_id;
 
+/* number of connections accepting datagrams larger than a frame */
+static unsigned int net_ip_frag_users;
+
 char *net_server, *net_fetchdir;
 IPaddr_t net_gateway;
 static IPaddr_t net_nameserver;
@@ -267,13 +270,18 @@ void net_poll(void)
 
 	eth_rx();
 
+	/*
+	 * The timers send on the connection, which the code interrupted by
+	 * a poller may be in the middle of building a packet for.
+	 */
+	if (!poller_active())
+		net_tcp_poll();
+
 	in_net_poll = false;
 }
 
 static void __net_poll(struct poller_struct *poller)
 {
-	static uint64_t last;
-
 	/*
 	 * USB network controllers take a long time in the receive path,
 	 * so limit the polling rate to once per 10ms. This is due to
@@ -293,16 +301,12 @@ static void __net_poll(struct poller_struct *poller)
 	 * incoming packets. This is used to receive incoming ping packets
 	 * and to get fastboot over ethernet going.
 	 */
-	if (!is_timeout(last, 10 * MSECOND))
-		return;
-
 	net_poll();
-
-	last = get_time_ns();
 }
 
 static struct poller_struct net_poller = {
 	.func = __net_poll,
+	.period = 10 * MSECOND,
 };
 
 static int init_net_poll(void)
@@ -323,6 +327,26 @@ static uint16_t net_udp_new_localport(void)
 	return localport;
 }
 
+/*
+ * TCP ports start at a random place in the dynamic port range, so that a new
+ * connection does not collide with one a server still remembers from before
+ * a reset.
+ */
+static uint16_t net_tcp_new_localport(void)
+{
+	static uint16_t localport;
+
+	if (!localport)
+		localport = 49152 + random32() % 16384;
+
+	localport++;
+
+	if (localport < 49152)
+		localport = 49152;
+
+	return localport;
+}
+
 IPaddr_t net_get_serverip(void)
 {
 	IPaddr_t ip;
@@ -458,8 +482,10 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->et = (struct ethernet *)con->packet;
 	con->ip = (struct iphdr *)(con->packet + ETHER_HDR_SIZE);
 	con->udp = (struct udphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->icmp = (struct icmphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->handler = handler;
+	con->rx_size = NET_UDP_FRAME_PAYLOAD;
 
 	if (dest == IP_BROADCAST) {
 		memset(con->et->et_dest, 0xff, 6);
@@ -525,14 +551,66 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	return con;
 }
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	struct net_connection *con = net_new(NULL, dest, handler, ctx);
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->tcp->th_dport = htons(dport);
+	con->tcp->th_sport = htons(net_tcp_new_localport());
+	con->ip->protocol = IPPROTO_TCP;
+
+	return con;
+}
+
+/**
+ * net_udp_set_rx_size - set the largest UDP payload a connection accepts
+ * @con: the UDP connection
+ * @size: maximum payload size in bytes
+ *
+ * Datagrams larger than a single frame arrive fragmented and are only
+ * reassembled while at least one connection asked for them, so protocols
+ * which negotiate their block size call this before requesting large blocks.
+ *
+ * Return: 0 on success, -EOPNOTSUPP if @size needs fragment reassembly which
+ * is not available or -EINVAL if @size exceeds what fits into a datagram.
+ */
+int net_udp_set_rx_size(struct net_connection *con, unsigned int size)
+{
+	bool large = size > NET_UDP_FRAME_PAYLOAD;
+
+	if (size > NET_UDP_MAX_PAYLOAD)
+		return -EINVAL;
+
+	if (large && !IS_ENABLED(CONFIG_NET_IP_REASSEMBLY))
+		return -EOPNOTSUPP;
+
+	if (con->rx_size > NET_UDP_FRAME_PAYLOAD)
+		net_ip_frag_users--;
+	if (large)
+		net_ip_frag_users++;
+
+	con->rx_size = max_t(unsigned int, size, NET_UDP_FRAME_PAYLOAD);
+
+	if (!net_ip_frag_users)
+		net_ip_defrag_flush();
+
+	return 0;
+}
+
 void net_unregister(struct net_connection *con)
 {
+	net_udp_set_rx_size(con, NET_UDP_FRAME_PAYLOAD);
 	list_del(&con->list);
 	net_free_packet(con->packet);
 	free(con);
 }
 
-static int net_ip_send(struct net_connection *con, int len)
+int net_ip_send(struct net_connection *con, int len)
 {
 	con->ip->tot_len = htons(sizeof(struct iphdr) + len);
 	con->ip->id = htons(net_ip_id++);
@@ -650,12 +728,40 @@ static int net_handle_udp(unsigned char *pkt, int len)
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	struct net_connection *con;
 	struct udphdr *udp;
-	int port;
+	int port, ulen;
 
 	udp = (struct udphdr *)(ip + 1);
 	port = ntohs(udp->uh_dport);
+	ulen = ntohs(udp->uh_ulen);
+	if (ulen < sizeof(*udp) ||
+	    ulen > len - ETHER_HDR_SIZE - sizeof(struct iphdr))
+		return -EINVAL;
+
 	list_for_each_entry(con, &connection_list, list) {
 		if (con->proto == IPPROTO_UDP && port == ntohs(con->udp->uh_sport)) {
+			if (ulen - sizeof(*udp) > con->rx_size)
+				return -EMSGSIZE;
+			con->handler(con->priv, pkt, len);
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+static int net_handle_tcp(unsigned char *pkt, int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	struct net_connection *con;
+
+	if (len < ETHER_HDR_SIZE + sizeof(*ip) + sizeof(*tcp))
+		return -EINVAL;
+
+	list_for_each_entry(con, &connection_list, list) {
+		if (con->proto == IPPROTO_TCP &&
+		    tcp->th_dport == con->tcp->th_sport &&
+		    tcp->th_sport == con->tcp->th_dport &&
+		    net_read_ip(&ip->saddr) == net_read_ip(&con->ip->daddr)) {
 			con->handler(con->priv, pkt, len);
 			return 0;
 		}
@@ -777,14 +883,6 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
-
-	/* Can't deal w/ fragments.
-	 * Either a fragment offset (13 bits), or
-	 * MF (More Fragments) from fragment flags (3 bits).
-	 * MF - because first fragment has fragment offset 0
-	 */
-	if (ip->frag_off & htons(0x3fff))
-		goto bad;
 	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
 		goto bad;
 
@@ -792,11 +890,28 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
 		return 0;
 
+	/*
+	 * A fragment has either a fragment offset (13 bits), or MF (More
+	 * Fragments) from the fragment flags (3 bits) set. MF - because the
+	 * first fragment has fragment offset 0. Only UDP datagrams are
+	 * reassembled, and only while a connection accepts large ones.
+	 */
+	if (ip->frag_off & htons(0x3fff)) {
+		if (ip->protocol != IPPROTO_UDP || !net_ip_frag_users)
+			goto bad;
+
+		pkt = net_ip_defrag(pkt, &len);
+		if (!pkt)
+			return 0;
+	}
+
 	switch (ip->protocol) {
 	case IPPROTO_ICMP:
 		return net_handle_icmp(edev, pkt, len);
 	case IPPROTO_UDP:
 		return net_handle_udp(pkt, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(pkt, len);
 	}
 
 	return 0;
@@ -814,10 +929,13 @@ int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
 	led_trigger_network(LED_TRIGGER_NET_RX);
 
 	if (len < ETHER_HDR_SIZE) {
+		edev->rx_dropped++;
 		ret = 0;
 		goto out;
 	}
 
+	edev->rx_packets++;
+
 	if (edev->rx_monitor)
 		edev->rx_monitor(edev, pkt, len);
 
@@ -854,13 +972,14 @@ void net_free_packets(void **packets, unsigned count)
 		net_free_packet(packets[count]);
 }
 
-int net_alloc_packets(void **packets, int count)
+static int __net_alloc_packets(void **packets, int count,
+			       char *(*alloc)(void))
 {
 	void *packet;
 	int i;
 
 	for (i = 0; i < count; i++) {
-		packet = net_alloc_packet();
+		packet = alloc();
 		if (!packet)
 			goto free;
 		packets[i] = packet;
@@ -872,6 +991,16 @@ int net_alloc_packets(void **packets, int count)
 	return -ENOMEM;
 }
 
+int net_alloc_packets(void **packets, int count)
+{
+	return __net_alloc_packets(packets, count, net_alloc_packet);
+}
+
+int net_alloc_rx_packets(void **packets, int count)
+{
+	return __net_alloc_packets(packets, count, net_alloc_rx_packet);
+}
+
 static int net_init(void)
 {
 	net_fetchdir = xstrdup("/mnt/tftp");
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * packet.c - network packet buffer pool
+ *
+ * All packet buffers are PKTSIZE bytes, a multiple of the cache line size,
+ * and come from a single DMA capable allocation made when the first packet
+ * is needed. Buffers are reference counted: a protocol can keep a received
+ * packet by taking a reference instead of copying it, and the driver puts a
+ * fresh buffer into its receive ring instead of reusing the one still held.
+ * This only works for drivers which do so, they allocate their receive
+ * buffers with net_alloc_rx_packet(), which marks them. All other packets are
+ * copied by protocols which keep them, as the next frame may overwrite them.
+ * When the pool runs empty, packets are allocated individually; the pool
+ * counters show how often that happens.
+ */
+
+#define pr_fmt(fmt) "net: " fmt
+
+#include <common.h>
+#include <dma.h>
+#include <globalvar.h>
+#include <init.h>
+#include <magicvar.h>
+#include <malloc.h>
+#include <net.h>
+#include <linux/bitmap.h>
+
+#define NET_POOL_SIZE		CONFIG_NET_PACKET_POOL_SIZE
+
+/*
+ * Number of buffers which stay available to drivers. References to received
+ * packets are refused once the pool is this low, so that a driver can always
+ * replace a held receive buffer with one from the pool.
+ */
+#define NET_POOL_RESERVE	(NET_POOL_SIZE / 8)
+
+static char *net_pool;
+static uint8_t *net_pool_refs;
+static uint16_t *net_pool_stack;
+/* buffers whose driver calls net_packet_rx_recycle() */
+static DECLARE_BITMAP(net_pool_rx, NET_POOL_SIZE);
+
+static uint32_t net_pool_size = NET_POOL_SIZE;
+static uint32_t net_pool_free;
+static uint32_t net_pool_low;
+static uint32_t net_pool_misses;
+
+static int net_pool_init(void)
+{
+	int i;
+
+	net_pool = dma_alloc(NET_POOL_SIZE * PKTSIZE);
+	if (!net_pool)
+		return -ENOMEM;
+
+	net_pool_refs = xzalloc(NET_POOL_SIZE * sizeof(*net_pool_refs));
+	net_pool_stack = xmalloc(NET_POOL_SIZE * sizeof(*net_pool_stack));
+
+	/* hand out the buffers in address order */
+	for (i = 0; i < NET_POOL_SIZE; i++)
+		net_pool_stack[i] = NET_POOL_SIZE - 1 - i;
+
+	net_pool_free = net_pool_low = NET_POOL_SIZE;
+
+	return 0;
+}
+
+/*
+ * Returns the index of the pool buffer @pkt points into, -1 for packets which
+ * do not come from the pool.
+ */
+static int net_pool_index(const void *pkt)
+{
+	const char *p = pkt;
+
+	if (!net_pool || p < net_pool || p >= net_pool + NET_POOL_SIZE * PKTSIZE)
+		return -1;
+
+	return (p - net_pool) / PKTSIZE;
+}
+
+char *net_alloc_packet(void)
+{
+	int i;
+
+	if (!net_pool)
+		net_pool_init();
+
+	if (net_pool_free) {
+		i = net_pool_stack[--net_pool_free];
+		net_pool_refs[i] = 1;
+		net_pool_low = min(net_pool_low, net_pool_free);
+		return net_pool + i * PKTSIZE;
+	}
+
+	net_pool_misses++;
+
+	return dma_alloc(PKTSIZE);
+}
+
+/**
+ * net_free_packet - drop a reference to a packet
+ * @pkt: the packet, may point anywhere into a pool buffer
+ *
+ * The buffer is returned to the pool when its last reference is dropped.
+ */
+void net_free_packet(char *pkt)
+{
+	int i = net_pool_index(pkt);
+
+	if (i < 0) {
+		dma_free(pkt);
+		return;
+	}
+
+	if (WARN_ON(!net_pool_refs[i]))
+		return;
+
+	if (--net_pool_refs[i])
+		return;
+
+	__clear_bit(i, net_pool_rx);
+	net_pool_stack[net_pool_free++] = i;
+}
+
+/**
+ * net_alloc_rx_packet - allocate a receive buffer
+ *
+ * Like net_alloc_packet(), for drivers which call net_packet_rx_recycle()
+ * with the buffer after every net_receive(). Only packets received into such
+ * buffers can be kept by protocols with net_packet_get().
+ *
+ * Return: the buffer, NULL if out of memory
+ */
+char *net_alloc_rx_packet(void)
+{
+	char *pkt = net_alloc_packet();
+	int i = net_pool_index(pkt);
+
+	if (i >= 0)
+		__set_bit(i, net_pool_rx);
+
+	return pkt;
+}
+
+/**
+ * net_packet_get - take a reference to a received packet
+ * @pkt: pointer into the packet, e.g. to its payload
+ *
+ * Protocols which want to keep the data of a received packet beyond their
+ * receive handler can take a reference instead of copying it. The reference
+ * is dropped with net_free_packet(). This is only possible for packets which
+ * were received into a buffer from net_alloc_rx_packet() and only as long as
+ * enough buffers are left for the drivers.
+ *
+ * Return: true if the reference was taken, false if the data must be copied
+ */
+bool net_packet_get(const void *pkt)
+{
+	int i = net_pool_index(pkt);
+
+	if (i < 0 || !net_pool_refs[i] || !test_bit(i, net_pool_rx) ||
+	    net_pool_free <= NET_POOL_RESERVE || net_pool_refs[i] == U8_MAX)
+		return false;
+
+	net_pool_refs[i]++;
+
+	return true;
+}
+
+/**
+ * net_packet_rx_recycle - get back a receive buffer after net_receive()
+ * @pkt: the receive buffer handed to net_receive(), from net_alloc_rx_packet()
+ *
+ * Drivers call this with their receive buffer once net_receive() returned.
+ * When a protocol kept a reference to the packet, the driver's reference is
+ * dropped and a fresh buffer is returned, which the driver has to put into
+ * its receive ring instead.
+ *
+ * Return: the buffer to reuse for receiving, @pkt if nobody held on to it
+ */
+char *net_packet_rx_recycle(char *pkt)
+{
+	int i = net_pool_index(pkt);
+	char *fresh;
+
+	if (i < 0 || net_pool_refs[i] <= 1)
+		return pkt;
+
+	/* net_packet_get() keeps NET_POOL_RESERVE buffers for this */
+	fresh = net_alloc_rx_packet();
+	BUG_ON(!fresh);
+
+	net_free_packet(pkt);
+
+	return fresh;
+}
+
+static int net_pool_params_init(void)
+{
+	dev_add_param_uint32_ro(&global_device, "net.pool.size", &net_pool_size, "%u");
+	dev_add_param_uint32_ro(&global_device, "net.pool.free", &net_pool_free, "%u");
+	dev_add_param_uint32_ro(&global_device, "net.pool.low", &net_pool_low, "%u");
+	dev_add_param_uint32_ro(&global_device, "net.pool.misses", &net_pool_misses, "%u");
+
+	return 0;
+}
+postcore_initcall(net_pool_params_init);
+
+BAREBOX_MAGICVAR(global.net.pool.size, "Number of buffers in the network packet pool");
+BAREBOX_MAGICVAR(global.net.pool.free, "Number of free buffers in the network packet pool");
+BAREBOX_MAGICVAR(global.net.pool.low, "Lowest number of free buffers in the network packet pool so far");
+BAREBOX_MAGICVAR(global.net.pool.misses, "Number of packets allocated outside of the exhausted pool");
@@ -0,0 +1,839 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * tcp.c - minimal TCP client
+ *
+ * Connections are only opened actively and are meant for protocols which
+ * send small requests and receive large amounts of data, like HTTP. Received
+ * data goes into a ring buffer whose free space is the advertised window,
+ * scaled as in RFC 7323 so that it can exceed 64 KiB. Segments arriving out
+ * of order are kept until the gap is filled, by holding a reference to the
+ * received packet where possible. ACKs are sent for every second full sized
+ * segment, otherwise after a short delay (RFC 1122, RFC 5681).
+ *
+ * Data we send stays in a small buffer until it is acknowledged and is sent
+ * again from the first unacknowledged byte on when the retransmission timer
+ * expires. There is no congestion control, the little data we send never
+ * needs any.
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <kfifo.h>
+#include <malloc.h>
+#include <net.h>
+#include <stdlib.h>
+#include <asm/unaligned.h>
+#include <linux/list.h>
+#include <linux/sizes.h>
+
+/* receive buffer, the largest window we advertise */
+#define TCP_RX_WINDOW		(CONFIG_NET_TCP_WINDOW_SIZE * SZ_1K)
+/* data sent but not acknowledged yet */
+#define TCP_TX_BUF		SZ_4K
+/* largest segment we receive, an ethernet frame without IP and TCP header */
+#define TCP_MSS			(1500 - 20 - 20)
+/* segment size to assume when the peer does not announce one */
+#define TCP_DEFAULT_MSS		536
+/* number of out of order segments kept */
+#define TCP_OOO_MAX		64
+
+#define TCP_DELACK_TIME		(40 * MSECOND)
+#define TCP_RTO_INIT		SECOND
+#define TCP_RTO_MAX		(8 * SECOND)
+#define TCP_RETRIES		6
+/* time to wait for the peer to close its side as well */
+#define TCP_CLOSE_TIMEOUT	(2 * SECOND)
+
+#define TCPOPT_EOL		0
+#define TCPOPT_NOP		1
+#define TCPOPT_MSS		2
+#define TCPOPT_WINDOW		3
+
+#define TCP_MAX_WSCALE		14
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+};
+
+/* a segment received out of order */
+struct tcp_segment {
+	struct list_head list;
+	uint32_t seq;
+	unsigned int len;
+	char *data;
+	char *held;	/* received packet @data points into, if not copied */
+	char buf[];
+};
+
+struct tcp_sock {
+	struct net_connection *con;
+	struct list_head list;
+	enum tcp_state state;
+	int err;
+
+	uint32_t iss;
+	uint32_t snd_una;	/* oldest unacknowledged sequence number */
+	uint32_t snd_nxt;	/* next sequence number to send */
+	uint32_t snd_wnd;	/* send window from snd_una on */
+	unsigned int snd_mss;
+	uint8_t snd_wscale;
+	uint8_t rcv_wscale;
+	bool closing;		/* send a FIN after the remaining data */
+	bool fin_sent;
+	bool fin_rcvd;
+
+	uint32_t rcv_nxt;	/* next sequence number expected */
+	uint32_t rcv_adv;	/* right edge of the window advertised last */
+	unsigned int rcv_mss;	/* largest segment received so far */
+	struct kfifo *rx_fifo;
+	struct list_head ooo;
+	unsigned int ooo_num;
+
+	unsigned int unacked;	/* bytes received since the last ACK */
+	bool ack_delayed;
+	uint64_t ack_start;
+
+	unsigned char *tx_buf;	/* data from snd_una on */
+	unsigned int tx_len;
+
+	bool rto_pending;
+	uint64_t rto_start;
+	uint64_t rto;
+	unsigned int retries;
+};
+
+static LIST_HEAD(tcp_socks);
+
+static inline bool tcp_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static inline bool tcp_after(uint32_t a, uint32_t b)
+{
+	return tcp_before(b, a);
+}
+
+/* Returns the ones' complement sum over pseudo header and segment */
+static uint16_t tcp_checksum(struct iphdr *ip, struct tcphdr *tcp,
+			     unsigned int len)
+{
+	struct {
+		uint32_t saddr;
+		uint32_t daddr;
+		uint8_t zero;
+		uint8_t protocol;
+		uint16_t len;
+	} __attribute__ ((packed)) ph;
+	uint32_t sum;
+
+	ph.saddr = net_read_ip(&ip->saddr);
+	ph.daddr = net_read_ip(&ip->daddr);
+	ph.zero = 0;
+	ph.protocol = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	sum = net_checksum((unsigned char *)&ph, sizeof(ph)) +
+	      net_checksum((unsigned char *)tcp, len);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return sum;
+}
+
+static unsigned int tcp_rcv_window(struct tcp_sock *tsk)
+{
+	unsigned int free = tsk->rx_fifo->size - kfifo_len(tsk->rx_fifo);
+
+	return min_t(unsigned int, free, 0xffff << tsk->rcv_wscale);
+}
+
+static void tcp_timer_start(struct tcp_sock *tsk)
+{
+	tsk->rto_pending = true;
+	tsk->rto_start = get_time_ns();
+}
+
+static int tcp_send(struct tcp_sock *tsk, uint8_t flags, uint32_t seq,
+		    const void *data, unsigned int len)
+{
+	struct net_connection *con = tsk->con;
+	struct tcphdr *tcp = con->tcp;
+	unsigned char *opt = (unsigned char *)(tcp + 1);
+	unsigned int hlen = sizeof(*tcp);
+	unsigned int win = tcp_rcv_window(tsk);
+
+	if (flags & TH_SYN) {
+		opt[0] = TCPOPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCPOPT_NOP;
+		opt[5] = TCPOPT_WINDOW;
+		opt[6] = 3;
+		opt[7] = tsk->rcv_wscale;
+		hlen += 8;
+
+		/* the window of a SYN is never scaled */
+		win = min(win, 0xffffU);
+	} else {
+		win >>= tsk->rcv_wscale;
+	}
+
+	tcp->th_seq = htonl(seq);
+	tcp->th_ack = flags & TH_ACK ? htonl(tsk->rcv_nxt) : 0;
+	tcp->th_off = (hlen / 4) << 4;
+	tcp->th_flags = flags;
+	tcp->th_win = htons(win);
+	tcp->th_urp = 0;
+
+	if (len)
+		memcpy((void *)tcp + hlen, data, len);
+
+	tcp->th_sum = 0;
+	tcp->th_sum = ~tcp_checksum(con->ip, tcp, hlen + len);
+
+	if (flags & TH_ACK) {
+		tsk->rcv_adv = tsk->rcv_nxt + (win << tsk->rcv_wscale);
+		tsk->unacked = 0;
+		tsk->ack_delayed = false;
+	}
+
+	return net_ip_send(con, hlen + len);
+}
+
+static void tcp_send_ack(struct tcp_sock *tsk)
+{
+	tcp_send(tsk, TH_ACK, tsk->snd_nxt, NULL, 0);
+}
+
+static void tcp_send_reset(struct tcp_sock *tsk)
+{
+	tcp_send(tsk, TH_RST | TH_ACK, tsk->snd_nxt, NULL, 0);
+}
+
+/*
+ * Send the data the peer has room for, and the FIN once all data is out
+ */
+static void tcp_output(struct tcp_sock *tsk)
+{
+	unsigned int sent = tsk->snd_nxt - tsk->snd_una;
+	unsigned int wnd = tsk->snd_wnd;
+	unsigned int len;
+
+	if (tsk->state != TCP_ESTABLISHED || tsk->fin_sent)
+		return;
+
+	while (sent < tsk->tx_len && sent < wnd) {
+		len = min3(tsk->tx_len - sent, tsk->snd_mss, wnd - sent);
+
+		tcp_send(tsk, TH_ACK | TH_PSH, tsk->snd_nxt, tsk->tx_buf + sent,
+			 len);
+		tsk->snd_nxt += len;
+		sent += len;
+
+		if (!tsk->rto_pending)
+			tcp_timer_start(tsk);
+	}
+
+	/* the timer probes a closed window */
+	if (sent < tsk->tx_len && !tsk->rto_pending)
+		tcp_timer_start(tsk);
+
+	if (tsk->closing && sent == tsk->tx_len) {
+		tcp_send(tsk, TH_FIN | TH_ACK, tsk->snd_nxt, NULL, 0);
+		tsk->snd_nxt++;
+		tsk->fin_sent = true;
+
+		if (!tsk->rto_pending)
+			tcp_timer_start(tsk);
+	}
+}
+
+static void tcp_parse_options(struct tcp_sock *tsk, struct tcphdr *tcp,
+			      unsigned int hlen)
+{
+	unsigned char *opt = (unsigned char *)(tcp + 1);
+	unsigned int len = hlen - sizeof(*tcp), olen;
+	bool wscale = false;
+
+	while (len && opt[0] != TCPOPT_EOL) {
+		if (opt[0] == TCPOPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+
+		olen = opt[1];
+
+		if (opt[0] == TCPOPT_MSS && olen == 4) {
+			tsk->snd_mss = clamp_t(unsigned int,
+					       get_unaligned_be16(opt + 2),
+					       64, TCP_MSS);
+		} else if (opt[0] == TCPOPT_WINDOW && olen == 3) {
+			tsk->snd_wscale = min_t(uint8_t, opt[2], TCP_MAX_WSCALE);
+			wscale = true;
+		}
+
+		opt += olen;
+		len -= olen;
+	}
+
+	/* window scaling is only used when both sides asked for it */
+	if (!wscale)
+		tsk->rcv_wscale = tsk->snd_wscale = 0;
+}
+
+static void tcp_input_syn_sent(struct tcp_sock *tsk, struct tcphdr *tcp,
+			       unsigned int hlen)
+{
+	uint32_t ack = ntohl(tcp->th_ack);
+
+	if (!(tcp->th_flags & TH_ACK))
+		return;
+
+	if (ack != tsk->iss + 1) {
+		/*
+		 * Most likely the peer still has a connection on this port
+		 * from before a reset. Reset it, the SYN is sent again.
+		 */
+		if (!(tcp->th_flags & TH_RST))
+			tcp_send(tsk, TH_RST, ack, NULL, 0);
+		return;
+	}
+
+	if (tcp->th_flags & TH_RST) {
+		tsk->state = TCP_CLOSED;
+		tsk->err = -ECONNREFUSED;
+		return;
+	}
+
+	if (!(tcp->th_flags & TH_SYN))
+		return;
+
+	tcp_parse_options(tsk, tcp, hlen);
+
+	tsk->rcv_nxt = ntohl(tcp->th_seq) + 1;
+	tsk->snd_una = ack;
+	tsk->snd_wnd = ntohs(tcp->th_win);
+	tsk->state = TCP_ESTABLISHED;
+	tsk->rto_pending = false;
+	tsk->rto = TCP_RTO_INIT;
+	tsk->retries = 0;
+
+	tcp_send_ack(tsk);
+}
+
+static void tcp_ack(struct tcp_sock *tsk, uint32_t ack, uint16_t win)
+{
+	unsigned int acked;
+
+	if (tcp_after(ack, tsk->snd_nxt)) {
+		/* acknowledges something we did not send */
+		tcp_send_ack(tsk);
+		return;
+	}
+
+	if (tcp_before(ack, tsk->snd_una))
+		return;
+
+	if (tcp_after(ack, tsk->snd_una)) {
+		/* a FIN takes a sequence number, but is not in tx_buf */
+		acked = min(ack - tsk->snd_una, tsk->tx_len);
+
+		memmove(tsk->tx_buf, tsk->tx_buf + acked, tsk->tx_len - acked);
+		tsk->tx_len -= acked;
+		tsk->snd_una = ack;
+		tsk->rto = TCP_RTO_INIT;
+		tsk->retries = 0;
+
+		if (tsk->snd_una == tsk->snd_nxt)
+			tsk->rto_pending = false;
+		else
+			tcp_timer_start(tsk);
+	}
+
+	tsk->snd_wnd = win << tsk->snd_wscale;
+}
+
+static void tcp_segment_free(struct tcp_sock *tsk, struct tcp_segment *seg)
+{
+	list_del(&seg->list);
+	if (seg->held)
+		net_free_packet(seg->held);
+	free(seg);
+	tsk->ooo_num--;
+}
+
+static void tcp_ooo_insert(struct tcp_sock *tsk, uint32_t seq, char *data,
+			   unsigned int len)
+{
+	struct tcp_segment *seg, *pos;
+
+	if (tsk->ooo_num >= TCP_OOO_MAX)
+		return;
+
+	list_for_each_entry(pos, &tsk->ooo, list) {
+		if (pos->seq == seq && pos->len >= len)
+			return;
+		if (tcp_before(seq, pos->seq))
+			break;
+	}
+
+	if (net_packet_get(data)) {
+		seg = xzalloc(sizeof(*seg));
+		seg->data = data;
+		seg->held = data;
+	} else {
+		seg = malloc(sizeof(*seg) + len);
+		if (!seg)
+			return;
+		memcpy(seg->buf, data, len);
+		seg->data = seg->buf;
+		seg->held = NULL;
+	}
+
+	seg->seq = seq;
+	seg->len = len;
+
+	/* keep the list sorted, insert in front of @pos */
+	list_add_tail(&seg->list, &pos->list);
+	tsk->ooo_num++;
+}
+
+/*
+ * Move out of order segments which became contiguous into the receive
+ * buffer. Returns true if a gap was filled.
+ */
+static bool tcp_ooo_merge(struct tcp_sock *tsk)
+{
+	struct tcp_segment *seg, *tmp;
+	unsigned int skip;
+	bool merged = false;
+
+	list_for_each_entry_safe(seg, tmp, &tsk->ooo, list) {
+		if (tcp_after(seg->seq, tsk->rcv_nxt))
+			break;
+
+		skip = tsk->rcv_nxt - seg->seq;
+		if (skip < seg->len) {
+			tsk->rcv_nxt += kfifo_put(tsk->rx_fifo,
+						  seg->data + skip,
+						  seg->len - skip);
+			merged = true;
+		}
+
+		tcp_segment_free(tsk, seg);
+	}
+
+	return merged;
+}
+
+static void tcp_data(struct tcp_sock *tsk, uint32_t seq, char *data,
+		     unsigned int len, bool fin)
+{
+	unsigned int skip, wnd;
+	bool merged, trimmed = false;
+
+	if (tcp_before(seq, tsk->rcv_nxt)) {
+		skip = tsk->rcv_nxt - seq;
+		if (skip >= len + fin) {
+			/* retransmission of what we have, our ACK got lost */
+			tcp_send_ack(tsk);
+			return;
+		}
+
+		/* a FIN is never in front of the data */
+		data += skip;
+		len -= skip;
+		seq = tsk->rcv_nxt;
+	}
+
+	wnd = tsk->rx_fifo->size - kfifo_len(tsk->rx_fifo);
+	if (tcp_after(seq + len, tsk->rcv_nxt + wnd)) {
+		len = tcp_after(seq, tsk->rcv_nxt + wnd) ?
+			0 : tsk->rcv_nxt + wnd - seq;
+		fin = false;
+		trimmed = true;
+	}
+
+	if (seq != tsk->rcv_nxt) {
+		/* the peer fast-retransmits after three duplicate ACKs */
+		if (len)
+			tcp_ooo_insert(tsk, seq, data, len);
+		tcp_send_ack(tsk);
+		return;
+	}
+
+	tsk->rcv_nxt += kfifo_put(tsk->rx_fifo, data, len);
+	tsk->rcv_mss = max(tsk->rcv_mss, len);
+	tsk->unacked += len;
+
+	merged = tcp_ooo_merge(tsk);
+
+	if (fin && !tsk->fin_rcvd) {
+		tsk->rcv_nxt++;
+		tsk->fin_rcvd = true;
+	}
+
+	/* a trimmed segment, e.g. a zero window probe, needs our window */
+	if (trimmed || fin || merged || tsk->unacked >= 2 * tsk->rcv_mss) {
+		tcp_send_ack(tsk);
+	} else if (len && !tsk->ack_delayed) {
+		tsk->ack_delayed = true;
+		tsk->ack_start = get_time_ns();
+	}
+}
+
+static void tcp_input(void *ctx, char *pkt, unsigned int len)
+{
+	struct tcp_sock *tsk = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(pkt);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	unsigned int tcplen = len - ETHER_HDR_SIZE - sizeof(*ip);
+	unsigned int hlen = (tcp->th_off >> 4) * 4;
+	uint32_t seq = ntohl(tcp->th_seq);
+	uint8_t flags = tcp->th_flags;
+
+	if (hlen < sizeof(*tcp) || hlen > tcplen)
+		return;
+
+	if (tcp_checksum(ip, tcp, tcplen) != 0xffff) {
+		pr_debug("bad checksum\n");
+		return;
+	}
+
+	switch (tsk->state) {
+	case TCP_CLOSED:
+		return;
+	case TCP_SYN_SENT:
+		tcp_input_syn_sent(tsk, tcp, hlen);
+		return;
+	case TCP_ESTABLISHED:
+		break;
+	}
+
+	if (flags & TH_RST) {
+		/* only believe resets which fit into the window */
+		if (!tcp_before(seq, tsk->rcv_nxt) &&
+		    tcp_before(seq, tsk->rcv_nxt + tcp_rcv_window(tsk) + 1)) {
+			tsk->state = TCP_CLOSED;
+			tsk->err = -ECONNRESET;
+		}
+		return;
+	}
+
+	if (flags & TH_SYN) {
+		/* the SYN-ACK again, our ACK got lost */
+		tcp_send_ack(tsk);
+		return;
+	}
+
+	if (!(flags & TH_ACK))
+		return;
+
+	tcp_ack(tsk, ntohl(tcp->th_ack), ntohs(tcp->th_win));
+
+	if (tcplen > hlen || (flags & TH_FIN))
+		tcp_data(tsk, seq, (char *)tcp + hlen, tcplen - hlen,
+			 flags & TH_FIN);
+
+	tcp_output(tsk);
+}
+
+static void tcp_retransmit(struct tcp_sock *tsk)
+{
+	unsigned int len;
+
+	if (++tsk->retries > TCP_RETRIES) {
+		pr_debug("connection timed out\n");
+		tsk->state = TCP_CLOSED;
+		tsk->err = -ETIMEDOUT;
+		tsk->rto_pending = false;
+		return;
+	}
+
+	tsk->rto = min_t(uint64_t, tsk->rto * 2, TCP_RTO_MAX);
+	tcp_timer_start(tsk);
+
+	if (tsk->state == TCP_SYN_SENT) {
+		tcp_send(tsk, TH_SYN, tsk->iss, NULL, 0);
+		return;
+	}
+
+	/* data in flight, the FIN is not in tx_buf */
+	len = min(tsk->snd_nxt - tsk->snd_una, tsk->tx_len);
+	if (!len && tsk->tx_len) {
+		/* nothing in flight because of a closed window, probe it */
+		len = 1;
+		tsk->snd_nxt++;
+	}
+
+	if (len)
+		tcp_send(tsk, TH_ACK | TH_PSH, tsk->snd_una, tsk->tx_buf,
+			 min(len, tsk->snd_mss));
+	else if (tsk->fin_sent)
+		tcp_send(tsk, TH_FIN | TH_ACK, tsk->snd_nxt - 1, NULL, 0);
+}
+
+/**
+ * net_tcp_poll - run the TCP timers
+ *
+ * Sends delayed ACKs and retransmits unacknowledged data. Called from
+ * net_poll(), but not from pollers.
+ */
+void net_tcp_poll(void)
+{
+	struct tcp_sock *tsk;
+
+	list_for_each_entry(tsk, &tcp_socks, list) {
+		if (tsk->state == TCP_CLOSED)
+			continue;
+
+		if (tsk->ack_delayed &&
+		    is_timeout_non_interruptible(tsk->ack_start, TCP_DELACK_TIME))
+			tcp_send_ack(tsk);
+
+		if (tsk->rto_pending &&
+		    is_timeout_non_interruptible(tsk->rto_start, tsk->rto))
+			tcp_retransmit(tsk);
+	}
+}
+
+static void tcp_free(struct tcp_sock *tsk)
+{
+	struct tcp_segment *seg, *tmp;
+
+	list_for_each_entry_safe(seg, tmp, &tsk->ooo, list)
+		tcp_segment_free(tsk, seg);
+
+	list_del(&tsk->list);
+	net_unregister(tsk->con);
+	kfifo_free(tsk->rx_fifo);
+	free(tsk->tx_buf);
+	free(tsk);
+}
+
+/**
+ * net_tcp_connect - open a TCP connection
+ * @dest: IP address of the server
+ * @dport: port to connect to
+ *
+ * Waits until the connection is established.
+ *
+ * Return: the connection, to be passed to the other net_tcp_* functions,
+ * or an error pointer
+ */
+struct net_connection *net_tcp_connect(IPaddr_t dest, uint16_t dport)
+{
+	struct net_connection *con;
+	struct tcp_sock *tsk;
+	int ret;
+
+	tsk = xzalloc(sizeof(*tsk));
+
+	con = net_tcp_new(dest, dport, tcp_input, tsk);
+	if (IS_ERR(con)) {
+		free(tsk);
+		return con;
+	}
+
+	tsk->con = con;
+	tsk->rx_fifo = kfifo_alloc(TCP_RX_WINDOW);
+	if (!tsk->rx_fifo) {
+		net_unregister(con);
+		free(tsk);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	tsk->tx_buf = xmalloc(TCP_TX_BUF);
+	INIT_LIST_HEAD(&tsk->ooo);
+	list_add_tail(&tsk->list, &tcp_socks);
+
+	while ((tsk->rx_fifo->size >> tsk->rcv_wscale) > 0xffff)
+		tsk->rcv_wscale++;
+
+	tsk->snd_mss = TCP_DEFAULT_MSS;
+	tsk->rcv_mss = TCP_DEFAULT_MSS;
+	tsk->iss = random32();
+	tsk->snd_una = tsk->iss;
+	tsk->snd_nxt = tsk->iss + 1;
+	tsk->rto = TCP_RTO_INIT;
+	tsk->state = TCP_SYN_SENT;
+
+	ret = tcp_send(tsk, TH_SYN, tsk->iss, NULL, 0);
+	if (ret)
+		goto out;
+
+	tcp_timer_start(tsk);
+
+	while (tsk->state == TCP_SYN_SENT) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
+
+		net_poll();
+	}
+
+	if (tsk->state != TCP_ESTABLISHED) {
+		ret = tsk->err;
+		goto out;
+	}
+
+	return con;
+out:
+	tcp_free(tsk);
+
+	return ERR_PTR(ret);
+}
+
+/**
+ * net_tcp_write - send data
+ * @con: the connection
+ * @buf: the data
+ * @len: length of @buf
+ *
+ * Only waits while the send buffer is full. The data is retransmitted in
+ * the background until the peer acknowledged it.
+ *
+ * Return: @len or a negative error code
+ */
+int net_tcp_write(struct net_connection *con, const void *buf, size_t len)
+{
+	struct tcp_sock *tsk = con->priv;
+	size_t left = len;
+	unsigned int now;
+
+	while (left) {
+		if (tsk->state != TCP_ESTABLISHED)
+			return tsk->err ?: -ENOTCONN;
+
+		if (tsk->closing || tsk->fin_rcvd)
+			return -EPIPE;
+
+		now = min_t(size_t, left, TCP_TX_BUF - tsk->tx_len);
+		if (!now) {
+			if (ctrlc())
+				return -EINTR;
+			net_poll();
+			continue;
+		}
+
+		memcpy(tsk->tx_buf + tsk->tx_len, buf, now);
+		tsk->tx_len += now;
+		buf += now;
+		left -= now;
+
+		tcp_output(tsk);
+	}
+
+	return len;
+}
+
+/**
+ * net_tcp_read - get received data
+ * @con: the connection
+ * @buf: buffer for the data
+ * @len: size of @buf
+ *
+ * Does not wait for data, callers poll the network with net_poll() until
+ * this returns something other than -EAGAIN.
+ *
+ * Return: the number of bytes read, 0 when the peer closed the connection
+ * and all data has been read, -EAGAIN if no data is available or another
+ * negative error code
+ */
+int net_tcp_read(struct net_connection *con, void *buf, size_t len)
+{
+	struct tcp_sock *tsk = con->priv;
+	unsigned int now, grown;
+
+	now = kfifo_get(tsk->rx_fifo, buf, len);
+	if (!now) {
+		if (tsk->fin_rcvd)
+			return 0;
+		if (tsk->state == TCP_CLOSED)
+			return tsk->err ?: -ENOTCONN;
+		return -EAGAIN;
+	}
+
+	/*
+	 * Tell the peer when the window opened noticeably, but avoid the
+	 * silly window syndrome (RFC 1122).
+	 */
+	grown = tsk->rcv_nxt + tcp_rcv_window(tsk) - tsk->rcv_adv;
+	if (tsk->state == TCP_ESTABLISHED && !tsk->fin_rcvd &&
+	    grown >= min(tsk->rx_fifo->size / 2, tsk->rcv_mss))
+		tcp_send_ack(tsk);
+
+	return now;
+}
+
+/**
+ * net_tcp_abort - reset a connection and free it
+ * @con: the connection
+ *
+ * For connections whose remaining data is not wanted anymore.
+ */
+void net_tcp_abort(struct net_connection *con)
+{
+	struct tcp_sock *tsk = con->priv;
+
+	if (tsk->state == TCP_ESTABLISHED)
+		tcp_send_reset(tsk);
+
+	tcp_free(tsk);
+}
+
+/**
+ * net_tcp_close - close a connection and free it
+ * @con: the connection
+ *
+ * Sends the remaining data and a FIN and waits a bit for the peer to close
+ * its side too. Connections with unread data or which do not close in time
+ * are reset.
+ */
+void net_tcp_close(struct net_connection *con)
+{
+	struct tcp_sock *tsk = con->priv;
+	uint64_t start;
+
+	if (tsk->state != TCP_ESTABLISHED)
+		goto out;
+
+	if (kfifo_len(tsk->rx_fifo) || tsk->ooo_num) {
+		net_tcp_abort(con);
+		return;
+	}
+
+	tsk->closing = true;
+	tcp_output(tsk);
+
+	start = get_time_ns();
+
+	while (tsk->state == TCP_ESTABLISHED) {
+		if (tsk->fin_rcvd && tsk->fin_sent &&
+		    tsk->snd_una == tsk->snd_nxt)
+			goto out;
+
+		if (is_timeout(start, TCP_CLOSE_TIMEOUT) || ctrlc())
+			break;
+
+		net_poll();
+
+		/* the peer may have sent more data meanwhile */
+		kfifo_reset(tsk->rx_fifo);
+	}
+
+	if (tsk->state == TCP_ESTABLISHED)
+		tcp_send_reset(tsk);
+out:
+	tcp_free(tsk);
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <malloc.h>
+#include <linux/bch.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+/* Amount of data encoded and decoded per configuration for the timings */
+#define BCH_TEST_BYTES		SZ_1M
+#define BCH_TEST_CORRUPT	64
+
+static u32 bch_test_seed;
+
+static u32 bch_test_rand(void)
+{
+	bch_test_seed = bch_test_seed * 1103515245 + 12345;
+	return bch_test_seed >> 8;
+}
+
+static unsigned int bch_test_kbps(u64 ns)
+{
+	return ns ? div64_u64((u64)BCH_TEST_BYTES * 1000000, ns) : 0;
+}
+
+/*
+ * Flip up to t random bits in data and ecc and check that bch_decode()
+ * finds all of them, the same way the NAND software ECC engine calls it.
+ */
+static void bch_test_correct(struct bch_control *bch, u8 *data,
+			     unsigned int len, const u8 *ecc)
+{
+	unsigned int *errloc = xzalloc(bch->t * sizeof(*errloc));
+	u8 *copy = xmemdup(data, len);
+	u8 *calc = xzalloc(bch->ecc_bytes);
+	u8 *recv = xmemdup(ecc, bch->ecc_bytes);
+	unsigned int i, nerr = 1 + bch_test_rand() % bch->t;
+	unsigned int nbits = len * 8 + bch->ecc_bits;
+	int ret;
+
+	/* use distinct bit positions, a second flip would undo the first */
+	for (i = 0; i < nerr; i++) {
+		unsigned int bit = (bch_test_rand() % (nbits - nerr)) / nerr * nerr + i;
+
+		/* ecc bits are stored MSB first */
+		if (bit < len * 8)
+			data[bit / 8] ^= BIT(bit % 8);
+		else
+			recv[(bit - len * 8) / 8] ^= BIT(7 - bit % 8);
+	}
+
+	bch_encode(bch, data, len, calc);
+	ret = bch_decode(bch, NULL, len, recv, calc, NULL, errloc);
+
+	total_tests++;
+	if (ret != nerr) {
+		failed_tests++;
+		printf("m=%u t=%u: %u bit errors, bch_decode returned %d\n",
+		       bch->m, bch->t, nerr, ret);
+		goto out;
+	}
+
+	for (i = 0; i < nerr; i++)
+		if (errloc[i] < len * 8)
+			data[errloc[i] / 8] ^= BIT(errloc[i] % 8);
+
+	total_tests++;
+	if (memcmp(data, copy, len)) {
+		failed_tests++;
+		printf("m=%u t=%u: data not corrected\n", bch->m, bch->t);
+	}
+out:
+	memcpy(data, copy, len);
+	free(recv);
+	free(calc);
+	free(copy);
+	free(errloc);
+}
+
+static void bch_test_one(int m, int t, unsigned int len)
+{
+	unsigned int i, nblocks = BCH_TEST_BYTES / len;
+	u64 start, encode_ns, decode_ns;
+	struct bch_control *bch;
+	u8 *data, *ecc, *calc;
+	unsigned int *errloc;
+	int ret;
+
+	bch = bch_init(m, t, 0, false);
+	if (!bch) {
+		failed_tests++;
+		pr_err("bch_init(%d, %d) failed\n", m, t);
+		return;
+	}
+
+	data = xmalloc(len);
+	ecc = xzalloc(nblocks * bch->ecc_bytes);
+	calc = xzalloc(bch->ecc_bytes);
+	errloc = xzalloc(t * sizeof(*errloc));
+
+	for (i = 0; i < len; i++)
+		data[i] = bch_test_rand();
+
+	start = get_time_ns();
+	for (i = 0; i < nblocks; i++)
+		bch_encode(bch, data, len, ecc + i * bch->ecc_bytes);
+	encode_ns = get_time_ns() - start;
+
+	/* decoding clean data has to take the no error shortcut */
+	start = get_time_ns();
+	for (i = 0; i < nblocks; i++) {
+		memset(calc, 0, bch->ecc_bytes);
+		bch_encode(bch, data, len, calc);
+		ret = bch_decode(bch, NULL, len, ecc + i * bch->ecc_bytes,
+				 calc, NULL, errloc);
+		if (ret) {
+			failed_tests++;
+			printf("m=%d t=%d: clean block %u decoded to %d\n",
+			       m, t, i, ret);
+			break;
+		}
+	}
+	decode_ns = get_time_ns() - start;
+	total_tests++;
+
+	for (i = 0; i < BCH_TEST_CORRUPT; i++)
+		bch_test_correct(bch, data, len, ecc);
+
+	pr_info("m=%d t=%d %u byte blocks: encode %u KiB/s, decode %u KiB/s\n",
+		m, t, len, bch_test_kbps(encode_ns) / 1024,
+		bch_test_kbps(decode_ns) / 1024);
+
+	free(errloc);
+	free(calc);
+	free(ecc);
+	free(data);
+	bch_free(bch);
+}
+
+static void test_bch(void)
+{
+	bch_test_seed = 1;
+
+	bch_test_one(13, 4, 512);
+	bch_test_one(13, 8, 512);
+	bch_test_one(14, 8, 1024);
+	bch_test_one(14, 24, 1024);
+}
+bselftest(core, test_bch);
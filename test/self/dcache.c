@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <clock.h>
+#include <bselftest.h>
+#include <linux/math64.h>
+
+BSELFTEST_GLOBALS();
+
+#define DCACHE_TEST_ENTRIES	4096
+
+#define expect_success(ret, fmt, ...) ({ \
+	int __ret = (ret); \
+	total_tests++; \
+	if (__ret < 0) { \
+		failed_tests++; \
+		printf("%s:%d error %pe: " fmt "\n", \
+		       __func__, __LINE__, ERR_PTR(__ret), ##__VA_ARGS__); \
+	} \
+	__ret >= 0; \
+})
+
+#define expect_fail(ret, fmt, ...) ({ \
+	int __ret = (ret); \
+	total_tests++; \
+	if (__ret >= 0) { \
+		failed_tests++; \
+		printf("%s:%d unexpected success: " fmt "\n", \
+		       __func__, __LINE__, ##__VA_ARGS__); \
+	} \
+	__ret < 0; \
+})
+
+static u64 stat_all(const char *dname, bool deleted)
+{
+	char fname[64];
+	struct stat st;
+	u64 start;
+	int i, ret;
+
+	start = get_time_ns();
+
+	for (i = 0; i < DCACHE_TEST_ENTRIES; i++) {
+		scnprintf(fname, sizeof(fname), "%s/entry-%d", dname, i);
+
+		ret = stat(fname, &st);
+		if (deleted && i % 2)
+			expect_fail(ret, "stat of removed %s", fname);
+		else
+			expect_success(ret, "stat of %s", fname);
+	}
+
+	return get_time_ns() - start;
+}
+
+static void test_dcache(void)
+{
+	char fname[64];
+	struct stat st;
+	char *dname;
+	u64 start, create_ns, lookup_ns;
+	int i, ret;
+
+	dname = make_temp("dcache-test");
+	ret = mkdir(dname, 0777);
+	if (!expect_success(ret, "creating directory"))
+		goto out;
+
+	start = get_time_ns();
+
+	for (i = 0; i < DCACHE_TEST_ENTRIES; i++) {
+		scnprintf(fname, sizeof(fname), "%s/entry-%d", dname, i);
+
+		ret = write_file(fname, "", 0);
+		if (!expect_success(ret, "creating %s", fname))
+			goto out;
+	}
+
+	create_ns = get_time_ns() - start;
+
+	lookup_ns = stat_all(dname, false);
+
+	pr_info("%d entries: created in %llu us, looked up in %llu us (%llu ns/lookup)\n",
+		DCACHE_TEST_ENTRIES, div_u64(create_ns, 1000),
+		div_u64(lookup_ns, 1000), div_u64(lookup_ns, DCACHE_TEST_ENTRIES));
+
+	for (i = 1; i < DCACHE_TEST_ENTRIES; i += 2) {
+		scnprintf(fname, sizeof(fname), "%s/entry-%d", dname, i);
+
+		ret = unlink(fname);
+		expect_success(ret, "unlinking %s", fname);
+	}
+
+	stat_all(dname, true);
+
+	scnprintf(fname, sizeof(fname), "%s/ENTRY-0", dname);
+	expect_fail(stat(fname, &st), "case sensitive lookup");
+out:
+	ret = unlink_recursive(dname, NULL);
+	expect_success(ret, "unlinking directory");
+	free(dname);
+}
+bselftest(core, test_dcache);
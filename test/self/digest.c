@@ -6,6 +6,7 @@
 #include <bselftest.h>
 #include <clock.h>
 #include <digest.h>
+#include <crypto/sha.h>
 
 BSELFTEST_GLOBALS();
 
@@ -196,6 +197,46 @@ static void test_digests_sha35(const char *suffix)
 				   "60a5a68aa0017e3446433349b42592b74713d7787628a58e400b7f588b9bd69b"));
 }
 
+static void test_digest_multi(void)
+{
+	u8 md[3][SHA256_DIGEST_SIZE], expect[SHA256_DIGEST_SIZE];
+	struct digest_stream streams[] = {
+		{ .data = zeroes7, .len = sizeof(zeroes7), .md = md[0] },
+		{ .data = one32,   .len = sizeof(one32),   .md = md[1] },
+		{ .data = inc4097, .len = sizeof(inc4097), .md = md[2] },
+	};
+	int ret;
+
+	total_tests++;
+
+	if (!IS_ENABLED(CONFIG_HAVE_DIGEST_SHA256)) {
+		skipped_tests++;
+		return;
+	}
+
+	ret = digest_multi("sha256", streams, ARRAY_SIZE(streams));
+	if (ret) {
+		printf("digest_multi failed: %pe\n", ERR_PTR(ret));
+		failed_tests++;
+		return;
+	}
+
+	hex2bin(expect, "1e973d029df2b2c66cb42a942c5edb45966f02abaff29fe99410e44d271d0efc",
+		sizeof(expect));
+	if (memcmp(md[2], expect, sizeof(expect))) {
+		printf("digest_multi: mismatch, got %*phN\n", SHA256_DIGEST_SIZE, md[2]);
+		failed_tests++;
+		return;
+	}
+
+	hex2bin(expect, "837885c8f8091aeaeb9ec3c3f85a6ff470a415e610b8ba3e49f9b33c9cf9d619",
+		sizeof(expect));
+	if (memcmp(md[0], expect, sizeof(expect))) {
+		printf("digest_multi: mismatch, got %*phN\n", SHA256_DIGEST_SIZE, md[0]);
+		failed_tests++;
+	}
+}
+
 static void test_digests(void)
 {
 	int i;
@@ -215,5 +256,6 @@ static void test_digests(void)
 	test_digests_sha12("");
 	test_digests_sha35("");
 
+	test_digest_multi();
 }
 bselftest(core, test_digests);
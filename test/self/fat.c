@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <block.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <disks.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <ramdisk.h>
+#include <unistd.h>
+#include <asm/unaligned.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+/*
+ * A FAT16 volume with one sector per cluster holding a single file. The file
+ * is split into fragments of FAT_TEST_RUN clusters with FAT_TEST_GAP free
+ * clusters in between, every 32bit word of it holds its own file offset.
+ */
+#define FAT_TEST_SECTORS	8192
+#define FAT_TEST_FATSZ		32
+#define FAT_TEST_ROOTENTS	512
+#define FAT_TEST_DATA		(1 + FAT_TEST_FATSZ + FAT_TEST_ROOTENTS * 32 / SECTOR_SIZE)
+#define FAT_TEST_FILESIZE	(3 * SZ_1M)
+#define FAT_TEST_RUN		64
+#define FAT_TEST_GAP		8
+#define FAT_TEST_SEEKS		1024
+#define FAT_TEST_CHUNK		SZ_64K
+
+#define FAT_TEST_MNT		"/fattest"
+#define FAT_TEST_FILE		FAT_TEST_MNT "/FRAGMENT.BIN"
+
+static unsigned int fat_test_clust(unsigned int i)
+{
+	return 2 + i / FAT_TEST_RUN * (FAT_TEST_RUN + FAT_TEST_GAP) +
+		i % FAT_TEST_RUN;
+}
+
+static void *fat_test_image(void)
+{
+	unsigned int i, j, clst, ncl = FAT_TEST_FILESIZE / SECTOR_SIZE;
+	u8 *img, *dir;
+	__le16 *fat;
+	u32 *data;
+
+	img = xzalloc(FAT_TEST_SECTORS * SECTOR_SIZE);
+
+	img[0] = 0xeb;
+	img[1] = 0x3c;
+	img[2] = 0x90;
+	put_unaligned_le16(SECTOR_SIZE, img + 11);	/* bytes per sector */
+	img[13] = 1;					/* sectors per cluster */
+	put_unaligned_le16(1, img + 14);		/* reserved sectors */
+	img[16] = 1;					/* number of FATs */
+	put_unaligned_le16(FAT_TEST_ROOTENTS, img + 17);
+	put_unaligned_le16(FAT_TEST_SECTORS, img + 19);
+	img[21] = 0xf8;					/* media descriptor */
+	put_unaligned_le16(FAT_TEST_FATSZ, img + 22);
+	memcpy(img + 54, "FAT16   ", 8);
+	put_unaligned_le16(0xaa55, img + 510);
+
+	fat = (__le16 *)(img + SECTOR_SIZE);
+	fat[0] = cpu_to_le16(0xfff8);
+	fat[1] = cpu_to_le16(0xffff);
+
+	for (i = 0; i < ncl; i++) {
+		clst = fat_test_clust(i);
+		fat[clst] = cpu_to_le16(i == ncl - 1 ? 0xffff : fat_test_clust(i + 1));
+
+		data = (u32 *)(img + (FAT_TEST_DATA + clst - 2) * SECTOR_SIZE);
+		for (j = 0; j < SECTOR_SIZE / 4; j++)
+			data[j] = i * SECTOR_SIZE + j * 4;
+	}
+
+	dir = img + (1 + FAT_TEST_FATSZ) * SECTOR_SIZE;
+	memcpy(dir, "FRAGMENTBIN", 11);
+	dir[11] = 0x20;					/* archive */
+	put_unaligned_le16(fat_test_clust(0), dir + 26);
+	put_unaligned_le32(FAT_TEST_FILESIZE, dir + 28);
+
+	return img;
+}
+
+static bool fat_test_verify(const u32 *buf, u32 ofs, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 4; i++) {
+		if (buf[i] != ofs + i * 4) {
+			printf("offset 0x%08zx: read 0x%08x\n", ofs + i * 4, buf[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static u64 fat_test_sequential(int flags)
+{
+	u32 *buf = xmalloc(FAT_TEST_CHUNK);
+	u32 ofs = 0;
+	u64 start, ns;
+	int fd, ret;
+
+	fd = open(FAT_TEST_FILE, flags);
+	if (fd < 0) {
+		failed_tests++;
+		printf("open %s: %pe\n", FAT_TEST_FILE, ERR_PTR(fd));
+		free(buf);
+		return 0;
+	}
+
+	start = get_time_ns();
+
+	while (ofs < FAT_TEST_FILESIZE) {
+		ret = read_full(fd, buf, FAT_TEST_CHUNK);
+		if (ret != FAT_TEST_CHUNK || !fat_test_verify(buf, ofs, ret)) {
+			failed_tests++;
+			printf("sequential read at 0x%08x failed: %d\n", ofs, ret);
+			break;
+		}
+		ofs += ret;
+	}
+
+	ns = get_time_ns() - start;
+
+	close(fd);
+	free(buf);
+
+	return ns;
+}
+
+static u64 fat_test_random(int flags)
+{
+	u32 buf[4], ofs, seed = 1;
+	u64 start, ns;
+	int fd, i, ret;
+
+	fd = open(FAT_TEST_FILE, flags);
+	if (fd < 0) {
+		failed_tests++;
+		printf("open %s: %pe\n", FAT_TEST_FILE, ERR_PTR(fd));
+		return 0;
+	}
+
+	start = get_time_ns();
+
+	for (i = 0; i < FAT_TEST_SEEKS; i++) {
+		seed = seed * 1103515245 + 12345;
+		ofs = (seed >> 8) % (FAT_TEST_FILESIZE - sizeof(buf)) & ~3;
+
+		ret = lseek(fd, ofs, SEEK_SET) == ofs ? 0 : -EIO;
+		if (!ret)
+			ret = read_full(fd, buf, sizeof(buf));
+		if (ret != sizeof(buf) || !fat_test_verify(buf, ofs, ret)) {
+			failed_tests++;
+			printf("random read at 0x%08x failed: %d\n", ofs, ret);
+			break;
+		}
+	}
+
+	ns = get_time_ns() - start;
+
+	close(fd);
+
+	return ns;
+}
+
+static unsigned int fat_test_mbps(u64 ns)
+{
+	return ns ? div64_u64((u64)FAT_TEST_FILESIZE * 1000, ns) : 0;
+}
+
+static void test_fat_fastseek(void)
+{
+	struct ramdisk *rd;
+	struct block_device *blk;
+	char *devpath;
+	u64 seq_ns, rnd_ns;
+	void *img;
+	int ret;
+
+	img = fat_test_image();
+
+	rd = ramdisk_init(SECTOR_SIZE);
+	if (!rd) {
+		failed_tests++;
+		pr_err("Could not create ramdisk\n");
+		goto out_img;
+	}
+
+	ramdisk_setup_rw(rd, img, FAT_TEST_SECTORS * SECTOR_SIZE);
+	blk = ramdisk_get_block_device(rd);
+	devpath = basprintf("/dev/%s", cdev_name(&blk->cdev));
+
+	make_directory(FAT_TEST_MNT);
+
+	ret = mount(devpath, "fat", FAT_TEST_MNT, NULL);
+	if (ret) {
+		failed_tests++;
+		pr_err("mount %s: %pe\n", devpath, ERR_PTR(ret));
+		goto out_rd;
+	}
+
+	total_tests += 2;
+	seq_ns = fat_test_sequential(O_RDONLY);
+	rnd_ns = fat_test_random(O_RDONLY);
+
+	pr_info("%d fragments: sequential %u MB/s, %d seeks in %llu us\n",
+		FAT_TEST_FILESIZE / SECTOR_SIZE / FAT_TEST_RUN,
+		fat_test_mbps(seq_ns), FAT_TEST_SEEKS, div_u64(rnd_ns, 1000));
+
+	/* Files open for writing follow the FAT instead of using the table */
+	if (IS_ENABLED(CONFIG_FS_FAT_WRITE)) {
+		total_tests += 2;
+		seq_ns = fat_test_sequential(O_RDWR);
+		rnd_ns = fat_test_random(O_RDWR);
+
+		pr_info("without cluster table: sequential %u MB/s, %d seeks in %llu us\n",
+			fat_test_mbps(seq_ns), FAT_TEST_SEEKS,
+			div_u64(rnd_ns, 1000));
+	}
+
+	umount(FAT_TEST_MNT);
+out_rd:
+	free(devpath);
+	ramdisk_free(rd);
+out_img:
+	free(img);
+}
+bselftest(core, test_fat_fastseek);
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <driver.h>
+#include <malloc.h>
+#include <of.h>
+#include <linux/math64.h>
+
+BSELFTEST_GLOBALS();
+
+#define OF_LOOKUP_NODES		2048
+#define OF_LOOKUP_PROVIDERS	32
+#define OF_LOOKUP_REFS		4096
+#define OF_LOOKUP_DRIVERS	256
+
+static struct device_node *of_lookup_tree(struct device_node **nodes)
+{
+	struct device_node *root, *parent = NULL;
+	char name[32];
+	int i;
+
+	root = of_new_node(NULL, NULL);
+
+	for (i = 0; i < OF_LOOKUP_NODES; i++) {
+		if (i % 64 == 0) {
+			scnprintf(name, sizeof(name), "bus@%x", i);
+			parent = of_new_node(root, name);
+		}
+
+		scnprintf(name, sizeof(name), "node@%x", i);
+		nodes[i] = of_new_node(parent, name);
+		nodes[i]->phandle = i + 1;
+	}
+
+	return root;
+}
+
+/*
+ * of_new_node() adds nodes right after their parent, so the first nodes
+ * created are the last ones a tree walk reaches. Use them as providers.
+ */
+static phandle of_lookup_ref(int i)
+{
+	return 1 + (i * 7) % OF_LOOKUP_PROVIDERS;
+}
+
+static u64 of_lookup_refs(struct device_node *root, struct device_node **nodes,
+			  bool cached)
+{
+	struct device_node *np;
+	u64 start;
+	phandle p;
+	int i;
+
+	start = get_time_ns();
+
+	for (i = 0; i < OF_LOOKUP_REFS; i++) {
+		if (!cached)
+			of_phandle_cache_invalidate();
+
+		p = of_lookup_ref(i);
+		np = of_find_node_by_phandle_from(p, root);
+
+		total_tests++;
+		if (np != nodes[p - 1]) {
+			failed_tests++;
+			printf("phandle %u resolved to %pOF\n", p, np);
+			break;
+		}
+	}
+
+	return get_time_ns() - start;
+}
+
+static void test_of_phandle_cache(void)
+{
+	struct device_node **nodes, *root, *np;
+	phandle p = of_lookup_ref(0);
+	u64 walk_ns, cached_ns;
+
+	nodes = xzalloc(OF_LOOKUP_NODES * sizeof(*nodes));
+	root = of_lookup_tree(nodes);
+
+	walk_ns = of_lookup_refs(root, nodes, false);
+	cached_ns = of_lookup_refs(root, nodes, true);
+
+	pr_info("%d phandle lookups in %d nodes: %llu us uncached, %llu us cached\n",
+		OF_LOOKUP_REFS, OF_LOOKUP_NODES, div_u64(walk_ns, 1000),
+		div_u64(cached_ns, 1000));
+
+	/* a cached node must not be found after it changed its phandle... */
+	nodes[p - 1]->phandle = OF_LOOKUP_NODES + 1;
+	np = of_find_node_by_phandle_from(p, root);
+	total_tests++;
+	if (np) {
+		failed_tests++;
+		printf("found %pOF for stale phandle %u\n", np, p);
+	}
+
+	/* ...or after it has been deleted */
+	np = of_find_node_by_phandle_from(OF_LOOKUP_NODES + 1, root);
+	of_delete_node(np);
+	np = of_find_node_by_phandle_from(OF_LOOKUP_NODES + 1, root);
+	total_tests++;
+	if (np) {
+		failed_tests++;
+		printf("found deleted node for phandle %u\n", OF_LOOKUP_NODES + 1);
+	}
+
+	/* nodes of another tree are not returned */
+	np = of_find_node_by_phandle_from(2, root);
+	np = of_find_node_by_phandle_from(2, of_get_root_node());
+	total_tests++;
+	if (np == nodes[1]) {
+		failed_tests++;
+		printf("found %pOF in the wrong tree\n", np);
+	}
+
+	of_delete_node(root);
+	free(nodes);
+}
+
+/*
+ * Same as device_match(), but hidden from the driver core, so that devices
+ * on this bus are matched against every driver.
+ */
+static int of_lookup_plain_match(struct device *dev, const struct driver *drv)
+{
+	return device_match(dev, drv);
+}
+
+static struct bus_type of_lookup_indexed_bus = {
+	.name = "selftest-of-indexed",
+	.match = device_match,
+};
+
+static struct bus_type of_lookup_plain_bus = {
+	.name = "selftest-of-plain",
+	.match = of_lookup_plain_match,
+};
+
+static int of_lookup_probe(struct device *dev)
+{
+	return 0;
+}
+
+static u64 of_lookup_register_devices(struct bus_type *bus,
+				      struct device_node *root)
+{
+	struct driver *drvs, *drv;
+	struct of_device_id *ids;
+	struct device **devs;
+	char compat[64], name[48];
+	u64 start, ns;
+	int i, len;
+
+	drvs = xzalloc(OF_LOOKUP_DRIVERS * sizeof(*drvs));
+	ids = xzalloc(OF_LOOKUP_DRIVERS * 3 * sizeof(*ids));
+	devs = xzalloc(OF_LOOKUP_DRIVERS * sizeof(*devs));
+
+	for (i = 0; i < OF_LOOKUP_DRIVERS; i++) {
+		drv = &drvs[i];
+
+		ids[i * 3].compatible = basprintf("barebox,selftest-%d", i);
+		ids[i * 3 + 1].compatible = basprintf("barebox,selftest-%d-v2", i);
+		drv->name = basprintf("%s-%d", bus->name, i);
+		drv->of_compatible = &ids[i * 3];
+		drv->probe = of_lookup_probe;
+		drv->bus = bus;
+		register_driver(drv);
+	}
+
+	for (i = 0; i < OF_LOOKUP_DRIVERS; i++) {
+		struct device_node *np;
+
+		scnprintf(name, sizeof(name), "%s@%x", bus->name, i);
+		np = of_new_node(root, name);
+		len = scnprintf(compat, sizeof(compat),
+				"vendor,unknown-%d%cbarebox,selftest-%d",
+				i, 0, i) + 1;
+		of_set_property(np, "compatible", compat, len, 1);
+
+		devs[i] = xzalloc(sizeof(*devs[i]));
+		dev_set_name(devs[i], "%s", np->name);
+		devs[i]->id = DEVICE_ID_SINGLE;
+		devs[i]->bus = bus;
+		devs[i]->of_node = np;
+	}
+
+	start = get_time_ns();
+	for (i = 0; i < OF_LOOKUP_DRIVERS; i++)
+		register_device(devs[i]);
+	ns = get_time_ns() - start;
+
+	for (i = 0; i < OF_LOOKUP_DRIVERS; i++) {
+		total_tests++;
+		if (devs[i]->driver != &drvs[i]) {
+			failed_tests++;
+			printf("%s bound to %s\n", dev_name(devs[i]),
+			       devs[i]->driver ? devs[i]->driver->name : "nothing");
+		}
+
+		unregister_device(devs[i]);
+		free_device(devs[i]);
+	}
+
+	for (i = 0; i < OF_LOOKUP_DRIVERS; i++) {
+		unregister_driver(&drvs[i]);
+		free((char *)drvs[i].name);
+		free((char *)ids[i * 3].compatible);
+		free((char *)ids[i * 3 + 1].compatible);
+	}
+
+	free(devs);
+	free(ids);
+	free(drvs);
+
+	return ns;
+}
+
+static void test_of_driver_index(void)
+{
+	static bool registered;
+	struct device_node *root;
+	u64 indexed_ns, plain_ns;
+
+	if (!IS_ENABLED(CONFIG_OFDEVICE)) {
+		skipped_tests++;
+		return;
+	}
+
+	if (!registered) {
+		bus_register(&of_lookup_indexed_bus);
+		bus_register(&of_lookup_plain_bus);
+		registered = true;
+	}
+
+	root = of_new_node(NULL, NULL);
+
+	plain_ns = of_lookup_register_devices(&of_lookup_plain_bus, root);
+	indexed_ns = of_lookup_register_devices(&of_lookup_indexed_bus, root);
+
+	pr_info("matching %d devices against %d drivers: %llu us, %llu us indexed\n",
+		OF_LOOKUP_DRIVERS, OF_LOOKUP_DRIVERS, div_u64(plain_ns, 1000),
+		div_u64(indexed_ns, 1000));
+
+	of_delete_node(root);
+}
+
+static void test_of_lookup(void)
+{
+	test_of_phandle_cache();
+	test_of_driver_index();
+}
+bselftest(core, test_of_lookup);
@@ -250,6 +250,35 @@ static void test_ramfs(void)
 			       ctx.ndirs);
 	}
 
+	/* files written piecewise must stay contiguous to be memmappable */
+	fd = open("contiguous", O_RDWR | O_CREAT);
+	if (expect_success(fd, "creating contiguous file")) {
+		u32 pattern[SZ_1K];
+		const u32 *map;
+
+		for (i = 0; i < 64; i++) {
+			for (j = 0; j < ARRAY_SIZE(pattern); j++)
+				pattern[j] = i * ARRAY_SIZE(pattern) + j;
+
+			ret = write_full(fd, pattern, sizeof(pattern));
+			if (!expect_success(ret, "writing contiguous file"))
+				break;
+		}
+
+		map = memmap(fd, PROT_READ);
+		if (expect_success(map == MAP_FAILED ? -errno : 0,
+				   "memmapping piecewise written file")) {
+			for (j = 0; j < 64 * ARRAY_SIZE(pattern); j++)
+				if (map[j] != j)
+					break;
+
+			expect_success(j == 64 * ARRAY_SIZE(pattern) ? 0 : -EILSEQ,
+				       "memmapped content mismatch at %d", j);
+		}
+
+		close(fd);
+	}
+
 out:
 	popd(oldpwd);
 	free(content);
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <clock.h>
+#include <digest.h>
+#include <malloc.h>
+#include <smp.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+BSELFTEST_GLOBALS();
+
+#define SMP_TEST_JOBS		256
+#define SMP_TEST_FAIL_JOB	100
+#define SMP_TEST_LEN		SZ_8M
+#define SMP_TEST_BLOCKSIZE	SZ_64K
+
+static unsigned int smp_test_done[SMP_TEST_JOBS];
+
+static int smp_test_job(void *data, unsigned int job, unsigned int cpu)
+{
+	unsigned int *ncpus = data;
+
+	if (cpu >= *ncpus)
+		return -ERANGE;
+
+	smp_test_done[job]++;
+
+	return 0;
+}
+
+static int smp_test_fail(void *data, unsigned int job, unsigned int cpu)
+{
+	return job == SMP_TEST_FAIL_JOB ? -EIO : 0;
+}
+
+static void test_smp_jobs(void)
+{
+	unsigned int ncpus = smp_num_cpus();
+	int i, ret;
+
+	memset(smp_test_done, 0, sizeof(smp_test_done));
+
+	total_tests++;
+	ret = smp_run_jobs(smp_test_job, &ncpus, SMP_TEST_JOBS);
+	if (ret) {
+		failed_tests++;
+		printf("running jobs failed: %pe\n", ERR_PTR(ret));
+	}
+
+	for (i = 0; i < SMP_TEST_JOBS; i++) {
+		total_tests++;
+		if (smp_test_done[i] != 1) {
+			failed_tests++;
+			printf("job %d ran %u times\n", i, smp_test_done[i]);
+		}
+	}
+
+	total_tests++;
+	ret = smp_run_jobs(smp_test_fail, NULL, SMP_TEST_JOBS);
+	if (ret != -EIO) {
+		failed_tests++;
+		printf("failing job returned %pe\n", ERR_PTR(ret));
+	}
+}
+
+static void test_smp_digest_blocks(void)
+{
+	unsigned int nblocks = SMP_TEST_LEN / SMP_TEST_BLOCKSIZE;
+	u8 *buf, *hashes, *expected;
+	struct digest *d;
+	u64 start, serial_ns, parallel_ns;
+	int i, len, ret;
+
+	d = digest_alloc("sha256");
+	if (!d) {
+		skipped_tests++;
+		return;
+	}
+
+	len = digest_length(d);
+	buf = malloc(SMP_TEST_LEN);
+	hashes = malloc(nblocks * len);
+	expected = malloc(nblocks * len);
+	if (!buf || !hashes || !expected) {
+		skipped_tests++;
+		goto out;
+	}
+
+	for (i = 0; i < SMP_TEST_LEN; i++)
+		buf[i] = i * 7 + (i >> 12);
+
+	start = get_time_ns();
+	for (i = 0; i < nblocks; i++)
+		digest_digest(d, buf + i * SMP_TEST_BLOCKSIZE,
+			      SMP_TEST_BLOCKSIZE, expected + i * len);
+	serial_ns = get_time_ns() - start;
+
+	total_tests++;
+	start = get_time_ns();
+	ret = digest_blocks("sha256", buf, SMP_TEST_LEN, SMP_TEST_BLOCKSIZE,
+			    hashes);
+	parallel_ns = get_time_ns() - start;
+	if (ret) {
+		failed_tests++;
+		printf("digest_blocks failed: %pe\n", ERR_PTR(ret));
+		goto out;
+	}
+
+	total_tests++;
+	if (memcmp(hashes, expected, nblocks * len)) {
+		failed_tests++;
+		printf("digest_blocks returned wrong hashes\n");
+	}
+
+	pr_info("sha256 over %u blocks: %llu us on one CPU, %llu us on %u CPUs\n",
+		nblocks, div_u64(serial_ns, 1000), div_u64(parallel_ns, 1000),
+		smp_num_cpus());
+out:
+	free(expected);
+	free(hashes);
+	free(buf);
+	digest_free(d);
+}
+
+static void test_smp(void)
+{
+	test_smp_jobs();
+	test_smp_digest_blocks();
+}
+bselftest(core, test_smp);